@@ -86,11 +86,67 @@ typedef struct evalinfo_T {
     char *savelocale;    /* original LC_NUMERIC locale */
 } evalinfo_T;
 
+/* type of arithnode_T */
+typedef enum arithnodetype_T {
+    AN_VALUE,        /* number or variable */
+    AN_ASSIGNMENT,   /* lhs = rhs, lhs += rhs, etc. */
+    AN_CONDITIONAL,  /* cond ? lhs : rhs */
+    AN_LOGICAL_OR,   /* lhs || rhs */
+    AN_LOGICAL_AND,  /* lhs && rhs */
+    AN_CALCULATION,  /* lhs + rhs, lhs << rhs, lhs & rhs, etc. */
+    AN_COMPARISON,   /* lhs == rhs, lhs < rhs, etc. */
+    AN_PREFIX,       /* ++lhs, -lhs, !lhs, etc. */
+    AN_POSTFIX,      /* lhs++, lhs-- */
+} arithnodetype_T;
+/* node of a compiled arithmetic expression */
+typedef struct arithnode_T {
+    arithnodetype_T type;
+    atokentype_T op;         /* operator */
+    size_t cond, lhs, rhs;   /* indices of the operand nodes */
+    value_T value;           /* value of AN_VALUE (VT_LONG/DOUBLE/VAR) */
+} arithnode_T;
+
+/* compiled arithmetic expression */
+struct arithcode_T {
+    wchar_t *exp;            /* source expression */
+    bool posix_unsafe;       /* contains a float literal, "++", or "--" */
+    size_t count, root;
+    arithnode_T *nodes;
+};
+/* The nodes form a tree whose root is `nodes[root]'. The operands of a node
+ * are referred to by their indices in `nodes'. The names of variables in
+ * AN_VALUE nodes point into `exp'.
+ * In the POSIXly-correct mode, expressions containing a float literal or an
+ * increment/decrement operator are rejected, so they are evaluated from `exp'
+ * to report the error. */
+
+#define BINARY_LEVEL_MAX 9
+
+typedef struct compileinfo_T {
+    evalinfo_T info;         /* used to read tokens */
+    arithcode_T *code;       /* code being compiled */
+    size_t capacity;         /* size of the `code->nodes' array */
+    bool error;              /* true if the expression is not compilable */
+} compileinfo_T;
+
 static void evaluate(
 	const wchar_t *exp, value_T *result, evalinfo_T *info, bool coerce)
     __attribute__((nonnull));
+static void evaluate_code(const arithcode_T *code,
+	value_T *result, evalinfo_T *info, bool coerce)
+    __attribute__((nonnull));
+static wchar_t *result_to_string(evalinfo_T *info, value_T *result)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static bool result_to_index(
+	evalinfo_T *info, value_T *result, ssize_t *valuep)
+    __attribute__((nonnull));
 static void parse_assignment(evalinfo_T *info, value_T *result)
     __attribute__((nonnull));
+static bool is_assignment_operator(atokentype_T ttype)
+    __attribute__((const));
+static void apply_assignment(evalinfo_T *info, atokentype_T ttype,
+	value_T *lhs, value_T *rhs)
+    __attribute__((nonnull));
 static bool do_assignment(const word_T *word, const value_T *value)
     __attribute__((nonnull));
 static wchar_t *value_to_string(const value_T *value)
@@ -125,6 +181,9 @@ static void parse_and(evalinfo_T *info, value_T *result)
     __attribute__((nonnull));
 static void parse_equality(evalinfo_T *info, value_T *result)
     __attribute__((nonnull));
+static void apply_comparison(evalinfo_T *info, atokentype_T ttype,
+	value_T *lhs, value_T *rhs)
+    __attribute__((nonnull));
 static void parse_relational(evalinfo_T *info, value_T *result)
     __attribute__((nonnull));
 static void parse_shift(evalinfo_T *info, value_T *result)
@@ -135,8 +194,14 @@ static void parse_multiplicative(evalinfo_T *info, value_T *result)
     __attribute__((nonnull));
 static void parse_prefix(evalinfo_T *info, value_T *result)
     __attribute__((nonnull));
+static void apply_prefix_operator(
+	evalinfo_T *info, atokentype_T ttype, value_T *value)
+    __attribute__((nonnull));
 static void parse_postfix(evalinfo_T *info, value_T *result)
     __attribute__((nonnull));
+static void apply_postfix_operator(
+	evalinfo_T *info, atokentype_T ttype, value_T *value)
+    __attribute__((nonnull));
 static bool do_increment_or_decrement(atokentype_T ttype, value_T *value)
     __attribute__((nonnull,warn_unused_result));
 static void parse_primary(evalinfo_T *info, value_T *result)
@@ -154,6 +219,29 @@ static void next_token(evalinfo_T *info)
     __attribute__((nonnull));
 static bool long_mul_will_overflow(long v1, long v2)
     __attribute__((const,warn_unused_result));
+static bool is_compilable(const wchar_t *exp)
+    __attribute__((nonnull,pure));
+static size_t compile_assignment(compileinfo_T *ci)
+    __attribute__((nonnull));
+static size_t compile_conditional(compileinfo_T *ci)
+    __attribute__((nonnull));
+static size_t compile_binary(compileinfo_T *ci, int level)
+    __attribute__((nonnull));
+static int binary_operator_level(atokentype_T ttype)
+    __attribute__((const));
+static size_t compile_prefix(compileinfo_T *ci)
+    __attribute__((nonnull));
+static size_t compile_postfix(compileinfo_T *ci)
+    __attribute__((nonnull));
+static size_t compile_primary(compileinfo_T *ci)
+    __attribute__((nonnull));
+static bool compile_number(const word_T *word, value_T *result)
+    __attribute__((nonnull));
+static size_t add_node(compileinfo_T *ci, const arithnode_T *node)
+    __attribute__((nonnull));
+static void evaluate_node(const arithcode_T *code, size_t index,
+	evalinfo_T *info, value_T *result)
+    __attribute__((nonnull));
 
 
 /* Evaluates the specified string as an arithmetic expression.
@@ -168,16 +256,7 @@ wchar_t *evaluate_arithmetic(wchar_t *exp)
 
     evaluate(exp, &result, &info, posixly_correct);
 
-    wchar_t *resultstr;
-    if (info.error) {
-	resultstr = NULL;
-    } else if (info.atoken.type == TT_NULL) {
-	resultstr = value_to_string(&result);
-    } else {
-	if (info.atoken.type != TT_INVALID)
-	    xerror(0, Ngt("arithmetic: invalid syntax"));
-	resultstr = NULL;
-    }
+    wchar_t *resultstr = result_to_string(&info, &result);
     free(exp);
     return resultstr;
 }
@@ -194,34 +273,82 @@ bool evaluate_index(wchar_t *exp, ssize_t *valuep)
 
     evaluate(exp, &result, &info, true);
 
-    bool ok;
-    if (info.error) {
-	ok = false;
-    } else if (info.atoken.type == TT_NULL) {
-	if (result.type == VT_LONG) {
+    bool ok = result_to_index(&info, &result, valuep);
+    free(exp);
+    return ok;
+}
+
+/* Evaluates the specified compiled arithmetic expression.
+ * The result is the same as that of `evaluate_arithmetic' for the source
+ * expression of the code. */
+wchar_t *evaluate_arithcode(const arithcode_T *code)
+{
+    if (posixly_correct && code->posix_unsafe)
+	return evaluate_arithmetic(xwcsdup(code->exp));
+
+    value_T result;
+    evalinfo_T info;
+
+    evaluate_code(code, &result, &info, posixly_correct);
+    return result_to_string(&info, &result);
+}
+
+/* Evaluates the specified compiled arithmetic expression.
+ * The result is the same as that of `evaluate_index' for the source expression
+ * of the code. */
+bool evaluate_index_arithcode(const arithcode_T *code, ssize_t *valuep)
+{
+    if (posixly_correct && code->posix_unsafe)
+	return evaluate_index(xwcsdup(code->exp), valuep);
+
+    value_T result;
+    evalinfo_T info;
+
+    evaluate_code(code, &result, &info, true);
+    return result_to_index(&info, &result, valuep);
+}
+
+/* Converts the result of `evaluate' or `evaluate_code' into a newly-malloced
+ * string. On error, an error message is printed and NULL is returned. */
+wchar_t *result_to_string(evalinfo_T *info, value_T *result)
+{
+    if (info->error)
+	return NULL;
+    if (info->atoken.type == TT_NULL)
+	return value_to_string(result);
+    if (info->atoken.type != TT_INVALID)
+	xerror(0, Ngt("arithmetic: invalid syntax"));
+    return NULL;
+}
+
+/* Converts the result of `evaluate' or `evaluate_code' into an index, which is
+ * assigned to `*valuep'. On error, an error message is printed.
+ * Returns true iff successful. */
+bool result_to_index(evalinfo_T *info, value_T *result, ssize_t *valuep)
+{
+    if (info->error)
+	return false;
+    if (info->atoken.type != TT_NULL) {
+	if (info->atoken.type != TT_INVALID)
+	    xerror(0, Ngt("arithmetic: invalid syntax"));
+	return false;
+    }
+    if (result->type != VT_LONG) {
+	xerror(0, Ngt("the index is not an integer"));
+	return false;
+    }
 #if LONG_MAX > SSIZE_MAX
-	    if (result.v_long > (long) SSIZE_MAX)
-		*valuep = SSIZE_MAX;
-	    else
+    if (result->v_long > (long) SSIZE_MAX)
+	*valuep = SSIZE_MAX;
+    else
 #endif
 #if LONG_MIN < -SSIZE_MAX
-	    if (result.v_long < (long) -SSIZE_MAX)
-		*valuep = -SSIZE_MAX;
-	    else
+    if (result->v_long < (long) -SSIZE_MAX)
+	*valuep = -SSIZE_MAX;
+    else
 #endif
-		*valuep = (ssize_t) result.v_long;
-	    ok = true;
-	} else {
-	    xerror(0, Ngt("the index is not an integer"));
-	    ok = false;
-	}
-    } else {
-	if (info.atoken.type != TT_INVALID)
-	    xerror(0, Ngt("arithmetic: invalid syntax"));
-	ok = false;
-    }
-    free(exp);
-    return ok;
+	*valuep = (ssize_t) result->v_long;
+    return true;
 }
 
 void evaluate(
@@ -249,33 +376,45 @@ void parse_assignment(evalinfo_T *info, value_T *result)
     parse_conditional(info, result);
 
     atokentype_T ttype = info->atoken.type;
+    if (is_assignment_operator(ttype)) {
+	value_T rhs;
+	next_token(info);
+	parse_assignment(info, &rhs);
+	apply_assignment(info, ttype, result, &rhs);
+    }
+}
+
+/* Tests if the specified token is an assignment operator. */
+bool is_assignment_operator(atokentype_T ttype)
+{
     switch (ttype) {
 	case TT_EQUAL:          case TT_PLUSEQUAL:   case TT_MINUSEQUAL:
 	case TT_ASTEREQUAL:     case TT_SLASHEQUAL:  case TT_PERCENTEQUAL:
 	case TT_LESSLESSEQUAL:  case TT_GREATERGREATEREQUAL:
 	case TT_AMPEQUAL:       case TT_HATEQUAL:    case TT_PIPEEQUAL:
-	    {
-		value_T rhs;
-		next_token(info);
-		parse_assignment(info, &rhs);
-		if (result->type == VT_VAR) {
-		    word_T saveword = result->v_var;
-		    if (!do_binary_calculation(
-				info, ttype, result, &rhs, result))
-			break;
-		    if (!do_assignment(&saveword, result))
-			info->error = true, result->type = VT_INVALID;
-		} else if (result->type != VT_INVALID) {
-		    /* TRANSLATORS: This error message is shown when the target
-		     * of an assignment is not a variable. */
-		    xerror(0, Ngt("arithmetic: cannot assign to a number"));
-		    info->error = true;
-		    result->type = VT_INVALID;
-		}
-		break;
-	    }
+	    return true;
 	default:
-	    break;
+	    return false;
+    }
+}
+
+/* Applies assignment operator `ttype' to the variable `*lhs' and the value
+ * `*rhs'. The result of the assignment expression is assigned to `*lhs'. */
+void apply_assignment(evalinfo_T *info, atokentype_T ttype,
+	value_T *lhs, value_T *rhs)
+{
+    if (lhs->type == VT_VAR) {
+	word_T saveword = lhs->v_var;
+	if (!do_binary_calculation(info, ttype, lhs, rhs, lhs))
+	    return;
+	if (!do_assignment(&saveword, lhs))
+	    info->error = true, lhs->type = VT_INVALID;
+    } else if (lhs->type != VT_INVALID) {
+	/* TRANSLATORS: This error message is shown when the target of an
+	 * assignment is not a variable. */
+	xerror(0, Ngt("arithmetic: cannot assign to a number"));
+	info->error = true;
+	lhs->type = VT_INVALID;
     }
 }
 
@@ -759,22 +898,7 @@ void parse_equality(evalinfo_T *info, value_T *result)
 	    case TT_EXCLEQUAL:
 		next_token(info);
 		parse_relational(info, &rhs);
-		switch (coerce_type(info, result, &rhs)) {
-		    case VT_LONG:
-			result->v_long = do_long_comparison(ttype,
-				result->v_long, rhs.v_long);
-			break;
-		    case VT_DOUBLE:
-			result->v_long = do_double_comparison(ttype,
-				result->v_double, rhs.v_double);
-			result->type = VT_LONG;
-			break;
-		    case VT_INVALID:
-			result->type = VT_INVALID;
-			break;
-		    case VT_VAR:
-			assert(false);
-		}
+		apply_comparison(info, ttype, result, &rhs);
 		break;
 	    default:
 		return;
@@ -782,6 +906,28 @@ void parse_equality(evalinfo_T *info, value_T *result)
     }
 }
 
+/* Applies comparison operator `ttype' to the operands `*lhs' and `*rhs'.
+ * The result is assigned to `*lhs'. */
+void apply_comparison(evalinfo_T *info, atokentype_T ttype,
+	value_T *lhs, value_T *rhs)
+{
+    switch (coerce_type(info, lhs, rhs)) {
+	case VT_LONG:
+	    lhs->v_long = do_long_comparison(ttype, lhs->v_long, rhs->v_long);
+	    break;
+	case VT_DOUBLE:
+	    lhs->v_long = do_double_comparison(ttype,
+		    lhs->v_double, rhs->v_double);
+	    lhs->type = VT_LONG;
+	    break;
+	case VT_INVALID:
+	    lhs->type = VT_INVALID;
+	    break;
+	case VT_VAR:
+	    assert(false);
+    }
+}
+
 /* Parses a relational expression.
  *   RelationalExp := ShiftExp
  *                  | RelationalExp "<" ShiftExp
@@ -801,22 +947,7 @@ void parse_relational(evalinfo_T *info, value_T *result)
 	    case TT_GREATEREQUAL:
 		next_token(info);
 		parse_shift(info, &rhs);
-		switch (coerce_type(info, result, &rhs)) {
-		    case VT_LONG:
-			result->v_long = do_long_comparison(ttype,
-				result->v_long, rhs.v_long);
-			break;
-		    case VT_DOUBLE:
-			result->v_long = do_double_comparison(ttype,
-				result->v_double, rhs.v_double);
-			result->type = VT_LONG;
-			break;
-		    case VT_INVALID:
-			result->type = VT_INVALID;
-			break;
-		    case VT_VAR:
-			assert(false);
-		}
+		apply_comparison(info, ttype, result, &rhs);
 		break;
 	    default:
 		return;
@@ -905,70 +1036,83 @@ void parse_prefix(evalinfo_T *info, value_T *result)
     switch (ttype) {
 	case TT_PLUSPLUS:
 	case TT_MINUSMINUS:
+	case TT_PLUS:
+	case TT_MINUS:
+	case TT_TILDE:
+	case TT_EXCL:
 	    next_token(info);
 	    parse_prefix(info, result);
+	    apply_prefix_operator(info, ttype, result);
+	    break;
+	default:
+	    parse_postfix(info, result);
+	    break;
+    }
+}
+
+/* Applies prefix operator `ttype' to the operand `*value'.
+ * The result is assigned to `*value'. */
+void apply_prefix_operator(evalinfo_T *info, atokentype_T ttype, value_T *value)
+{
+    switch (ttype) {
+	case TT_PLUSPLUS:
+	case TT_MINUSMINUS:
 	    if (posixly_correct) {
 		xerror(0, Ngt("arithmetic: operator `%ls' is not supported"),
 			(ttype == TT_PLUSPLUS) ? L"++" : L"--");
 		info->error = true;
-		result->type = VT_INVALID;
-	    } else if (result->type == VT_VAR) {
-		word_T saveword = result->v_var;
-		coerce_number(info, result);
-		if (!do_increment_or_decrement(ttype, result) ||
-			!do_assignment(&saveword, result))
-		    info->error = true, result->type = VT_INVALID;
-	    } else if (result->type != VT_INVALID) {
+		value->type = VT_INVALID;
+	    } else if (value->type == VT_VAR) {
+		word_T saveword = value->v_var;
+		coerce_number(info, value);
+		if (!do_increment_or_decrement(ttype, value) ||
+			!do_assignment(&saveword, value))
+		    info->error = true, value->type = VT_INVALID;
+	    } else if (value->type != VT_INVALID) {
 		/* TRANSLATORS: This error message is shown when the operand of
 		 * the "++" or "--" operator is not a variable. */
 		xerror(0, Ngt("arithmetic: operator `%ls' requires a variable"),
-			(info->atoken.type == TT_PLUSPLUS) ? L"++" : L"--");
+			(ttype == TT_PLUSPLUS) ? L"++" : L"--");
 		info->error = true;
-		result->type = VT_INVALID;
+		value->type = VT_INVALID;
 	    }
 	    break;
 	case TT_PLUS:
 	case TT_MINUS:
-	    next_token(info);
-	    parse_prefix(info, result);
-	    coerce_number(info, result);
+	    coerce_number(info, value);
 	    if (ttype == TT_MINUS) {
-		switch (result->type) {
+		switch (value->type) {
 		case VT_LONG:
 #if LONG_MIN < -LONG_MAX
-		    if (result->v_long == LONG_MIN) {
+		    if (value->v_long == LONG_MIN) {
 			xerror(0, Ngt("arithmetic: overflow"));
 			info->error = true;
-			result->type = VT_INVALID;
+			value->type = VT_INVALID;
 			break;
 		    }
 #endif
-		    result->v_long = -result->v_long;
+		    value->v_long = -value->v_long;
 		    break;
-		case VT_DOUBLE:   result->v_double = -result->v_double;  break;
+		case VT_DOUBLE:   value->v_double = -value->v_double;  break;
 		case VT_INVALID:  break;
 		default:          assert(false);
 		}
 	    }
 	    break;
 	case TT_TILDE:
-	    next_token(info);
-	    parse_prefix(info, result);
-	    coerce_integer(info, result);
-	    if (result->type == VT_LONG)
-		result->v_long = ~result->v_long;
+	    coerce_integer(info, value);
+	    if (value->type == VT_LONG)
+		value->v_long = ~value->v_long;
 	    break;
 	case TT_EXCL:
-	    next_token(info);
-	    parse_prefix(info, result);
-	    coerce_number(info, result);
-	    switch (result->type) {
+	    coerce_number(info, value);
+	    switch (value->type) {
 		case VT_LONG:
-		    result->v_long = !result->v_long;
+		    value->v_long = !value->v_long;
 		    break;
 		case VT_DOUBLE:
-		    result->type = VT_LONG;
-		    result->v_long = !result->v_double;
+		    value->type = VT_LONG;
+		    value->v_long = !value->v_double;
 		    break;
 		case VT_INVALID:
 		    break;
@@ -977,8 +1121,7 @@ void parse_prefix(evalinfo_T *info, value_T *result)
 	    }
 	    break;
 	default:
-	    parse_postfix(info, result);
-	    break;
+	    assert(false);
     }
 }
 
@@ -992,28 +1135,7 @@ void parse_postfix(evalinfo_T *info, value_T *result)
 	switch (info->atoken.type) {
 	    case TT_PLUSPLUS:
 	    case TT_MINUSMINUS:
-		if (posixly_correct) {
-		    xerror(0,
-			    Ngt("arithmetic: operator `%ls' is not supported"),
-			    (info->atoken.type == TT_PLUSPLUS) ? L"++" : L"--");
-		    info->error = true;
-		    result->type = VT_INVALID;
-		} else if (result->type == VT_VAR) {
-		    word_T saveword = result->v_var;
-		    coerce_number(info, result);
-		    value_T value = *result;
-		    if (!do_increment_or_decrement(info->atoken.type, &value) ||
-			    !do_assignment(&saveword, &value)) {
-			info->error = true;
-			result->type = VT_INVALID;
-		    }
-		} else if (result->type != VT_INVALID) {
-		    xerror(0, Ngt("arithmetic: "
-				"operator `%ls' requires a variable"),
-			    (info->atoken.type == TT_PLUSPLUS) ? L"++" : L"--");
-		    info->error = true;
-		    result->type = VT_INVALID;
-		}
+		apply_postfix_operator(info, info->atoken.type, result);
 		next_token(info);
 		break;
 	    default:
@@ -1022,6 +1144,33 @@ void parse_postfix(evalinfo_T *info, value_T *result)
     }
 }
 
+/* Applies postfix operator `ttype' to the operand `*value'.
+ * The result is assigned to `*value'. */
+void apply_postfix_operator(
+	evalinfo_T *info, atokentype_T ttype, value_T *value)
+{
+    if (posixly_correct) {
+	xerror(0, Ngt("arithmetic: operator `%ls' is not supported"),
+		(ttype == TT_PLUSPLUS) ? L"++" : L"--");
+	info->error = true;
+	value->type = VT_INVALID;
+    } else if (value->type == VT_VAR) {
+	word_T saveword = value->v_var;
+	coerce_number(info, value);
+	value_T newvalue = *value;
+	if (!do_increment_or_decrement(ttype, &newvalue) ||
+		!do_assignment(&saveword, &newvalue)) {
+	    info->error = true;
+	    value->type = VT_INVALID;
+	}
+    } else if (value->type != VT_INVALID) {
+	xerror(0, Ngt("arithmetic: operator `%ls' requires a variable"),
+		(ttype == TT_PLUSPLUS) ? L"++" : L"--");
+	info->error = true;
+	value->type = VT_INVALID;
+    }
+}
+
 /* Increment or decrement the specified value.
  * `ttype' must be either TT_PLUSPLUS or TT_MINUSMINUS and the `value' must be
  * `coerce_number'ed.
@@ -1470,4 +1619,367 @@ bool long_mul_will_overflow(long v1, long v2)
     return (prod & (unsigned long) LONG_MAX) / u2 != u1;
 }
 
+/********** Compiled Expressions **********/
+
+/* Compiles the specified arithmetic expression so that it can be evaluated
+ * repeatedly without being parsed again.
+ * Returns NULL if the expression cannot be compiled, in which case no error
+ * message is printed: a syntax error in the expression is reported when it is
+ * evaluated by `evaluate_arithmetic' or `evaluate_index'. */
+/* Only expressions consisting of ASCII characters are compiled so that the
+ * result does not depend on the locale. */
+arithcode_T *compile_arithmetic(const wchar_t *exp)
+{
+    if (!is_compilable(exp))
+	return NULL;
+
+    compileinfo_T ci;
+    ci.code = xmalloc(sizeof *ci.code);
+    ci.code->exp = xwcsdup(exp);
+    ci.code->posix_unsafe = false;
+    ci.code->count = 0;
+    ci.code->nodes = NULL;
+    ci.capacity = 0;
+    ci.error = false;
+    ci.info.exp = ci.code->exp;
+    ci.info.index = 0;
+    ci.info.parseonly = true;
+    ci.info.error = false;
+
+    next_token(&ci.info);
+    ci.code->root = compile_assignment(&ci);
+    if (ci.error || ci.info.error || ci.info.atoken.type != TT_NULL) {
+	arithcodefree(ci.code);
+	return NULL;
+    }
+    return ci.code;
+}
+
+/* Checks if the specified expression contains only ASCII characters that can
+ * be a part of a valid token. */
+bool is_compilable(const wchar_t *exp)
+{
+    for (; *exp != L'\0'; exp++) {
+	if ((unsigned long) *exp >= 0x80)
+	    return false;
+	if (!iswalnum(*exp) && !iswspace(*exp)
+		&& wcschr(L"_.()~!%+-*/<>=&|^?:", *exp) == NULL)
+	    return false;
+    }
+    return true;
+}
+
+/* Compiles an assignment expression.
+ * Returns the index of the compiled node. */
+size_t compile_assignment(compileinfo_T *ci)
+{
+    arithnode_T node = { .type = AN_ASSIGNMENT, };
+    node.lhs = compile_conditional(ci);
+
+    node.op = ci->info.atoken.type;
+    if (!is_assignment_operator(node.op))
+	return node.lhs;
+
+    next_token(&ci->info);
+    node.rhs = compile_assignment(ci);
+    return add_node(ci, &node);
+}
+
+/* Compiles a conditional expression.
+ * Returns the index of the compiled node. */
+size_t compile_conditional(compileinfo_T *ci)
+{
+    arithnode_T node = { .type = AN_CONDITIONAL, };
+    node.cond = compile_binary(ci, 0);
+    if (ci->info.atoken.type != TT_QUESTION)
+	return node.cond;
+
+    next_token(&ci->info);
+    node.lhs = compile_assignment(ci);
+    if (ci->info.atoken.type != TT_COLON) {
+	ci->error = true;
+	return 0;
+    }
+
+    next_token(&ci->info);
+    node.rhs = compile_conditional(ci);
+    return add_node(ci, &node);
+}
+
+/* Compiles a left-associative binary expression whose operators are of the
+ * specified precedence level. See `binary_operator_level'.
+ * Returns the index of the compiled node. */
+size_t compile_binary(compileinfo_T *ci, int level)
+{
+    if (level > BINARY_LEVEL_MAX)
+	return compile_prefix(ci);
+
+    size_t lhs = compile_binary(ci, level + 1);
+    for (;;) {
+	atokentype_T ttype = ci->info.atoken.type;
+	if (binary_operator_level(ttype) != level)
+	    return lhs;
+
+	arithnode_T node = { .op = ttype, .lhs = lhs, };
+	switch (ttype) {
+	    case TT_PIPEPIPE:  node.type = AN_LOGICAL_OR;   break;
+	    case TT_AMPAMP:    node.type = AN_LOGICAL_AND;  break;
+	    case TT_EQUALEQUAL:  case TT_EXCLEQUAL:
+	    case TT_LESS:        case TT_LESSEQUAL:
+	    case TT_GREATER:     case TT_GREATEREQUAL:
+			       node.type = AN_COMPARISON;   break;
+	    default:           node.type = AN_CALCULATION;  break;
+	}
+	next_token(&ci->info);
+	node.rhs = compile_binary(ci, level + 1);
+	lhs = add_node(ci, &node);
+    }
+}
+
+/* Returns the precedence level of the specified binary operator, from 0 for
+ * "||" (the lowest) to BINARY_LEVEL_MAX for "*", "/", and "%" (the highest).
+ * Returns -1 if the token is not a binary operator. */
+int binary_operator_level(atokentype_T ttype)
+{
+    switch (ttype) {
+	case TT_PIPEPIPE:        return 0;
+	case TT_AMPAMP:          return 1;
+	case TT_PIPE:            return 2;
+	case TT_HAT:             return 3;
+	case TT_AMP:             return 4;
+	case TT_EQUALEQUAL:      case TT_EXCLEQUAL:
+				 return 5;
+	case TT_LESS:            case TT_LESSEQUAL:
+	case TT_GREATER:         case TT_GREATEREQUAL:
+				 return 6;
+	case TT_LESSLESS:        case TT_GREATERGREATER:
+				 return 7;
+	case TT_PLUS:            case TT_MINUS:
+				 return 8;
+	case TT_ASTER:           case TT_SLASH:           case TT_PERCENT:
+				 return 9;
+	default:                 return -1;
+    }
+}
+
+/* Compiles a prefix expression.
+ * Returns the index of the compiled node. */
+size_t compile_prefix(compileinfo_T *ci)
+{
+    arithnode_T node = { .type = AN_PREFIX, };
+    node.op = ci->info.atoken.type;
+    switch (node.op) {
+	case TT_PLUSPLUS:
+	case TT_MINUSMINUS:
+	    ci->code->posix_unsafe = true;
+	    /* falls thru */
+	case TT_PLUS:
+	case TT_MINUS:
+	case TT_TILDE:
+	case TT_EXCL:
+	    next_token(&ci->info);
+	    node.lhs = compile_prefix(ci);
+	    return add_node(ci, &node);
+	default:
+	    return compile_postfix(ci);
+    }
+}
+
+/* Compiles a postfix expression.
+ * Returns the index of the compiled node. */
+size_t compile_postfix(compileinfo_T *ci)
+{
+    size_t index = compile_primary(ci);
+    for (;;) {
+	switch (ci->info.atoken.type) {
+	    case TT_PLUSPLUS:
+	    case TT_MINUSMINUS:
+		ci->code->posix_unsafe = true;
+		index = add_node(ci, &(arithnode_T) {
+			.type = AN_POSTFIX,
+			.op = ci->info.atoken.type,
+			.lhs = index, });
+		next_token(&ci->info);
+		break;
+	    default:
+		return index;
+	}
+    }
+}
+
+/* Compiles a primary expression.
+ * Returns the index of the compiled node. */
+size_t compile_primary(compileinfo_T *ci)
+{
+    arithnode_T node = { .type = AN_VALUE, };
+    switch (ci->info.atoken.type) {
+	case TT_LPAREN:
+	    next_token(&ci->info);
+	    size_t index = compile_assignment(ci);
+	    if (ci->info.atoken.type != TT_RPAREN) {
+		ci->error = true;
+		return 0;
+	    }
+	    next_token(&ci->info);
+	    return index;
+	case TT_NUMBER:
+	    if (!compile_number(&ci->info.atoken.word, &node.value)) {
+		ci->error = true;
+		return 0;
+	    }
+	    if (node.value.type == VT_DOUBLE)
+		ci->code->posix_unsafe = true;
+	    next_token(&ci->info);
+	    return add_node(ci, &node);
+	case TT_IDENTIFIER:
+	    node.value.type = VT_VAR;
+	    node.value.v_var = ci->info.atoken.word;
+	    next_token(&ci->info);
+	    return add_node(ci, &node);
+	default:
+	    ci->error = true;
+	    return 0;
+    }
+}
+
+/* Converts the specified word into a number like `parse_as_number', but
+ * without printing an error message. A float literal is accepted even in the
+ * POSIXly-correct mode.
+ * Returns false if the word is not a valid number. */
+bool compile_number(const word_T *word, value_T *result)
+{
+    wchar_t wordstr[word->length + 1];
+    wmemcpy(wordstr, word->contents, word->length);
+    wordstr[word->length] = L'\0';
+
+    if (xwcstol(wordstr, 0, &result->v_long)) {
+	result->type = VT_LONG;
+	return true;
+    }
+
+    char *savelocale = xstrdup(setlocale(LC_NUMERIC, NULL));
+    wchar_t *end;
+    setlocale(LC_NUMERIC, "C");
+    errno = 0;
+    result->v_double = wcstod(wordstr, &end);
+    bool ok = (errno == 0 && *end == L'\0');
+    setlocale(LC_NUMERIC, savelocale);
+    free(savelocale);
+    result->type = VT_DOUBLE;
+    return ok;
+}
+
+/* Appends a copy of the specified node to the code being compiled.
+ * Returns the index of the new node. */
+size_t add_node(compileinfo_T *ci, const arithnode_T *node)
+{
+    arithcode_T *code = ci->code;
+    if (code->count == ci->capacity) {
+	ci->capacity = ci->capacity * 2 + 8;
+	code->nodes = xreallocn(code->nodes, ci->capacity, sizeof *code->nodes);
+    }
+    code->nodes[code->count] = *node;
+    return code->count++;
+}
+
+/* Frees the specified compiled expression. */
+void arithcodefree(arithcode_T *code)
+{
+    if (code != NULL) {
+	free(code->exp);
+	free(code->nodes);
+	free(code);
+    }
+}
+
+/* Evaluates the specified compiled expression.
+ * The result is assigned to `*result' and `*info' is updated as if the source
+ * expression were evaluated by `evaluate'. */
+void evaluate_code(const arithcode_T *code,
+	value_T *result, evalinfo_T *info, bool coerce)
+{
+    info->atoken.type = TT_NULL;
+    info->parseonly = false;
+    info->error = false;
+
+    evaluate_node(code, code->root, info, result);
+    if (coerce)
+	coerce_number(info, result);
+}
+
+/* Evaluates the node at the specified index of the compiled expression.
+ * The operands are evaluated in the same order as `parse_assignment' and its
+ * subroutines do, and operands that `parse_assignment' would only parse are
+ * not evaluated at all. */
+void evaluate_node(const arithcode_T *code, size_t index,
+	evalinfo_T *info, value_T *result)
+{
+    const arithnode_T *node = &code->nodes[index];
+    value_T rhs;
+    bool value = false;
+
+    switch (node->type) {
+	case AN_VALUE:
+	    *result = node->value;
+	    return;
+	case AN_ASSIGNMENT:
+	    evaluate_node(code, node->lhs, info, result);
+	    evaluate_node(code, node->rhs, info, &rhs);
+	    apply_assignment(info, node->op, result, &rhs);
+	    return;
+	case AN_CONDITIONAL:
+	    evaluate_node(code, node->cond, info, result);
+	    coerce_number(info, result);
+	    switch (result->type) {
+		case VT_INVALID:  return;
+		case VT_LONG:     value = result->v_long;    break;
+		case VT_DOUBLE:   value = result->v_double;  break;
+		default:          assert(false);
+	    }
+	    evaluate_node(code, value ? node->lhs : node->rhs, info, result);
+	    return;
+	case AN_LOGICAL_OR:
+	case AN_LOGICAL_AND:
+	    evaluate_node(code, node->lhs, info, result);
+	    coerce_number(info, result);
+	    switch (result->type) {
+		case VT_INVALID:  return;
+		case VT_LONG:     value = result->v_long;    break;
+		case VT_DOUBLE:   value = result->v_double;  break;
+		default:          assert(false);
+	    }
+	    if (value == (node->type == AN_LOGICAL_AND)) {
+		evaluate_node(code, node->rhs, info, result);
+		coerce_number(info, result);
+		switch (result->type) {
+		    case VT_INVALID:  return;
+		    case VT_LONG:     value = result->v_long;    break;
+		    case VT_DOUBLE:   value = result->v_double;  break;
+		    default:          assert(false);
+		}
+	    }
+	    result->type = VT_LONG, result->v_long = value;
+	    return;
+	case AN_CALCULATION:
+	    evaluate_node(code, node->lhs, info, result);
+	    evaluate_node(code, node->rhs, info, &rhs);
+	    do_binary_calculation(info, node->op, result, &rhs, result);
+	    return;
+	case AN_COMPARISON:
+	    evaluate_node(code, node->lhs, info, result);
+	    evaluate_node(code, node->rhs, info, &rhs);
+	    apply_comparison(info, node->op, result, &rhs);
+	    return;
+	case AN_PREFIX:
+	    evaluate_node(code, node->lhs, info, result);
+	    apply_prefix_operator(info, node->op, result);
+	    return;
+	case AN_POSTFIX:
+	    evaluate_node(code, node->lhs, info, result);
+	    apply_postfix_operator(info, node->op, result);
+	    return;
+    }
+    assert(false);
+}
+
 /* vim: set ts=8 sts=4 sw=4 noet tw=80: */
@@ -23,10 +23,19 @@
 #include <sys/types.h>
 
 
+typedef struct arithcode_T arithcode_T;
+
 extern wchar_t *evaluate_arithmetic(wchar_t *exp)
     __attribute__((nonnull,malloc,warn_unused_result));
 extern _Bool evaluate_index(wchar_t *exp, ssize_t *valuep)
     __attribute__((nonnull));
+extern arithcode_T *compile_arithmetic(const wchar_t *exp)
+    __attribute__((nonnull,malloc,warn_unused_result));
+extern wchar_t *evaluate_arithcode(const arithcode_T *code)
+    __attribute__((nonnull,malloc,warn_unused_result));
+extern _Bool evaluate_index_arithcode(const arithcode_T *code, ssize_t *valuep)
+    __attribute__((nonnull));
+extern void arithcodefree(arithcode_T *code);
 
 
 #endif /* YASH_ARITH_H */
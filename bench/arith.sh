@@ -0,0 +1,33 @@
+# arith.sh: measures how fast a shell evaluates arithmetic expansions
+# Usage: sh arith.sh shell [count]
+#   shell: the shell to measure, e.g. ../yash
+#   count: number of iterations of each loop (default: 200000)
+# Each loop is a tight counter loop whose body consists of the arithmetic
+# expansion being measured.
+# This is a benchmark tool, not part of yash.
+
+shell="${1:?shell not specified}"
+count="${2:-200000}"
+
+measure() {
+    LC_ALL=C
+    export LC_ALL
+    "$shell" -c "
+	i=0 j=0 k=1
+	start=\$(date +%s.%N)
+	$2
+	end=\$(date +%s.%N)
+	echo \"\$start \$end\"
+    " | awk -v name="$1" -v count="$count" '{
+	printf "%-24s %10.1f loops/s\n", name, count / ($2 - $1)
+    }'
+}
+
+measure 'increment in test' \
+    "while [ \$((i+=1)) -le $count ]; do :; done"
+measure 'colon and assignment' \
+    "while [ \$i -lt $count ]; do : \$((i=i+1)); done"
+measure 'compound expression' \
+    "while [ \$((i+=1)) -le $count ]; do : \$((j=(j*31+i)%65521)) \$((k^=j<<2)); done"
+measure 'array index' \
+    "a=(1 2 3 4); while [ \$((i+=1)) -le $count ]; do : \${a[i%4+1]}; done"
@@ -0,0 +1,56 @@
+# globbench.sh: measures how fast a shell expands recursive glob patterns
+# Usage: sh globbench.sh shell [files [dir]]
+#   shell: the shell to measure, e.g. ../yash
+#   files: number of files in the generated tree (default: 1000000)
+#   dir:   directory in which the tree is generated (default:
+#          /tmp/globbench.<files>)
+# Each leaf directory of the tree contains 100 files, one in ten of which has a
+# name ending with ".c". The tree is generated only if the directory does not
+# exist yet, so remove it after measuring. The time "find" takes to search the
+# same tree is shown for comparison.
+# This is a benchmark tool, not part of yash.
+
+shell="${1:?shell not specified}"
+files="${2:-1000000}"
+dir="${3:-/tmp/globbench.$files}"
+
+# the shell is run in the tree
+case "$shell" in (*/*)
+    shell="$(cd "$(dirname "$shell")" && pwd)/$(basename "$shell")"
+esac
+
+LC_ALL=C
+export LC_ALL
+
+if ! [ -d "$dir" ]; then
+    echo "generating $files files in $dir..." >&2
+    mkdir -p "$dir" || exit
+    awk -v files="$files" 'BEGIN {
+	for (i = 0; i * 100 < files; i++) {
+	    d = sprintf("d%02d/e%02d/f%d", i % 100, int(i / 100) % 100, i)
+	    print d
+	}
+    }' | (cd "$dir" && xargs mkdir -p) || exit
+    awk -v files="$files" 'BEGIN {
+	for (n = 0; n < files; n++) {
+	    i = int(n / 100)
+	    d = sprintf("d%02d/e%02d/f%d", i % 100, int(i / 100) % 100, i)
+	    printf "%s/file%d.%s\n", d, n, (n % 10 == 0) ? "c" : "o"
+	}
+    }' | (cd "$dir" && xargs touch) || exit
+fi
+
+measure() {
+    start=$(date +%s.%N)
+    count=$(cd "$dir" && eval "$2")
+    end=$(date +%s.%N)
+    echo "$start $end $count" | awk -v name="$1" '{
+	printf "%-20s %8.3f s (%d files)\n", name, $2 - $1, $3
+    }'
+}
+
+measure '**/*.c' "\"\$shell\" -o extendedglob -c 'set -- **/*.c; echo \$#'"
+measure '**/file1*' \
+    "\"\$shell\" -o extendedglob -c 'set -- **/file1*; echo \$#'"
+measure '*/*/*/*.c' "\"\$shell\" -c 'set -- */*/*/*.c; echo \$#'"
+measure 'find -name "*.c"' "find . -name '*.c' | wc -l"
@@ -0,0 +1,173 @@
+// This is a benchmark tool, not part of yash
+// It measures the hashtable of hashtable.c with the keys the shell actually
+// uses: the built-in names registered by init_builtin with the names of
+// common external commands as misses, and the variable names of a typical
+// interactive environment with local-looking names as misses. It also checks
+// the table contents after random insertions and removals.
+//   (cd .. && make strbuf.o util.o)
+//   c99 -I.. -o htbench htbench.c ../strbuf.o ../util.o
+//   ./htbench [iterations]
+#include "../hashtable.c"
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+static const char *const builtins[] = {
+    ":", "true", "false", "help", "set", "cd", "pwd", "hash", "umask",
+    "alias", "unalias", "typeset", "export", "local", "readonly", "array",
+    "unset", "shift", "getopts", "read", "pushd", "popd", "dirs", "trap",
+    "kill", "jobs", "fg", "bg", "wait", "disown", "fc", "history", "return",
+    "break", "continue", "eval", ".", "exec", "command", "type", "times",
+    "exit", "suspend", "ulimit", "echo", "printf", "test", "[", "complete",
+    "bindkey",
+};
+static const char *const commands[] = {
+    "ls", "cat", "grep", "sed", "awk", "sort", "uniq", "head", "tail", "cut",
+    "tr", "find", "xargs", "git", "make", "cc", "mkdir", "rm", "cp", "mv",
+    "date", "env", "basename", "dirname", "wc", "less", "ssh", "tar",
+};
+static const wchar_t *const variables[] = {
+    L"CDPATH", L"COLUMNS", L"DIRSTACK", L"ECHO_STYLE", L"ENV", L"FCEDIT",
+    L"HISTFILE", L"HISTRMDUP", L"HISTSIZE", L"HOME", L"IFS", L"LANG",
+    L"LC_ALL", L"LC_COLLATE", L"LC_CTYPE", L"LINENO", L"LINES", L"MAIL",
+    L"MAILCHECK", L"OLDPWD", L"OPTIND", L"PATH", L"PPID", L"PS1", L"PS2",
+    L"PS4", L"PWD", L"RANDOM", L"TERM", L"YASH_LOADPATH", L"YASH_VERSION",
+    L"USER", L"LOGNAME", L"SHELL", L"EDITOR", L"PAGER", L"HOSTNAME",
+    L"DISPLAY", L"XDG_RUNTIME_DIR", L"XDG_SESSION_ID", L"SSH_AUTH_SOCK",
+    L"SSH_CONNECTION", L"DBUS_SESSION_BUS_ADDRESS", L"LESSOPEN", L"MANPATH",
+    L"GOPATH", L"JAVA_HOME", L"LS_COLORS", L"SHLVL", L"TMPDIR", L"=",
+};
+static const wchar_t *const locals[] = {
+    L"i", L"j", L"n", L"x", L"line", L"file", L"dir", L"name", L"value",
+    L"count", L"result", L"REPLY", L"OPTARG", L"status", L"tmp", L"arg",
+};
+#define COUNT(a) (sizeof (a) / sizeof *(a))
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double run_builtins(unsigned long iterations)
+{
+    hashtable_T ht;
+    ht_initwithcapacity(&ht, hashstr, htstrcmp, 53);
+    for (size_t i = 0; i < COUNT(builtins); i++)
+	ht_set(&ht, builtins[i], builtins[i]);
+
+    size_t found = 0;
+    double start = now();
+    for (unsigned long n = 0; n < iterations; n++) {
+	for (size_t i = 0; i < COUNT(builtins); i++)
+	    found += ht_get(&ht, builtins[i]).key != NULL;
+	for (size_t i = 0; i < COUNT(commands); i++)
+	    found += ht_get(&ht, commands[i]).key != NULL;
+    }
+    double time = now() - start;
+    if (found != iterations * COUNT(builtins))
+	printf("builtins: wrong result\n");
+    ht_destroy(&ht);
+    return time / (iterations * (COUNT(builtins) + COUNT(commands)));
+}
+
+static double run_variables(unsigned long iterations)
+{
+    hashtable_T ht;
+    ht_init(&ht, hashwcs, htwcscmp);
+    for (size_t i = 0; i < COUNT(variables); i++)
+	ht_set(&ht, variables[i], variables[i]);
+
+    size_t found = 0;
+    double start = now();
+    for (unsigned long n = 0; n < iterations; n++) {
+	for (size_t i = 0; i < COUNT(variables); i++)
+	    found += ht_get(&ht, variables[i]).key != NULL;
+	for (size_t i = 0; i < COUNT(locals); i++)
+	    found += ht_get(&ht, locals[i]).key != NULL;
+    }
+    double time = now() - start;
+    if (found != iterations * COUNT(variables))
+	printf("variables: wrong result\n");
+    ht_destroy(&ht);
+    return time / (iterations * (COUNT(variables) + COUNT(locals)));
+}
+
+/* Simulates function calls that define and remove local variables. */
+static double run_locals(unsigned long iterations)
+{
+    hashtable_T ht;
+    ht_init(&ht, hashwcs, htwcscmp);
+
+    double start = now();
+    for (unsigned long n = 0; n < iterations; n++) {
+	for (size_t i = 0; i < COUNT(locals); i++)
+	    ht_set(&ht, locals[i], locals[i]);
+	for (size_t i = 0; i < COUNT(locals); i++)
+	    ht_remove(&ht, locals[COUNT(locals) - 1 - i]);
+    }
+    double time = now() - start;
+    ht_destroy(&ht);
+    return time / (iterations * COUNT(locals) * 2);
+}
+
+static int check(void)
+{
+    enum { KEYS = 500, };
+    static size_t keys[KEYS];
+    static bool present[KEYS];
+    hashtable_T ht;
+    int errors = 0;
+
+    for (size_t i = 0; i < KEYS; i++)
+	keys[i] = i * 7919;
+    ht_init(&ht, hashwcs, htwcscmp);
+
+    wchar_t names[KEYS][16];
+    for (size_t i = 0; i < KEYS; i++)
+	swprintf(names[i], 16, L"v%zu", keys[i]);
+
+    srand(1);
+    for (int n = 0; n < 200000; n++) {
+	size_t i = (size_t) rand() % KEYS;
+	if (rand() % 3 == 0) {
+	    kvpair_T kv = ht_remove(&ht, names[i]);
+	    errors += (kv.key != NULL) != present[i];
+	    present[i] = false;
+	} else {
+	    kvpair_T kv = ht_set(&ht, names[i], &keys[i]);
+	    errors += (kv.key != NULL) != present[i];
+	    present[i] = true;
+	}
+	if (n % 1000 == 0) {
+	    size_t count = 0;
+	    for (size_t j = 0; j < KEYS; j++) {
+		kvpair_T kv = ht_get(&ht, names[j]);
+		errors += (kv.key != NULL) != present[j];
+		errors += kv.key != NULL && kv.value != &keys[j];
+		count += present[j];
+	    }
+	    errors += count != ht.count;
+	}
+    }
+    ht_destroy(&ht);
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long iterations =
+	argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+
+    int errors = check();
+    if (errors > 0) {
+	printf("%d inconsistencies found\n", errors);
+	return EXIT_FAILURE;
+    }
+
+    printf("builtin lookup:  %6.1f ns\n", run_builtins(iterations) * 1e9);
+    printf("variable lookup: %6.1f ns\n", run_variables(iterations) * 1e9);
+    printf("local set+remove: %5.1f ns\n", run_locals(iterations) * 1e9);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,211 @@
+// This is a benchmark tool, not part of yash
+// It replays recorded line-editing sessions against a shell running in a
+// pseudo-terminal of 80x24 cells and counts the bytes the shell writes to the
+// terminal for each session. Keys are sent one at a time and the output is
+// drained before the next key, so every key causes a separate display update
+// as it does when a user types on a slow link.
+//   c99 -D_XOPEN_SOURCE=600 -o lereplay lereplay.c
+//   ./lereplay ../yash [session...]
+// Without session operands, all the built-in sessions are replayed. A session
+// operand may also name a file whose contents are sent as keys.
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define LONGLINE \
+    "for file in src/*.c lib/*.c; do gcc -Wall -Wextra -O2 -c \"$file\" " \
+    "-o \"build/${file%.c}.o\" || break; done; echo compiled all the files"
+
+static const struct session {
+    const char *name, *setup, *keys;
+} sessions[] = {
+    { "type", "",
+	"echo " LONGLINE "\x15" },
+    { "insert-middle", "",
+	LONGLINE "\x01\x06\x06\x06\x06\x06\x06\x06\x06"
+	    "some inserted words " "\x15" },
+    { "delete-middle", "",
+	LONGLINE "\x01\x06\x06\x06\x06\x06\x06\x06\x06\x06\x06"
+	    "\x04\x04\x04\x04\x04\x04\x04\x04\x04\x04\x04\x04\x15" },
+    { "move", "",
+	LONGLINE "\x01\x06\x06\x06\x06\x06\x06\x06\x06\x06\x06\x06\x06\x06"
+	    "\x05\x02\x02\x02\x02\x02\x02\x02\x02\x02\x02\x01\x05\x15" },
+    { "transpose", "",
+	LONGLINE "\x01\x06\x06\x06\x06\x06\x06\x06\x06\x06\x06"
+	    "\x14\x14\x14\x14\x14\x14\x14\x14\x14\x14\x14\x14\x15" },
+    { "history",
+	"history -s 'make -C build-debug CFLAGS=-O0 test TESTS=parser-y.tst'\n"
+	"history -s 'make -C build-debug CFLAGS=-O0 test TESTS=lexer-y.tst'\n"
+	"history -s 'make -C build-release CFLAGS=-O2 test TESTS=lexer-y.tst'\n"
+	"history -s 'make -C build-release CFLAGS=-O2 test TESTS=parse.tst'\n",
+	"\x10\x10\x10\x10\x0E\x0E\x0E\x10\x10\x0E\x15" },
+    { "rprompt", "YASH_PS1R='[right prompt]'\n",
+	"echo " LONGLINE "\x01\x06\x06\x06\x06\x06xyz\x08\x08\x08\x15" },
+};
+#define COUNT(a) (sizeof (a) / sizeof *(a))
+
+static int master = -1;
+static pid_t child;
+
+/* Reads output from the terminal until it has been quiet for `quiet'
+ * milliseconds. Returns the number of bytes read. */
+static size_t drain(int quiet)
+{
+    size_t total = 0;
+    for (;;) {
+	struct pollfd pfd = { .fd = master, .events = POLLIN, };
+	int r = poll(&pfd, 1, quiet);
+	if (r < 0 && errno == EINTR)
+	    continue;
+	if (r <= 0)
+	    return total;
+	char buf[4096];
+	ssize_t n = read(master, buf, sizeof buf);
+	if (n <= 0)
+	    return total;
+	total += (size_t) n;
+    }
+}
+
+static void send_string(const char *s)
+{
+    size_t len = strlen(s);
+    while (len > 0) {
+	ssize_t n = write(master, s, len);
+	if (n < 0) {
+	    if (errno == EINTR)
+		continue;
+	    perror("write");
+	    exit(EXIT_FAILURE);
+	}
+	s += n, len -= (size_t) n;
+    }
+}
+
+static void start_shell(const char *shell)
+{
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+	perror("posix_openpt");
+	exit(EXIT_FAILURE);
+    }
+    struct winsize ws = { .ws_row = 24, .ws_col = 80, };
+    ioctl(master, TIOCSWINSZ, &ws);
+
+    child = fork();
+    if (child < 0) {
+	perror("fork");
+	exit(EXIT_FAILURE);
+    }
+    if (child == 0) {
+	const char *name = ptsname(master);
+	setsid();
+	int slave = open(name, O_RDWR);
+	if (slave < 0)
+	    _exit(127);
+	ioctl(slave, TIOCSCTTY, 0);
+	dup2(slave, STDIN_FILENO);
+	dup2(slave, STDOUT_FILENO);
+	dup2(slave, STDERR_FILENO);
+	if (slave > STDERR_FILENO)
+	    close(slave);
+	close(master);
+	setenv("TERM", "xterm", 1);
+	setenv("PS1", "$ ", 1);
+	unsetenv("HISTFILE");
+	execl(shell, shell, "--norcfile", "-i", "--emacs", (char *) NULL);
+	_exit(127);
+    }
+    drain(500);
+}
+
+static void stop_shell(void)
+{
+    send_string("exit\r");
+    drain(200);
+    close(master);
+    kill(child, SIGHUP);
+    waitpid(child, NULL, 0);
+}
+
+static size_t replay(const char *shell, const char *setup, const char *keys)
+{
+    start_shell(shell);
+    for (const char *s = setup; *s != '\0'; s = strchr(s, '\n') + 1) {
+	size_t len = strcspn(s, "\n");
+	char line[256];
+	snprintf(line, sizeof line, "%.*s\r", (int) len, s);
+	send_string(line);
+	drain(200);
+    }
+
+    size_t total = 0;
+    for (const char *k = keys; *k != '\0'; k++) {
+	char key[2] = { *k, '\0', };
+	send_string(key);
+	total += drain(20);
+    }
+    stop_shell();
+    return total;
+}
+
+static char *read_file(const char *name)
+{
+    FILE *f = fopen(name, "r");
+    if (f == NULL)
+	return NULL;
+    static char buf[65536];
+    size_t n = fread(buf, 1, sizeof buf - 1, f);
+    buf[n] = '\0';
+    fclose(f);
+    return buf;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+	fprintf(stderr, "Usage: %s shell [session...]\n", argv[0]);
+	return EXIT_FAILURE;
+    }
+    const char *shell = argv[1];
+
+    size_t sum = 0;
+    for (size_t i = 0; i < COUNT(sessions); i++) {
+	bool selected = argc == 2;
+	for (int j = 2; j < argc; j++)
+	    if (strcmp(argv[j], sessions[i].name) == 0)
+		selected = true;
+	if (!selected)
+	    continue;
+	size_t n = replay(shell, sessions[i].setup, sessions[i].keys);
+	printf("%-14s %7zu bytes\n", sessions[i].name, n);
+	sum += n;
+    }
+    for (int j = 2; j < argc; j++) {
+	bool builtin = false;
+	for (size_t i = 0; i < COUNT(sessions); i++)
+	    if (strcmp(argv[j], sessions[i].name) == 0)
+		builtin = true;
+	if (builtin)
+	    continue;
+	const char *keys = read_file(argv[j]);
+	if (keys == NULL) {
+	    perror(argv[j]);
+	    return EXIT_FAILURE;
+	}
+	size_t n = replay(shell, "", keys);
+	printf("%-14s %7zu bytes\n", argv[j], n);
+	sum += n;
+    }
+    printf("%-14s %7zu bytes\n", "total", sum);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,37 @@
+# match.sh: measures how the time of pattern matching in parameter expansions
+#           grows with the length of the subject string
+# Usage: sh match.sh shell [maxsize]
+#   shell:   the shell to measure, e.g. ../yash
+#   maxsize: length of the longest subject string (default: 10000000)
+# The subject strings are 1000, 10000, ... characters long. Each consists of
+# a's with a single b in the middle. If matching takes linear time, the time
+# grows tenfold from one line to the next.
+# This is a benchmark tool, not part of yash.
+
+shell="${1:?shell not specified}"
+maxsize="${2:-10000000}"
+
+measure() {
+    LC_ALL=C
+    export LC_ALL
+    size=1000
+    while [ "$size" -le "$maxsize" ]; do
+	"$shell" -c "
+	    half=\$(head -c $((size / 2)) /dev/zero | tr '\\0' a)
+	    x=\${half}b\${half}
+	    start=\$(date +%s.%N)
+	    y=$2
+	    end=\$(date +%s.%N)
+	    echo \"\$start \$end\"
+	" | awk -v name="$1" -v size="$size" '{
+	    printf "%-12s %9d chars %10.4f s\n", name, size, $2 - $1
+	}'
+	size=$((size * 10))
+    done
+}
+
+measure '${x#*[b]}'    '${x#*[b]}'
+measure '${x##*[b]}'   '${x##*[b]}'
+measure '${x%[b]*}'    '${x%[b]*}'
+measure '${x%%[b]*}'   '${x%%[b]*}'
+measure '${x//[a]/c}'  '${x//[a]/c}'
@@ -0,0 +1,42 @@
+# output.sh: measures how fast a shell writes to the standard output with
+#            built-ins
+# Usage: sh output.sh shell [count]
+#   shell: the shell to measure, e.g. ../yash
+#   count: number of iterations of each loop (default: 100000)
+# Each loop is run with the standard output redirected to a regular file, where
+# output of consecutive built-ins is buffered, and to a pipe, which is flushed
+# after each built-in.
+# This is a benchmark tool, not part of yash.
+
+shell="${1:?shell not specified}"
+count="${2:-100000}"
+tmpfile="${TMPDIR:-/tmp}/output.$$"
+trap 'rm -f "$tmpfile"' EXIT
+
+measure() {
+    LC_ALL=C
+    export LC_ALL
+    script="
+	i=0
+	while [ \$i -lt $count ]; do
+	    $2
+	    i=\$((i+1))
+	done
+    "
+    start=$(date +%s.%N)
+    "$shell" -c "$script" >"$tmpfile"
+    end=$(date +%s.%N)
+    echo "$start $end" | awk -v name="$1 (file)" -v count="$count" '{
+	printf "%-32s %10.1f loops/s\n", name, count / ($2 - $1)
+    }'
+    start=$(date +%s.%N)
+    "$shell" -c "$script" | cat >/dev/null
+    end=$(date +%s.%N)
+    echo "$start $end" | awk -v name="$1 (pipe)" -v count="$count" '{
+	printf "%-32s %10.1f loops/s\n", name, count / ($2 - $1)
+    }'
+}
+
+measure 'echo'              'echo line $i'
+measure 'printf'            'printf "%d: %s\\n" $i line'
+measure 'three printfs'     'printf a; printf b; printf "%s\\n" $i'
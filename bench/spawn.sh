@@ -0,0 +1,39 @@
+# spawn.sh: measures how many external commands per second a shell runs
+# Usage: sh spawn.sh shell [count [heapsize]]
+#   shell:    the shell to measure, e.g. ../yash
+#   count:    number of commands run in each loop (default: 2000)
+#   heapsize: number of variables defined before the loops to enlarge the
+#             shell's heap, which makes forking the shell slower (default:
+#             20000)
+# This is a benchmark tool, not part of yash.
+
+shell="${1:?shell not specified}"
+count="${2:-2000}"
+heapsize="${3:-20000}"
+
+measure() {
+    LC_ALL=C
+    export LC_ALL
+    start=$(date +%s.%N)
+    "$shell" -c "
+	i=0
+	while [ \$i -lt $heapsize ]; do
+	    eval \"heap_\$i=\$i.\$i.\$i.\$i.\$i.\$i.\$i.\$i.\$i.\$i\"
+	    i=\$((i+1))
+	done
+	start=\$(date +%s.%N)
+	i=0
+	while [ \$i -lt $count ]; do
+	    $2
+	    i=\$((i+1))
+	done
+	end=\$(date +%s.%N)
+	echo \"\$start \$end\"
+    " | awk -v name="$1" -v count="$count" '{
+	printf "%-24s %10.1f commands/s\n", name, count / ($2 - $1)
+    }'
+}
+
+measure 'simple command'       '/bin/true'
+measure 'two-command pipeline' '/bin/true | /bin/true'
+measure 'redirected command'   '/bin/true >/dev/null'
@@ -0,0 +1,40 @@
+# varlookup.sh: measures how fast a shell reads variables in nested functions
+# Usage: sh varlookup.sh shell [count]
+#   shell: the shell to measure, e.g. ../yash
+#   count: number of variable reads in each case (default: 200000)
+# Each case calls a function recursively to the given depth and then reads
+# a global variable repeatedly at the innermost level.
+# This is a benchmark tool, not part of yash.
+
+shell="${1:?shell not specified}"
+count="${2:-200000}"
+
+measure() {
+    LC_ALL=C
+    export LC_ALL
+    "$shell" -c "
+	g=global
+	f() {
+	    if [ \"\$1\" -gt 0 ]; then
+		typeset l=\$1
+		f \$((\$1 - 1))
+		return
+	    fi
+	    i=0
+	    while [ \$i -lt $count ]; do
+		: \"\$g\" \"\$g\" \"\$g\" \"\$g\"
+		i=\$((i + 4))
+	    done
+	}
+	start=\$(date +%s.%N)
+	f $2
+	end=\$(date +%s.%N)
+	echo \"\$start \$end\"
+    " | awk -v name="$1" -v count="$count" '{
+	printf "%-24s %10.1f reads/s\n", name, count / ($2 - $1)
+    }'
+}
+
+measure 'depth 0' 0
+measure 'depth 10' 10
+measure 'depth 100' 100
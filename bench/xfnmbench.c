@@ -0,0 +1,134 @@
+// This is a benchmark tool, not part of yash
+// It compares the glob automaton and the regex fallback of xfnmatch.c on
+// patterns taken from tests/fnmatch-p.tst, tests/case-p.tst and
+// tests/param-p.tst, and checks that both engines agree on every result.
+//   (cd .. && make strbuf.o util.o)
+//   c99 -I.. -o xfnmbench xfnmbench.c ../strbuf.o ../util.o
+//   LC_ALL=C.UTF-8 ./xfnmbench [iterations]
+#include "../xfnmatch.c"
+#include <locale.h>
+#include <stdio.h>
+#include <time.h>
+
+static const wchar_t *const patterns[] = {
+    L"?", L"??", L"?*", L"*?", L"**", L"*ab", L"a*b*c", L"*.c", L"*.[ch]",
+    L"[[]*", L"\\[a", L"[!a]", L"[0-2]", L"[!0-2]", L"[\\.]", L"[\\]]",
+    L"[]a]", L"[!]a]", L"[a-]", L"[-a]", L"[\\\\]", L"[\\\".]", L"[[:alpha:]]",
+    L"[[:digit:]]*", L"[[:upper:][:digit:]]?", L"*[[:space:]]*", L"/*/-*.",
+    L"f*o\\/b?r", L"*/*", L"a?c*", L"*x*y*z*", L"[a", L"[ab", L"\\*",
+    L"*[!a-z]", L"x*[0-9][0-9]",
+};
+static const wchar_t *const subjects[] = {
+    L"", L"a", L"ab", L"abc", L"*ab", L"[a", L"?a", L"]", L".", L"\\",
+    L"0", L"1", L"3", L"A", L"a1", L"Z9", L" ", L"\"", L"-", L"//-/-.-.",
+    L"f*o\\/b?r", L"foo/bar", L"main.c", L"main.h", L"xyz", L"axbyczd",
+    L"x12", L"x1a", L"abcdefghijklmnopqrstuvwxyz0123456789",
+    L"/usr/local/share/yash/completion/git",
+};
+static const xfnmflags_T modes[] = {
+    XFNM_HEADONLY | XFNM_TAILONLY,
+    XFNM_HEADONLY, XFNM_HEADONLY | XFNM_SHORTEST,
+    XFNM_TAILONLY, XFNM_TAILONLY | XFNM_SHORTEST,
+    0,
+    XFNM_HEADONLY | XFNM_TAILONLY | XFNM_CASEFOLD,
+};
+#define COUNT(a) (sizeof (a) / sizeof *(a))
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static xfnmatch_T *compile(
+	const wchar_t *pat, xfnmflags_T flags, bool useglob)
+{
+    return useglob ? try_compile_glob(pat, flags)
+	           : try_compile_regex(pat, flags);
+}
+
+static double run(bool useglob, unsigned long iterations)
+{
+    double start = now();
+    size_t matches = 0;
+
+    for (unsigned long n = 0; n < iterations; n++) {
+	for (size_t p = 0; p < COUNT(patterns); p++) {
+	    xfnmatch_T *xfnm = compile(patterns[p],
+		    XFNM_HEADONLY | XFNM_TAILONLY, useglob);
+	    if (xfnm == NULL)
+		continue;
+	    for (size_t s = 0; s < COUNT(subjects); s++)
+		if (xfnm_wmatch(xfnm, subjects[s]).start != (size_t) -1)
+		    matches++;
+	    xfnm_free(xfnm);
+	}
+    }
+    (void) matches;
+    return now() - start;
+}
+
+static int check(void)
+{
+    int errors = 0;
+
+    for (size_t m = 0; m < COUNT(modes); m++) {
+	for (size_t p = 0; p < COUNT(patterns); p++) {
+	    xfnmatch_T *g = compile(patterns[p], modes[m], true);
+	    xfnmatch_T *r = compile(patterns[p], modes[m], false);
+	    if (g == NULL || r == NULL) {
+		printf("not compiled: %ls (glob=%p, regex=%p)\n",
+			patterns[p], (void *) g, (void *) r);
+		errors++;
+		goto next;
+	    }
+	    for (size_t s = 0; s < COUNT(subjects); s++) {
+		xfnmresult_T gr = xfnm_wmatch(g, subjects[s]);
+		xfnmresult_T rr = xfnm_wmatch(r, subjects[s]);
+		bool headtail = (modes[m] & XFNM_HEADTAIL) == XFNM_HEADTAIL;
+		if (gr.start != rr.start || (!headtail && gr.end != rr.end)) {
+		    printf("mode %#x: %ls vs %ls: "
+			    "glob {%zd,%zd} regex {%zd,%zd}\n",
+			    (unsigned) modes[m], patterns[p], subjects[s],
+			    gr.start, gr.end, rr.start, rr.end);
+		    errors++;
+		}
+		if (modes[m] & XFNM_SHORTEST)
+		    continue;
+		char *mbs = malloc_wcstombs(subjects[s]);
+		if ((xfnm_match(g, mbs) == 0) != (xfnm_match(r, mbs) == 0)) {
+		    printf("mode %#x: %ls vs %ls: multibyte results differ\n",
+			    (unsigned) modes[m], patterns[p], subjects[s]);
+		    errors++;
+		}
+		free(mbs);
+	    }
+next:
+	    xfnm_free(g);
+	    xfnm_free(r);
+	}
+    }
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long iterations = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000;
+
+    setlocale(LC_ALL, "");
+
+    int errors = check();
+    if (errors > 0) {
+	printf("%d mismatches between engines\n", errors);
+	return EXIT_FAILURE;
+    }
+
+    double r = run(false, iterations);
+    double g = run(true, iterations);
+    printf("%zu patterns x %zu subjects x %lu iterations\n",
+	    COUNT(patterns), COUNT(subjects), iterations);
+    printf("regex: %8.3f s\n", r);
+    printf("glob:  %8.3f s  (%.1fx)\n", g, r / g);
+    return EXIT_SUCCESS;
+}
@@ -25,6 +25,7 @@
 # include <libintl.h>
 #endif
 #include <limits.h>
+#include <locale.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -49,6 +50,7 @@ struct format_T {
     struct format_T *next;
     enum formattype_T {
 	FT_NONE, FT_RAW, FT_STRING, FT_CHAR, FT_INT, FT_UINT, FT_FLOAT, FT_ECHO,
+	FT_PLAINSTRING, FT_PLAININT, FT_PLAINHEX,
     } type;
     union {
 	struct {
@@ -67,17 +69,23 @@ struct format_T {
  * specifications. The format types of FT_STRING, FT_CHAR, FT_INT, FT_UINT, and
  * FT_FLOAT are used for various types of conversion specifications (`convspec')
  * that require a value of the corresponding type.
- * The FT_ECHO format type is used for the "b" conversion specification. */
-/* FT_STRING  -> wchar_t *
- * FT_CHAR    -> wint_t
- * FT_INT     -> intmax_t
- * FT_UINT    -> uintmax_t
- * FT_FLOAT   -> long double */
+ * The FT_ECHO format type is used for the "b" conversion specification.
+ * The FT_PLAINSTRING, FT_PLAININT, and FT_PLAINHEX format types are used for
+ * the "s", "d"/"i", and "x" conversion specifications without flags, width,
+ * or precision. They are formatted without `sb_printf'. */
+/* FT_STRING, FT_PLAINSTRING  -> wchar_t *
+ * FT_CHAR                    -> wint_t
+ * FT_INT, FT_PLAININT        -> intmax_t
+ * FT_UINT, FT_PLAINHEX       -> uintmax_t
+ * FT_FLOAT                   -> long double */
 
 enum printf_result_T { PR_OK, PR_OK_END, PR_ERROR, };
 static enum printf_result_T echo_parse_escape(const wchar_t *restrict s,
 	xstrbuf_T *restrict buf, mbstate_t *restrict st)
     __attribute__((nonnull));
+static const struct format_T *printf_get_format(const wchar_t *format)
+    __attribute__((nonnull));
+static void printf_clear_format_cache(void);
 static bool printf_parse_format(
 	const wchar_t *format, struct format_T **resultp)
     __attribute__((nonnull));
@@ -90,6 +98,9 @@ static enum printf_result_T printf_printf(
 	const struct format_T *format, const wchar_t *arg, xstrbuf_T *buf)
     __attribute__((nonnull(1,3)));
 static uintmax_t printf_parse_integer(const wchar_t *arg, bool is_signed);
+static void printf_print_integer(
+	uintmax_t value, bool negative, unsigned base, xstrbuf_T *buf)
+    __attribute__((nonnull));
 static enum printf_result_T printf_print_escape(
 	const struct format_T *format, const wchar_t *arg, xstrbuf_T *buf)
     __attribute__((nonnull));
@@ -196,7 +207,7 @@ print:
     if (ferror(stdout))
 	goto error;
 
-    if (fflush(stdout) != 0)
+    if (!flush_stdout_if_unbuffered())
 	goto error;
 
     sb_destroy(&buf);
@@ -292,11 +303,9 @@ int printf_builtin(int argc, void **argv)
 	return insufficient_operands_error(1);
 
     /* parse the format string */
-    struct format_T *format = NULL;
-    if (!printf_parse_format(ARGV(xoptind), &format)) {
-	freeformat(format);
+    const struct format_T *format = printf_get_format(ARGV(xoptind));
+    if (format == NULL)
 	return Exit_FAILURE;
-    }
     xoptind++;
 
     /* format the operands */
@@ -305,7 +314,7 @@ int printf_builtin(int argc, void **argv)
     sb_init(&buf);
     do {
 	oldoptind = xoptind;
-	for (struct format_T *f = format; f != NULL; f = f->next) {
+	for (const struct format_T *f = format; f != NULL; f = f->next) {
 	    switch (printf_printf(f, ARGV(xoptind), &buf)) {
 		case PR_OK:      break;
 		case PR_OK_END:  goto print;
@@ -315,15 +324,13 @@ int printf_builtin(int argc, void **argv)
     } while (xoptind < argc && xoptind != oldoptind);
 
 print:
-    freeformat(format);
-
     /* print the result to the standard output */
     clearerr(stdout);
     fwrite(buf.contents, sizeof *buf.contents, buf.length, stdout);
     if (ferror(stdout))
 	goto error;
 
-    if (fflush(stdout) != 0)
+    if (!flush_stdout_if_unbuffered())
 	goto error;
 
     sb_destroy(&buf);
@@ -335,6 +342,78 @@ error:
     return Exit_FAILURE;
 }
 
+/* The maximum number of parsed formats kept in `format_cache'. */
+#define FORMAT_CACHE_SIZE 16
+
+/* Formats recently parsed by the "printf" built-in, the most recently used
+ * first. The parse result depends on the LC_CTYPE locale, so the cache is
+ * cleared when the locale has changed from `format_cache_locale'. */
+static struct formatcache_T {
+    wchar_t *fc_format;
+    struct format_T *fc_parsed;
+} format_cache[FORMAT_CACHE_SIZE];
+static size_t format_cache_count;
+static char *format_cache_locale;
+
+/* Returns the parse result of the specified format for the "printf" built-in.
+ * The result is taken from `format_cache' if available. Otherwise, the format
+ * is parsed and the result is added to the cache, evicting the least recently
+ * used one if the cache is full.
+ * The result is valid until the next call to this function.
+ * If the format is invalid, an error message is printed and NULL is
+ * returned. */
+const struct format_T *printf_get_format(const wchar_t *format)
+{
+    const char *locale = setlocale(LC_CTYPE, NULL);
+    if (locale == NULL)
+	locale = "";
+    if (format_cache_locale == NULL
+	    || strcmp(locale, format_cache_locale) != 0) {
+	printf_clear_format_cache();
+	format_cache_locale = xstrdup(locale);
+    }
+
+    struct formatcache_T entry;
+    size_t i;
+    for (i = 0; i < format_cache_count; i++)
+	if (wcscmp(format_cache[i].fc_format, format) == 0)
+	    goto found;
+
+    entry.fc_parsed = NULL;
+    if (!printf_parse_format(format, &entry.fc_parsed)) {
+	freeformat(entry.fc_parsed);
+	return NULL;
+    }
+
+    entry.fc_format = xwcsdup(format);
+    if (format_cache_count == FORMAT_CACHE_SIZE) {
+	format_cache_count--;
+	free(format_cache[format_cache_count].fc_format);
+	freeformat(format_cache[format_cache_count].fc_parsed);
+    }
+    i = format_cache_count++;
+    goto move_to_front;
+
+found:
+    entry = format_cache[i];
+move_to_front:
+    memmove(&format_cache[1], &format_cache[0], i * sizeof *format_cache);
+    format_cache[0] = entry;
+    return entry.fc_parsed;
+}
+
+/* Frees all the entries in `format_cache'. */
+void printf_clear_format_cache(void)
+{
+    while (format_cache_count > 0) {
+	format_cache_count--;
+	free(format_cache[format_cache_count].fc_format);
+	freeformat(format_cache[format_cache_count].fc_parsed);
+    }
+    free(format_cache_locale);
+    format_cache_locale = NULL;
+}
+
 /* Parses the format for the "printf" built-in.
  * If successful, a pointer to the result is assigned to `*resultp' and true is
  * returned.
@@ -480,20 +559,27 @@ parse_width:
 	} while (iswdigit(*format));
     }
 
+    /* no flags, width, or precision? */
+    bool plain = (buf.length == 1);
+
     /* parse conversion specifier */
     switch (*format) {
 	case L'd':  case L'i':
 	    if (hashflag) goto flag_error;
-	    type = FT_INT;
+	    type = plain ? FT_PLAININT : FT_INT;
 	    sb_ccat(&buf, 'j');
 	    break;
 	case L'u':
 	    if (hashflag) goto flag_error;
 	    /* falls thru! */
-	case L'o':  case L'x':  case L'X':
+	case L'o':  case L'X':
 	    type = FT_UINT;
 	    sb_ccat(&buf, 'j');
 	    break;
+	case L'x':
+	    type = plain ? FT_PLAINHEX : FT_UINT;
+	    sb_ccat(&buf, 'j');
+	    break;
 	case L'f':  case L'F': case L'e':  case L'E':  case L'g':  case L'G':
 	    type = FT_FLOAT;
 	    sb_ccat(&buf, 'L');
@@ -505,7 +591,7 @@ parse_width:
 	    break;
 	case L's':
 	    if (hashflag || zeroflag) goto flag_error;
-	    type = FT_STRING;
+	    type = plain ? FT_PLAINSTRING : FT_STRING;
 	    sb_ccat(&buf, 'l');
 	    break;
 	case L'b':
@@ -623,6 +709,17 @@ enum printf_result_T printf_printf(
 	    if (sb_printf(buf, format->value.convspec, arg) < 0)
 		return PR_ERROR;
 	    return PR_OK;
+	case FT_PLAINSTRING:
+	    if (arg == NULL)
+		return PR_OK;
+	    xoptind++;
+	    {
+		mbstate_t state;
+		memset(&state, 0, sizeof state);
+		if (sb_wcscat(buf, arg, &state) != NULL)
+		    return PR_ERROR;
+	    }
+	    return PR_OK;
 	case FT_CHAR:
 	    if (arg != NULL && arg[0] != L'\0') {
 		xoptind++;
@@ -640,6 +737,18 @@ enum printf_result_T printf_printf(
 			printf_parse_integer(arg, false)) < 0)
 		return PR_ERROR;
 	    return PR_OK;
+	case FT_PLAININT:
+	    {
+		uintmax_t value = printf_parse_integer(arg, true);
+		if ((intmax_t) value < 0)
+		    printf_print_integer(-value, true, 10, buf);
+		else
+		    printf_print_integer(value, false, 10, buf);
+	    }
+	    return PR_OK;
+	case FT_PLAINHEX:
+	    printf_print_integer(printf_parse_integer(arg, false), false, 16, buf);
+	    return PR_OK;
 	case FT_FLOAT:
 	    {
 		long double value;
@@ -696,6 +805,25 @@ uintmax_t printf_parse_integer(const wchar_t *arg, bool is_signed)
     return value;
 }
 
+/* Appends the digits of the specified integer in the specified base to buffer
+ * `buf'. If `negative' is true, `value' is the absolute value of the integer
+ * and a minus sign is prepended. Lowercase letters are used for digits greater
+ * than 9. */
+void printf_print_integer(
+	uintmax_t value, bool negative, unsigned base, xstrbuf_T *buf)
+{
+    char digits[sizeof value * CHAR_BIT + 1];
+    char *p = &digits[sizeof digits];
+
+    do {
+	*--p = "0123456789abcdef"[value % base];
+	value /= base;
+    } while (value > 0);
+    if (negative)
+	*--p = '-';
+    sb_ncat_force(buf, p, &digits[sizeof digits] - p);
+}
+
 /* Prints the specified string that may include escape sequences and formats it
  * in the specified format. */
 enum printf_result_T printf_print_escape(
@@ -704,9 +832,18 @@ enum printf_result_T printf_print_escape(
     xstrbuf_T subbuf;
     mbstate_t state;
 
-    sb_init(&subbuf);
     memset(&state, 0, sizeof state);
 
+    if (format->value.echo.width == 0 && format->value.echo.max == ULONG_MAX) {
+	/* no padding or truncation: format directly into `buf' */
+	enum printf_result_T result = echo_parse_escape(s, buf, &state);
+	if (result == PR_OK)
+	    sb_wccat(buf, L'\0', &state);
+	return result;
+    }
+
+    sb_init(&subbuf);
+
     enum printf_result_T result = echo_parse_escape(s, &subbuf, &state);
 
     if (result == PR_OK)
@@ -30,6 +30,9 @@
 # include <paths.h>
 #endif
 #include <signal.h>
+#if HAVE_POSIX_SPAWN
+# include <spawn.h>
+#endif
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -181,6 +184,14 @@ static wchar_t **invoke_simple_command(const commandinfo_T *ci,
 static void exec_external_program(
 	const char *path, int argc, char *argv0, void **argv, char **envs)
     __attribute__((nonnull));
+#if HAVE_POSIX_SPAWN
+static pid_t spawn_pipeline_command(const command_T *c, const pipeinfo_T *pi,
+	int *argcp, void ***argvp)
+    __attribute__((nonnull));
+static pid_t spawn_external_program(const char *path,
+	int argc, char *argv0, void **argv, const pipeinfo_T *pi)
+    __attribute__((nonnull(1,3,4)));
+#endif
 static inline int xexecve(
 	const char *path, char *const *argv, char *const *envp)
     __attribute__((nonnull(1)));
@@ -202,12 +213,16 @@ static void exec_while(const command_T *c, bool finally_exit)
     __attribute__((nonnull));
 static void exec_case(const command_T *c, bool finally_exit)
     __attribute__((nonnull));
+static bool is_literal_word(const wordunit_T *w)
+    __attribute__((pure));
 static void exec_funcdef(const command_T *c, bool finally_exit)
     __attribute__((nonnull));
 
 static fork_and_wait_T fork_and_wait(sigtype_T sigtype)
     __attribute__((warn_unused_result));
 static void become_child(sigtype_T sigtype);
+static void read_command_output(int fd, xwcsbuf_T *buf)
+    __attribute__((nonnull));
 
 static int exec_iteration(void *const *commands, const char *codename)
     __attribute__((nonnull));
@@ -416,20 +431,37 @@ void exec_commands(command_T *const cs, exec_T type)
 	bool is_last = c->next == NULL;
 	next_pipe(&pipe, !is_last);
 
+	int argc = 0;
+	void **argv = NULL;
 	if (is_last && short_circuit)
 	    goto exec_one_command; /* skip forking */
 
 	sigtype_T sigtype = (type == E_ASYNC) ? t_quitint : 0;
-	pid_t pid = fork_and_reset(pgid, type == E_NORMAL, sigtype);
+	pid_t pid = 0;
+#if HAVE_POSIX_SPAWN
+	if (type == E_NORMAL)
+	    pid = spawn_pipeline_command(c, &pipe, &argc, &argv);
+	if (pid == 0)
+#endif
+	    pid = fork_and_reset(pgid, type == E_NORMAL, sigtype);
 	if (pid == 0) {
 exec_one_command: /* child process */
 	    free(job);
 	    connect_pipes(&pipe);
 	    if (type == E_ASYNC && pipe.pi_fromprevfd < 0)
 		maybe_redirect_stdin_to_devnull();
+	    if (argv != NULL) {
+		/* The words have been expanded by `spawn_pipeline_command'. */
+		update_lineno(c->c_lineno);
+		lastcmdsubstatus = Exit_SUCCESS;
+		bool finally_exit =
+		    exec_simple_command_with_words(c, argc, argv, true);
+		(void) finally_exit;  // the subshell exits anyway
+		exit_shell();
+	    }
 	    exec_one_command(c, true);
 	    assert(false);
-	} else if (pid >= 0) {
+	} else if (pid > 0) {
 	    /* parent process: fork succeeded */
 	    if (pgid == 0)
 		pgid = pid;
@@ -444,6 +476,7 @@ exec_one_command: /* child process */
 	    p->pr_statuscode = forkstatus = Exit_NOEXEC;
 	    p->pr_name = NULL;
 	}
+	plfree(argv, free);
     }
 
     assert(pipe.pi_tonextfds[PIPE_IN] < 0);
@@ -1023,12 +1056,22 @@ wchar_t **invoke_simple_command(
 	break;
     case CT_EXTERNALPROGRAM:
 	if (!finally_exit) {
+#if HAVE_POSIX_SPAWN
+	    if (!doing_job_control_now) {
+		pid_t cpid = spawn_external_program(
+			ci->ci_path, argc, argv0, argv, NULL);
+		if (cpid != 0) {
+		    faw.namep = wait_for_child(cpid, 0, false);
+		    break;
+		}
+	    }
+#endif
 	    faw = fork_and_wait(t_leave);
 	    if (faw.cpid != 0)
 		break;
 	    finally_exit = true;
 	}
-	exec_external_program(ci->ci_path, argc, argv0, argv, environ);
+	exec_external_program(ci->ci_path, argc, argv0, argv, get_environ());
 	break;
     case CT_ELECTIVEBUILTIN:
 	if (posixly_correct) {
@@ -1049,6 +1092,7 @@ wchar_t **invoke_simple_command(
 	current_builtin_name = argv[0];
 
 	laststatus = ci->ci_builtin(argc, argv);
+	flush_stdout_if_unbuffered();
 
 	current_builtin_name = savecbn;
 	break;
@@ -1102,9 +1146,133 @@ void exec_external_program(
 	free(mbsargv[i]);
 }
 
+#if HAVE_POSIX_SPAWN
+
+/* Starts simple command `c' in a pipeline with `posix_spawn' if possible.
+ * This is possible only if the command consists of literal words naming an
+ * external program, in which case expanding the words in the shell process
+ * rather than in a subshell has no observable effect. Commands with
+ * assignments or redirections, and commands run under job control, are always
+ * run in a forked subshell.
+ * The command is searched for without modifying the command hashtable, which
+ * a forked subshell would have modified only in its own copy.
+ * Returns the process ID of the spawned process, or 0 if the command has to be
+ * run in a forked subshell. In the latter case, if the words have been
+ * expanded, the results are assigned to `*argcp' and `*argvp' so that the
+ * subshell does not expand them again. Otherwise, `*argvp' is left
+ * unchanged. */
+pid_t spawn_pipeline_command(const command_T *c, const pipeinfo_T *pi,
+	int *argcp, void ***argvp)
+{
+    if (doing_job_control_now || shopt_xtrace)
+	return 0;
+    if (c->c_type != CT_SIMPLE || c->c_assigns != NULL || c->c_redirs != NULL)
+	return 0;
+    for (void **w = c->c_words; *w != NULL; w++)
+	if (!is_literal_word(*w))
+	    return 0;
+
+    int argc;
+    void **argv;
+    if (!expand_line(c->c_words, &argc, &argv))
+	return 0;
+
+    pid_t cpid = 0;
+    if (argc > 0) {
+	char *argv0 = malloc_wcstombs(argv[0]);
+	if (argv0 != NULL && get_builtin(argv0) == NULL
+		&& get_function(argv[0]) == NULL) {
+	    char *path;
+	    if (wcschr(argv[0], L'/') != NULL)
+		path = is_executable_regular(argv0) ? xstrdup(argv0) : NULL;
+	    else
+		path = peek_command_path(argv0);
+	    if (path != NULL)
+		cpid = spawn_external_program(path, argc, argv0, argv, pi);
+	    free(path);
+	}
+	free(argv0);
+    }
+    if (cpid == 0 && argc > 0) {
+	*argcp = argc;
+	*argvp = argv;
+    } else {
+	plfree(argv, free);
+    }
+    return cpid;
+}
+
+/* Starts the external program with `posix_spawn' without forking the shell.
+ * The program inherits the signal settings that `fork_and_reset' with the
+ * `t_leave' option would leave in the child. If `pi' is non-null, the standard
+ * input/output of the program is connected to the pipes like
+ * `connect_pipes'. The arguments are the same as `exec_external_program'.
+ * Returns the process ID of the new process, or 0 if the program could not be
+ * started, in which case no error message is printed: the caller should
+ * retry with `fork' so that the error is reported (or the program is run as
+ * a shell script) in the usual way. */
+pid_t spawn_external_program(const char *path,
+	int argc, char *argv0, void **argv, const pipeinfo_T *pi)
+{
+    sigset_t mask, defaults;
+    if (!get_exec_signal_settings(&mask, &defaults))
+	return 0;
+
+    flush_stdout();
+
+    char *mbsargv[argc + 1];
+    mbsargv[0] = argv0;
+    for (int i = 1; i < argc; i++) {
+	mbsargv[i] = malloc_wcstombs(argv[i]);
+	if (mbsargv[i] == NULL)
+	    mbsargv[i] = xstrdup("");
+    }
+    mbsargv[argc] = NULL;
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK
+	    | POSIX_SPAWN_SETSIGDEF);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (pi != NULL) {
+	if (pi->pi_fromprevfd >= 0) {
+	    posix_spawn_file_actions_adddup2(
+		    &actions, pi->pi_fromprevfd, STDIN_FILENO);
+	    posix_spawn_file_actions_addclose(&actions, pi->pi_fromprevfd);
+	}
+	if (pi->pi_tonextfds[PIPE_OUT] >= 0) {
+	    posix_spawn_file_actions_adddup2(
+		    &actions, pi->pi_tonextfds[PIPE_OUT], STDOUT_FILENO);
+	    posix_spawn_file_actions_addclose(
+		    &actions, pi->pi_tonextfds[PIPE_OUT]);
+	}
+	if (pi->pi_tonextfds[PIPE_IN] >= 0)
+	    posix_spawn_file_actions_addclose(
+		    &actions, pi->pi_tonextfds[PIPE_IN]);
+    }
+
+    pid_t cpid;
+    int err = posix_spawn(
+	    &cpid, path, &actions, &attr, mbsargv, get_environ());
+
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    for (int i = 1; i < argc; i++)
+	free(mbsargv[i]);
+
+    return (err == 0) ? cpid : 0;
+}
+
+#endif /* HAVE_POSIX_SPAWN */
+
 /* Calls `execve' until it doesn't return EINTR. */
 int xexecve(const char *path, char *const *argv, char *const *envp)
 {
+    flush_stdout();
     do
 	execve(path, argv, envp);
     while (errno == EINTR);
@@ -1317,6 +1485,7 @@ void exec_for(const command_T *c, bool finally_exit)
 	    goto done;
 	}
 	exec_and_or_lists(c->c_forcmds, finally_exit && i + 1 == count);
+	flush_stdout_if_unbuffered();
 
 	if (c->c_forcmds == NULL)
 	    handle_signals();
@@ -1359,6 +1528,7 @@ void exec_while(const command_T *c, bool finally_exit)
 	    exec_and_or_lists(c->c_whlcmds, false);
 	    status = laststatus;
 	}
+	flush_stdout_if_unbuffered();
 
 	if (c->c_whlcmds == NULL)
 	    handle_signals();
@@ -1383,14 +1553,34 @@ void exec_case(const command_T *c, bool finally_exit)
 	goto fail;
 
     for (const caseitem_T *ci = c->c_casitems; ci != NULL; ci = ci->next) {
-	for (void **pats = ci->ci_patterns; *pats != NULL; pats++) {
-	    wchar_t *pattern =
-		expand_single(*pats, TT_SINGLE, Q_WORD, ES_QUOTED);
-	    if (pattern == NULL)
-		goto fail;
-
-	    bool match = match_pattern(word, pattern);
-	    free(pattern);
+	for (size_t i = 0; ci->ci_patterns[i] != NULL; i++) {
+	    const wordunit_T *pat = ci->ci_patterns[i];
+	    xfnmatch_T **xfnmp = &ci->ci_xfnms[i];
+	    bool match;
+
+	    if (*xfnmp != NULL && !xfnm_is_outdated(*xfnmp)) {
+		/* use the pattern compiled in the previous execution */
+		match = (xfnm_wmatch(*xfnmp, word).start != (size_t) -1);
+	    } else {
+		wchar_t *pattern =
+		    expand_single(pat, TT_SINGLE, Q_WORD, ES_QUOTED);
+		if (pattern == NULL)
+		    goto fail;
+
+		if (pat != NULL && is_literal_word(pat)
+			&& pat->wu_string[0] != L'~') {
+		    /* The pattern always expands to the same string, so the
+		     * compiled pattern can be reused. */
+		    xfnm_free(*xfnmp);
+		    *xfnmp = xfnm_compile(
+			    pattern, XFNM_HEADONLY | XFNM_TAILONLY);
+		    match = *xfnmp != NULL &&
+			xfnm_wmatch(*xfnmp, word).start != (size_t) -1;
+		} else {
+		    match = match_pattern(word, pattern);
+		}
+		free(pattern);
+	    }
 	    if (match) {
 		if (ci->ci_commands != NULL) {
 		    exec_and_or_lists(ci->ci_commands, finally_exit);
@@ -1415,6 +1605,16 @@ fail:
     goto done;
 }
 
+/* Checks if the specified word contains no parameter expansion, command
+ * substitution, or arithmetic expansion. */
+bool is_literal_word(const wordunit_T *w)
+{
+    for (; w != NULL; w = w->next)
+	if (w->wu_type != WT_STRING)
+	    return false;
+    return true;
+}
+
 /* Executes the function definition. */
 void exec_funcdef(const command_T *c, bool finally_exit)
 {
@@ -1492,6 +1692,7 @@ pid_t fork_and_reset(pid_t pgid, bool fg, sigtype_T sigtype)
 	sigprocmask(SIG_BLOCK, &all, &savemask);
     }
 
+    flush_stdout();
     pid_t cpid = fork();
 
     if (cpid != 0) {
@@ -1544,6 +1745,7 @@ void become_child(sigtype_T sigtype)
 
     restore_signals(sigtype & t_leave);  /* signal mask is restored here */
     clear_shellfds(sigtype & t_leave);
+    discard_read_ahead();
     is_interactive_now = false;
     suppresserrreturn = false;
     exitstatus = -1;
@@ -1581,25 +1783,12 @@ wchar_t *exec_command_substitution(const embedcmd_T *cmdsub)
 	return NULL;
     } else if (cpid > 0) {
 	/* parent process */
-	FILE *f;
+	xwcsbuf_T buf;
 
 	xclose(pipefd[PIPE_OUT]);
-	f = fdopen(pipefd[PIPE_IN], "r");
-	if (f == NULL) {
-	    xerror(errno,
-		    Ngt("cannot open a pipe for the command substitution"));
-	    xclose(pipefd[PIPE_IN]);
-	    lastcmdsubstatus = Exit_NOEXEC;
-	    return NULL;
-	}
-
-	/* read output from the command */
-	xwcsbuf_T buf;
-	wint_t c;
 	wb_init(&buf);
-	while ((c = fgetwc(f)) != WEOF)
-	    wb_wccat(&buf, c);
-	fclose(f);
+	read_command_output(pipefd[PIPE_IN], &buf);
+	xclose(pipefd[PIPE_IN]);
 
 	/* wait for the child to finish */
 	int savelaststatus = laststatus;
@@ -1629,6 +1818,43 @@ wchar_t *exec_command_substitution(const embedcmd_T *cmdsub)
     }
 }
 
+/* Reads the output of a command substitution from file descriptor `fd' until
+ * end-of-file and appends it to buffer `buf' as a wide string.
+ * The output is read in blocks and converted as it arrives, so the whole output
+ * never needs to be kept in both the multibyte and wide forms. A null byte in
+ * the output is converted to a null wide character. If the output contains an
+ * invalid or incomplete character, the rest of the output is ignored. */
+void read_command_output(int fd, xwcsbuf_T *buf)
+{
+    char block[4 * BUFSIZ];
+    size_t pending = 0;  // number of unconverted bytes at the head of `block'
+    mbstate_t state;
+    memset(&state, 0, sizeof state);  // initial shift state
+
+    for (;;) {
+	ssize_t count = read(fd, &block[pending], sizeof block - pending);
+	if (count < 0) {
+	    if (errno == EINTR)
+		continue;
+	    xerror(errno, Ngt("cannot read from the command substitution"));
+	    return;
+	}
+	if (count == 0)
+	    return;  // `pending' bytes at end-of-file are ignored as incomplete
+
+	size_t length = pending + (size_t) count;
+	const char *stop = wb_mbsncat(buf, block, length, &state);
+	if (stop == NULL) {
+	    pending = 0;
+	} else {
+	    pending = &block[length] - stop;
+	    if (pending >= (size_t) MB_CUR_MAX)
+		return;  // invalid character
+	    memmove(block, stop, pending);
+	}
+    }
+}
+
 /* Executes the value of the specified variable.
  * The variable value is parsed as commands.
  * If the `varname' names an array, every element of the array is executed (but
@@ -2269,7 +2495,7 @@ int exec_builtin_2(int argc, void **argv, const wchar_t *as, bool clear)
 	}
 	envs = (char **) pl_toary(&list);
     } else {
-	envs = environ;
+	envs = get_environ();
     }
 
     exec_external_program(commandpath, argc, mbsargv0, argv, envs);
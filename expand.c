@@ -541,9 +541,13 @@ default_:
 	    s = exec_command_substitution(&w->wu_cmdsub);
 	    goto cat_s;
 	case WT_ARITH:
-	    s = expand_single(w->wu_arith, TT_NONE, Q_INDQ, ES_NONE);
-	    if (s != NULL)
-		s = evaluate_arithmetic(s);
+	    if (w->wu_arithcode != NULL) {
+		s = evaluate_arithcode(w->wu_arithcode);
+	    } else {
+		s = expand_single(w->wu_arith, TT_NONE, Q_INDQ, ES_NONE);
+		if (s != NULL)
+		    s = evaluate_arithmetic(s);
+	    }
 cat_s:
 	    if (s == NULL)
 		goto failure;
@@ -660,10 +664,15 @@ struct expand_four_T expand_param(const paramexp_T *p, bool indq)
     if (p->pe_start == NULL) {
 	startindex = 0, endindex = SSIZE_MAX, indextype = IDX_NONE;
     } else {
-	wchar_t *start = expand_single(p->pe_start, TT_NONE, Q_WORD, ES_NONE);
-	if (start == NULL)
-	    goto failure1;
-	indextype = parse_indextype(start);
+	wchar_t *start;
+	if (p->pe_startcode != NULL) {
+	    start = NULL, indextype = IDX_NONE;
+	} else {
+	    start = expand_single(p->pe_start, TT_NONE, Q_WORD, ES_NONE);
+	    if (start == NULL)
+		goto failure1;
+	    indextype = parse_indextype(start);
+	}
 	if (indextype != IDX_NONE) {
 	    startindex = 0, endindex = SSIZE_MAX;
 	    free(start);
@@ -671,11 +680,16 @@ struct expand_four_T expand_param(const paramexp_T *p, bool indq)
 		xerror(0, Ngt("the parameter index is invalid"));
 		goto failure1;
 	    }
-	} else if (!evaluate_index(start, &startindex)) {
+	} else if (start != NULL
+		? !evaluate_index(start, &startindex)
+		: !evaluate_index_arithcode(p->pe_startcode, &startindex)) {
 	    goto failure1;
 	} else {
 	    if (p->pe_end == NULL) {
 		endindex = (startindex == -1) ? SSIZE_MAX : startindex;
+	    } else if (p->pe_endcode != NULL) {
+		if (!evaluate_index_arithcode(p->pe_endcode, &endindex))
+		    goto failure1;
 	    } else {
 		wchar_t *end = expand_single(
 			p->pe_end, TT_NONE, Q_WORD, ES_NONE);
@@ -1061,7 +1075,7 @@ void match_each(void **restrict slist, const wchar_t *restrict pattern,
     if (!(type & PT_MATCHLONGEST))
 	flags |= XFNM_SHORTEST;
 
-    xfnmatch_T *xfnm = xfnm_compile(pattern, flags);
+    const xfnmatch_T *xfnm = xfnm_compile_cached(pattern, flags);
     if (xfnm == NULL)
 	return;
 
@@ -1075,7 +1089,6 @@ void match_each(void **restrict slist, const wchar_t *restrict pattern,
 	    slist[i] = wb_towcs(&buf);
 	}
     }
-    xfnm_free(xfnm);
 }
 
 /* Matches each string in array `slist' to pattern `pattern' and substitutes
@@ -1093,7 +1106,7 @@ void subst_each(void **restrict slist, const wchar_t *pattern,
     if (type & PT_MATCHTAIL)
 	flags |= XFNM_TAILONLY;
 
-    xfnmatch_T *xfnm = xfnm_compile(pattern, flags);
+    const xfnmatch_T *xfnm = xfnm_compile_cached(pattern, flags);
     if (xfnm == NULL)
 	return;
 
@@ -1102,7 +1115,6 @@ void subst_each(void **restrict slist, const wchar_t *pattern,
 	slist[i] = xfnm_subst(xfnm, s, subst, type & PT_SUBSTALL);
 	free(s);
     }
-    xfnm_free(xfnm);
 }
 
 /* Concatenates the wide strings in the specified array.
@@ -19,6 +19,7 @@
 #include "common.h"
 #include "hashtable.h"
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
@@ -36,27 +37,34 @@
  *      size_t             count;
  *      hashfunc_T        *hashfunc;
  *      keycmp             keycmp;
- *      size_t             emptyindex;
- *      size_t             tailindex;
- *      size_t            *indices;
+ *      size_t             growthleft;
+ *      unsigned char     *controls;
  *      struct hash_entry *entries;
  *   }
- * `capacity' is the size of array `entries'.
+ * `capacity' is the size of array `entries', which is always a power of two
+ * no less than GROUP_SIZE.
  * `count' is the number of entries contained in the hashtable.
  * `hashfunc' is a pointer to the hash function.
  * `keycmp' is a pointer to the function that compares keys.
- * `emptyindex' is the index of the first empty entry.
- * `tailindex' is the index of the first tail entry.
- * `indices' is a pointer to the bucket array.
+ * `growthleft' is the number of empty entries that can be occupied before the
+ * table must be rehashed.
+ * `controls' is a pointer to the array of control bytes.
  * `entries' is a pointer to the array of entries.
  *
- * The collision resolution strategy used in this implementation is a kind of
- * separate chaining, but it differs from normal chaining in that entries are
- * stored in a single array (`entries'). An advantage over normal chaining,
- * which stores entries in linked lists, is spatial locality: entries can be
- * quickly referenced because they are collected in one array. Another advantage
- * is that we don't have to call `malloc' or `free' each time an entry is added
- * or removed. */
+ * The collision resolution strategy used in this implementation is open
+ * addressing. Each entry has a control byte in `controls' that tells whether
+ * the entry is empty, deleted, or occupied, and in the last case, contains
+ * seven bits of the hash value of the key. A lookup examines the control bytes
+ * of GROUP_SIZE consecutive entries at a time, packed into one integer, and
+ * compares the keys of only the entries whose control bytes match. The hash
+ * value of each key is stored in the entry as well, so the comparison function
+ * is called only when the full hash values are equal.
+ * The control byte array has GROUP_SIZE extra bytes at the end, which mirror
+ * the first GROUP_SIZE bytes, so that a group can start at any entry.
+ * The groups examined for a key follow a triangular probe sequence, which
+ * visits every group once if the capacity is a power of two.
+ * At least one eighth of the entries are always empty (not deleted), which
+ * guarantees that every probe sequence terminates. */
 
 
 //#define DEBUG_HASH 1
@@ -69,12 +77,8 @@ static void print_statistics(const hashtable_T *ht);
 #endif
 
 
-/* The null index */
-#define NOTHING ((size_t) -1)
-
 /* hashtable entry */
 struct hash_entry {
-    size_t next;
     hashval_T hash;
     kvpair_T kv;
 };
@@ -82,97 +86,295 @@ struct hash_entry {
  * When an entry is unoccupied, the values of the other members of the entry are
  * unspecified. */
 
+/* values of control bytes */
+#define CTRL_EMPTY   0x80
+#define CTRL_DELETED 0xFE
+/* The control byte of an occupied entry is between 0x00 and 0x7F. */
+
+/* number of control bytes examined at a time */
+#define GROUP_SIZE 8
+
+/* A group of control bytes packed in an integer, the control byte of the
+ * first entry in the least significant byte. */
+typedef uint_least64_t group_T;
+#define GROUP_LSBS UINT64_C(0x0101010101010101)
+#define GROUP_MSBS UINT64_C(0x8080808080808080)
+
+/* probe sequence */
+typedef struct probe_T {
+    size_t position, stride;
+} probe_T;
+
+static inline group_T load_group(const unsigned char *controls)
+    __attribute__((nonnull,pure));
+static inline group_T match_byte(group_T group, unsigned char c)
+    __attribute__((const));
+static inline group_T match_empty(group_T group)
+    __attribute__((const));
+static inline group_T match_empty_or_deleted(group_T group)
+    __attribute__((const));
+static inline size_t lowest_match(group_T match)
+    __attribute__((const));
+static inline size_t highest_match(group_T match)
+    __attribute__((const));
+static inline uint_least64_t spread(hashval_T hash)
+    __attribute__((const));
+static inline unsigned char control_byte(uint_least64_t spread)
+    __attribute__((const));
+static inline probe_T probe_start(const hashtable_T *ht, uint_least64_t spread)
+    __attribute__((nonnull,pure));
+static inline void probe_next(const hashtable_T *ht, probe_T *probe)
+    __attribute__((nonnull));
+static inline void set_control(hashtable_T *ht, size_t index, unsigned char c)
+    __attribute__((nonnull));
+static inline size_t find_entry(const hashtable_T *ht,
+	hashval_T hash, const void *key, size_t *restrict slotp)
+    __attribute__((nonnull(1,3),always_inline));
+static size_t find_insert_slot(const hashtable_T *ht, uint_least64_t spread)
+    __attribute__((nonnull,pure));
+static size_t capacity_for(size_t count)
+    __attribute__((const));
+static size_t max_load(size_t capacity)
+    __attribute__((const));
+static void rehash(hashtable_T *ht, size_t newcapacity)
+    __attribute__((nonnull));
+
+
+/* Reads GROUP_SIZE control bytes starting from the specified one.
+ * The bytes are assembled one by one so that the result does not depend on the
+ * byte order of the machine. Compilers usually turn this into a single load. */
+group_T load_group(const unsigned char *controls)
+{
+    return (group_T) controls[0]
+	| (group_T) controls[1] << 8
+	| (group_T) controls[2] << 16
+	| (group_T) controls[3] << 24
+	| (group_T) controls[4] << 32
+	| (group_T) controls[5] << 40
+	| (group_T) controls[6] << 48
+	| (group_T) controls[7] << 56;
+}
 
-/* Initializes a hashtable with the specified capacity.
- * `hashfunc' is a hash function to hash keys.
- * `keycmp' is a function that compares two keys. */
-hashtable_T *ht_initwithcapacity(
-	hashtable_T *ht, hashfunc_T *hashfunc, keycmp_T *keycmp,
-	size_t capacity)
+/* Returns a bit mask that has the most significant bit of each byte set if the
+ * byte in the group may be equal to `c'. There may be false positives in the
+ * bytes above a true match, which the caller must filter out. */
+group_T match_byte(group_T group, unsigned char c)
 {
-    if (capacity == 0)
-	capacity = 1;
+    group_T x = group ^ (GROUP_LSBS * c);
+    return (x - GROUP_LSBS) & ~x & GROUP_MSBS;
+}
 
-    ht->capacity = capacity;
-    ht->count = 0;
-    ht->hashfunc = hashfunc;
-    ht->keycmp = keycmp;
-    ht->emptyindex = NOTHING;
-    ht->tailindex = 0;
-    ht->indices = xmallocn(capacity, sizeof *ht->indices);
-    ht->entries = xmallocn(capacity, sizeof *ht->entries);
+/* Returns a bit mask that has the most significant bit of each byte set if the
+ * byte in the group is CTRL_EMPTY. */
+group_T match_empty(group_T group)
+{
+    /* CTRL_EMPTY is the only value that has bit 7 set and bit 1 cleared. */
+    return group & ~(group << 6) & GROUP_MSBS;
+}
 
-    for (size_t i = 0; i < capacity; i++) {
-	ht->indices[i] = NOTHING;
-	ht->entries[i].kv.key = NULL;
+/* Returns a bit mask that has the most significant bit of each byte set if the
+ * byte in the group is CTRL_EMPTY or CTRL_DELETED. */
+group_T match_empty_or_deleted(group_T group)
+{
+    return group & GROUP_MSBS;
+}
+
+/* Returns the index of the lowest byte whose most significant bit is set in
+ * the non-zero mask. */
+size_t lowest_match(group_T match)
+{
+#ifdef __GNUC__
+    return (size_t) __builtin_ctzll(match) / 8;
+#else
+    /* Isolate the lowest bit and move it to bit 0 of the byte. The product
+     * then has the byte index in its most significant byte. */
+    group_T bit = (match & (~match + 1)) >> 7;
+    return (size_t) (((bit * UINT64_C(0x0001020304050607)) >> 56) & 0xFF);
+#endif
+}
+
+/* Returns the index of the highest byte whose most significant bit is set in
+ * the non-zero mask. */
+size_t highest_match(group_T match)
+{
+#ifdef __GNUC__
+    return (size_t) (63 - __builtin_clzll(match)) / 8;
+#else
+    size_t index = GROUP_SIZE - 1;
+    while (((match >> (8 * index + 7)) & 1) == 0)
+	index--;
+    return index;
+#endif
+}
+
+/* Scrambles the hash value returned by the hash function so that every bit of
+ * the result depends on all the bits of the value. This is necessary because
+ * some hash functions (e.g. for process IDs) return poorly distributed values.
+ */
+uint_least64_t spread(hashval_T hash)
+{
+    uint_least64_t h = ((uint_least64_t) hash * UINT64_C(0x9E3779B97F4A7C15))
+	& UINT64_C(0xFFFFFFFFFFFFFFFF);
+    return h ^ (h >> 32);
+}
+
+/* Returns the control byte for an entry with the specified spread hash. */
+unsigned char control_byte(uint_least64_t spread)
+{
+    return (unsigned char) (spread & 0x7F);
+}
+
+/* Returns the start of the probe sequence for the specified spread hash. */
+probe_T probe_start(const hashtable_T *ht, uint_least64_t spread)
+{
+    return (probe_T) {
+	.position = (size_t) (spread >> 7) & (ht->capacity - 1),
+	.stride = 0,
+    };
+}
+
+/* Advances the probe sequence to the next group. */
+void probe_next(const hashtable_T *ht, probe_T *probe)
+{
+    probe->stride += GROUP_SIZE;
+    probe->position = (probe->position + probe->stride) & (ht->capacity - 1);
+}
+
+/* Sets the control byte of the specified entry, updating the mirror. */
+void set_control(hashtable_T *ht, size_t index, unsigned char c)
+{
+    ht->controls[index] = c;
+    if (index < GROUP_SIZE)
+	ht->controls[ht->capacity + index] = c;
+}
+
+/* Returns the index of the entry that has the specified key, or `capacity' if
+ * there is no such entry.
+ * If `slotp' is non-NULL and no entry is found, the index of the first empty or
+ * deleted entry in the probe sequence is assigned to `*slotp'. */
+size_t find_entry(const hashtable_T *ht,
+	hashval_T hash, const void *key, size_t *restrict slotp)
+{
+    uint_least64_t s = spread(hash);
+    unsigned char c = control_byte(s);
+    for (probe_T p = probe_start(ht, s); ; probe_next(ht, &p)) {
+	group_T group = load_group(&ht->controls[p.position]);
+	for (group_T m = match_byte(group, c); m != 0; m &= m - 1) {
+	    size_t index =
+		(p.position + lowest_match(m)) & (ht->capacity - 1);
+	    const struct hash_entry *entry = &ht->entries[index];
+	    if (entry->kv.key != NULL && entry->hash == hash
+		    && ht->keycmp(entry->kv.key, key) == 0)
+		return index;
+	}
+	if (slotp != NULL) {
+	    group_T m = match_empty_or_deleted(group);
+	    if (m != 0) {
+		*slotp = (p.position + lowest_match(m)) & (ht->capacity - 1);
+		slotp = NULL;
+	    }
+	}
+	if (match_empty(group) != 0)
+	    return ht->capacity;
+    }
+}
+
+/* Returns the index of the first empty or deleted entry in the probe sequence
+ * for the specified spread hash. */
+size_t find_insert_slot(const hashtable_T *ht, uint_least64_t spread)
+{
+    for (probe_T p = probe_start(ht, spread); ; probe_next(ht, &p)) {
+	group_T group = load_group(&ht->controls[p.position]);
+	group_T m = match_empty_or_deleted(group);
+	if (m != 0)
+	    return (p.position + lowest_match(m)) & (ht->capacity - 1);
     }
+}
 
-    return ht;
+/* Returns the number of entries that can be occupied in a hashtable of the
+ * specified capacity. */
+size_t max_load(size_t capacity)
+{
+    return capacity - capacity / 8;
 }
 
-/* Changes the capacity of the specified hashtable.
- * If the specified new capacity is smaller than the number of the entries in
- * the hashtable, the capacity is not changed.
- * Note that the capacity cannot be zero. If `newcapacity' is zero, it is
- * assumed to be one. */
-/* Capacity should be an odd integer, especially a prime number. */
-hashtable_T *ht_setcapacity(hashtable_T *ht, size_t newcapacity)
+/* Returns the smallest valid capacity that can hold `count' entries. */
+size_t capacity_for(size_t count)
 {
-    if (newcapacity == 0)
-	newcapacity = 1;
-    if (newcapacity < ht->count)
-	newcapacity = ht->count;
+    size_t capacity = GROUP_SIZE;
+    while (max_load(capacity) < count)
+	capacity = mul(capacity, 2);
+    return capacity;
+}
+
+/* Moves all the entries into new arrays of the specified capacity, removing
+ * deleted entries. `newcapacity' must be a valid capacity. */
+void rehash(hashtable_T *ht, size_t newcapacity)
+{
+    assert(newcapacity >= GROUP_SIZE);
+    assert((newcapacity & (newcapacity - 1)) == 0);
+    assert(max_load(newcapacity) >= ht->count);
 
     size_t oldcapacity = ht->capacity;
-    size_t *oldindices = ht->indices;
-    size_t *newindices = xmallocn(newcapacity, sizeof *ht->indices);
+    unsigned char *oldcontrols = ht->controls;
     struct hash_entry *oldentries = ht->entries;
-    struct hash_entry *newentries = xmallocn(newcapacity, sizeof *ht->entries);
-    size_t tail = 0;
 
-    for (size_t i = 0; i < newcapacity; i++) {
-	newindices[i] = NOTHING;
-	newentries[i].kv.key = NULL;
-    }
+    ht->capacity = newcapacity;
+    ht->growthleft = max_load(newcapacity) - ht->count;
+    ht->controls = xmalloc(add(newcapacity, GROUP_SIZE));
+    ht->entries = xmallocn(newcapacity, sizeof *ht->entries);
+    memset(ht->controls, CTRL_EMPTY, newcapacity + GROUP_SIZE);
+    for (size_t i = 0; i < newcapacity; i++)
+	ht->entries[i].kv.key = NULL;
 
-    /* move the data from oldentries to newentries */
     for (size_t i = 0; i < oldcapacity; i++) {
-	void *key = oldentries[i].kv.key;
-	if (key != NULL) {
-	    hashval_T hash = oldentries[i].hash;
-	    size_t newindex = (size_t) hash % newcapacity;
-	    newentries[tail] = (struct hash_entry) {
-		.next = newindices[newindex],
-		.hash = hash,
-		.kv = oldentries[i].kv,
-	    };
-	    newindices[newindex] = tail;
-	    tail++;
+	if (oldentries[i].kv.key != NULL) {
+	    uint_least64_t s = spread(oldentries[i].hash);
+	    size_t index = find_insert_slot(ht, s);
+	    set_control(ht, index, control_byte(s));
+	    ht->entries[index] = oldentries[i];
 	}
     }
 
-    free(oldindices);
+    free(oldcontrols);
     free(oldentries);
-    ht->capacity = newcapacity;
-    ht->emptyindex = NOTHING;
-    ht->tailindex = tail;
-    ht->indices = newindices;
-    ht->entries = newentries;
+}
+
+/* Initializes a hashtable with the specified capacity.
+ * `hashfunc' is a hash function to hash keys.
+ * `keycmp' is a function that compares two keys. */
+hashtable_T *ht_initwithcapacity(
+	hashtable_T *ht, hashfunc_T *hashfunc, keycmp_T *keycmp,
+	size_t capacity)
+{
+    ht->capacity = 0;
+    ht->count = 0;
+    ht->hashfunc = hashfunc;
+    ht->keycmp = keycmp;
+    ht->controls = NULL;
+    ht->entries = NULL;
+    rehash(ht, capacity_for(capacity));
+    return ht;
+}
+
+/* Changes the capacity of the specified hashtable so that it can contain
+ * `newcapacity' entries without rehashing.
+ * If the specified new capacity is smaller than the number of the entries in
+ * the hashtable, the capacity is reduced to fit the entries. */
+hashtable_T *ht_setcapacity(hashtable_T *ht, size_t newcapacity)
+{
+    if (newcapacity < ht->count)
+	newcapacity = ht->count;
+    rehash(ht, capacity_for(newcapacity));
     return ht;
 }
 
 /* Increases the capacity as large as necessary
- * so that the capacity is no less than the specified. */
+ * so that the hashtable can contain `capacity' entries without rehashing. */
 hashtable_T *ht_ensurecapacity(hashtable_T *ht, size_t capacity)
 {
-    if (capacity <= ht->capacity)
+    if (capacity <= ht->count + ht->growthleft)
 	return ht;
-
-    size_t cap15 = ht->capacity + (ht->capacity >> 1);
-    if (capacity < cap15)
-	capacity = cap15;
-    if (capacity < ht->capacity + 6)
-	capacity = ht->capacity + 6;
     return ht_setcapacity(ht, capacity);
 }
 
@@ -182,24 +384,22 @@ hashtable_T *ht_ensurecapacity(hashtable_T *ht, size_t capacity)
  * The capacity of the hashtable is not changed. */
 hashtable_T *ht_clear(hashtable_T *ht, void freer(kvpair_T kv))
 {
-    size_t *indices = ht->indices;
     struct hash_entry *entries = ht->entries;
 
-    if (ht->count == 0)
+    if (ht->count == 0 && ht->growthleft == max_load(ht->capacity))
 	return ht;
 
     for (size_t i = 0, cap = ht->capacity; i < cap; i++) {
-	indices[i] = NOTHING;
 	if (entries[i].kv.key != NULL) {
 	    if (freer)
 		freer(entries[i].kv);
 	    entries[i].kv.key = NULL;
 	}
     }
+    memset(ht->controls, CTRL_EMPTY, ht->capacity + GROUP_SIZE);
 
     ht->count = 0;
-    ht->emptyindex = NOTHING;
-    ht->tailindex = 0;
+    ht->growthleft = max_load(ht->capacity);
     return ht;
 }
 
@@ -208,14 +408,9 @@ hashtable_T *ht_clear(hashtable_T *ht, void freer(kvpair_T kv))
 kvpair_T ht_get(const hashtable_T *ht, const void *key)
 {
     if (key != NULL) {
-	hashval_T hash = ht->hashfunc(key);
-	size_t index = ht->indices[(size_t) hash % ht->capacity];
-	while (index != NOTHING) {
-	    struct hash_entry *entry = &ht->entries[index];
-	    if (entry->hash == hash && ht->keycmp(entry->kv.key, key) == 0)
-		return entry->kv;
-	    index = entry->next;
-	}
+	size_t index = find_entry(ht, ht->hashfunc(key), key, NULL);
+	if (index < ht->capacity)
+	    return ht->entries[index].kv;
     }
     return (kvpair_T) { NULL, NULL, };
 }
@@ -230,39 +425,35 @@ kvpair_T ht_set(hashtable_T *ht, const void *key, const void *value)
 
     /* if there is an entry with the specified key, simply replace the value */
     hashval_T hash = ht->hashfunc(key);
-    size_t mhash = (size_t) hash % ht->capacity;
-    size_t index = ht->indices[mhash];
-    struct hash_entry *entry;
-    while (index != NOTHING) {
-	entry = &ht->entries[index];
-	if (entry->hash == hash && ht->keycmp(entry->kv.key, key) == 0) {
-	    kvpair_T oldkv = entry->kv;
-	    entry->kv = (kvpair_T) { (void *) key, (void *) value, };
-	    DEBUG_PRINT_STATISTICS(ht);
-	    return oldkv;
-	}
-	index = entry->next;
+    size_t slot;
+    size_t index = find_entry(ht, hash, key, &slot);
+    if (index < ht->capacity) {
+	struct hash_entry *entry = &ht->entries[index];
+	kvpair_T oldkv = entry->kv;
+	entry->kv = (kvpair_T) { (void *) key, (void *) value, };
+	DEBUG_PRINT_STATISTICS(ht);
+	return oldkv;
     }
 
     /* No entry with the specified key was found; we add a new entry. */
-    index = ht->emptyindex;
-    if (index != NOTHING) {
-	/* if there is an empty entry, use it */
-	entry = &ht->entries[index];
-	ht->emptyindex = entry->next;
-    } else {
-	/* if there is no empty entry, use a tail entry */
-	ht_ensurecapacity(ht, ht->count + 1);
-	mhash = (size_t) hash % ht->capacity;
-	index = ht->tailindex++;
-	entry = &ht->entries[index];
+    uint_least64_t s = spread(hash);
+    index = slot;
+    if (ht->growthleft == 0 && ht->controls[index] == CTRL_EMPTY) {
+	/* If more than half of the unoccupied entries are deleted ones, we can
+	 * make room by just rehashing. Otherwise, we grow the table. */
+	if (ht->count < max_load(ht->capacity) / 2)
+	    rehash(ht, ht->capacity);
+	else
+	    rehash(ht, mul(ht->capacity, 2));
+	index = find_insert_slot(ht, s);
     }
-    *entry = (struct hash_entry) {
-	.next = ht->indices[mhash],
+    if (ht->controls[index] == CTRL_EMPTY)
+	ht->growthleft--;
+    set_control(ht, index, control_byte(s));
+    ht->entries[index] = (struct hash_entry) {
 	.hash = hash,
 	.kv = (kvpair_T) { (void *) key, (void *) value, },
     };
-    ht->indices[mhash] = index;
     ht->count++;
     DEBUG_PRINT_STATISTICS(ht);
     return (kvpair_T) { NULL, NULL, };
@@ -273,21 +464,31 @@ kvpair_T ht_set(hashtable_T *ht, const void *key, const void *value)
 kvpair_T ht_remove(hashtable_T *ht, const void *key)
 {
     if (key != NULL) {
-	hashval_T hash = ht->hashfunc(key);
-	size_t *indexp = &ht->indices[(size_t) hash % ht->capacity];
-	while (*indexp != NOTHING) {
-	    size_t index = *indexp;
+	size_t index = find_entry(ht, ht->hashfunc(key), key, NULL);
+	if (index < ht->capacity) {
 	    struct hash_entry *entry = &ht->entries[index];
-	    if (entry->hash == hash && ht->keycmp(entry->kv.key, key) == 0) {
-		kvpair_T oldkv = entry->kv;
-		*indexp = entry->next;
-		entry->next = ht->emptyindex;
-		ht->emptyindex = index;
-		entry->kv.key = NULL;
-		ht->count--;
-		return oldkv;
+	    kvpair_T oldkv = entry->kv;
+
+	    /* If the entry may be in the middle of the probe sequence of
+	     * another key, it must be marked as deleted rather than empty.
+	     * That is not the case if every group containing the entry has an
+	     * empty entry, because then no probe has ever gone past them. */
+	    size_t before = (index - GROUP_SIZE) & (ht->capacity - 1);
+	    group_T emptybefore, emptyafter;
+	    emptybefore = match_empty(load_group(&ht->controls[before]));
+	    emptyafter = match_empty(load_group(&ht->controls[index]));
+	    if (emptybefore != 0 && emptyafter != 0
+		    && lowest_match(emptyafter)
+			+ (GROUP_SIZE - 1 - highest_match(emptybefore))
+			< GROUP_SIZE) {
+		set_control(ht, index, CTRL_EMPTY);
+		ht->growthleft++;
+	    } else {
+		set_control(ht, index, CTRL_DELETED);
 	    }
-	    indexp = &entry->next;
+	    entry->kv.key = NULL;
+	    ht->count--;
+	    return oldkv;
 	}
     }
     return (kvpair_T) { NULL, NULL, };
@@ -438,17 +639,20 @@ void print_statistics(const hashtable_T *ht)
 {
     fprintf(stderr, "DEBUG: id=%p hash->count=%zu, capacity=%zu\n",
 	    (void *) ht, ht->count, ht->capacity);
-    fprintf(stderr, "DEBUG: hash->emptyindex=%zu, tailindex=%zu\n",
-	    ht->emptyindex, ht->tailindex);
-
-    unsigned emptycount = 0, collcount = 0;
-    for (size_t i = ht->emptyindex; i != NOTHING; i = ht->entries[i].next)
-	emptycount++;
-    for (size_t i = 0; i < ht->capacity; i++)
-	if (ht->entries[i].kv.key && ht->entries[i].next != NOTHING)
-	    collcount++;
-    fprintf(stderr, "DEBUG: hash empties=%u collisions=%u\n\n",
-	    emptycount, collcount);
+    fprintf(stderr, "DEBUG: hash->growthleft=%zu\n", ht->growthleft);
+
+    unsigned deletedcount = 0, displacedcount = 0;
+    for (size_t i = 0; i < ht->capacity; i++) {
+	if (ht->controls[i] == CTRL_DELETED)
+	    deletedcount++;
+	if (ht->entries[i].kv.key != NULL) {
+	    probe_T p = probe_start(ht, spread(ht->entries[i].hash));
+	    if (((i - p.position) & (ht->capacity - 1)) >= GROUP_SIZE)
+		displacedcount++;
+	}
+    }
+    fprintf(stderr, "DEBUG: hash deleted=%u displaced=%u\n\n",
+	    deletedcount, displacedcount);
 }
 #endif
 
@@ -46,8 +46,8 @@ typedef struct hashtable_T {
     size_t capacity, count;
     hashfunc_T *hashfunc;
     keycmp_T *keycmp;
-    size_t emptyindex, tailindex;
-    size_t *indices;
+    size_t growthleft;
+    unsigned char *controls;
     struct hash_entry *entries;
 } hashtable_T;
 typedef struct kvpair_T {
@@ -112,7 +112,7 @@ hashtable_T *ht_init(hashtable_T *ht, hashfunc_T *hashfunc, keycmp_T *keycmp)
  * Note that this function doesn't `free' any keys or values. */
 void ht_destroy(hashtable_T *ht)
 {
-    free(ht->indices);
+    free(ht->controls);
     free(ht->entries);
 }
 
@@ -31,6 +31,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#if HAVE_MMAP
+# include <sys/mman.h>
+#endif
 #include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
@@ -47,6 +50,9 @@
 #include "util.h"
 #include "variable.h"
 #include "yash.h"
+#if YASH_ENABLE_LINEEDIT
+# include "lineedit/editing.h"
+#endif
 
 
 /* The maximum size of history list (<= INT_MAX / 10) */
@@ -92,6 +98,15 @@ histlist_T histlist = {
  * (`link.next') member points to the oldest entry. When there's no entries,
  * `Newest' and `Oldest' point to `histlist' itself. */
 
+/* The entries of `histlist' in the same order, stored in a ring buffer so that
+ * an entry can be found by its position in constant time.
+ * The `i'th oldest entry (counting from zero) is `*index_slot(i)'.
+ * The `capacity' is zero or a power of two. */
+static struct {
+    histentry_T **entries;
+    size_t capacity, start;
+} histindex = { NULL, 0, 0, };
+
 /* The maximum limit of the number of an entry.
  * Must always be no less than `histsize' or `HISTORY_MIN_MAX_NUMBER'.
  * The number of any entry is not greater than this value. */
@@ -112,6 +127,12 @@ static long histfilerev = -1;
 static size_t histfilelines = 0;
 /* Indicates if the history file should be flushed before it is unlocked. */
 static bool histneedflush = false;
+/* True if the history file is in the binary format. */
+static bool histfilebinary = false;
+/* The offset of the next record to be read from the binary history file. */
+static off_t histfileoffset;
+/* Records to be appended to the binary history file when it is unlocked. */
+static xstrbuf_T histfilebuf = { .contents = NULL, };
 
 /* The current time returned by `time' */
 static time_t now = (time_t) -1;
@@ -134,6 +155,15 @@ static void remove_entry(histentry_T *e)
     __attribute__((nonnull));
 static void remove_last_entry(void);
 static void clear_all_entries(void);
+static inline histentry_T **index_slot(size_t i)
+    __attribute__((pure));
+static void index_append(histentry_T *e)
+    __attribute__((nonnull));
+static void index_remove(size_t i);
+static unsigned normalize_number(unsigned number)
+    __attribute__((pure));
+static size_t index_position(unsigned number)
+    __attribute__((pure));
 static struct search_result_T search_entry_by_number(unsigned number)
     __attribute__((pure));
 static histlink_T *get_nth_newest_entry(unsigned n)
@@ -158,7 +188,9 @@ static bool read_line(FILE *restrict f, xwcsbuf_T *restrict buf)
 static bool try_read_line(FILE *restrict f, xwcsbuf_T *restrict buf)
     __attribute__((nonnull));
 static long read_signature(void);
+static long read_binary_signature(void);
 static void read_history_raw(void);
+static bool read_history_file(void);
 static void read_history(void);
 static void parse_history_entry(const wchar_t *line)
     __attribute__((nonnull));
@@ -166,13 +198,32 @@ static void parse_removed_entry(const wchar_t *numstr)
     __attribute__((nonnull));
 static void parse_process_id(const wchar_t *numstr)
     __attribute__((nonnull));
+static void remove_entry_by_number(unsigned long num);
+static void apply_process_id(intmax_t num);
+static bool read_history_binary(void);
+static size_t parse_binary_records(const unsigned char *data, size_t size)
+    __attribute__((nonnull));
+static void parse_binary_record(const unsigned char *p, size_t len)
+    __attribute__((nonnull));
+static uint_least32_t record_checksum(const unsigned char *p, size_t len)
+    __attribute__((nonnull,pure));
+static uint_least64_t get_be(const unsigned char *p, size_t n)
+    __attribute__((nonnull,pure));
+static void put_be(xstrbuf_T *buf, uint_least64_t value, size_t n)
+    __attribute__((nonnull));
 static void update_history(bool refresh);
 static void maybe_refresh_file(void);
 static int wprintf_histfile(const wchar_t *format, ...)
     __attribute__((nonnull));
+static void write_binary_record(const xstrbuf_T *payload)
+    __attribute__((nonnull));
+static void flush_binary_records(void);
 static void write_signature(void);
 static void write_history_entry(const histentry_T *entry)
     __attribute__((nonnull));
+static void write_cancel_record(void);
+static void write_delete_record(unsigned number);
+static void write_pid_record(intmax_t pid);
 static void refresh_file(void);
 
 static void add_history_line(const wchar_t *line, size_t maxlen)
@@ -223,11 +274,20 @@ histentry_T *new_entry(unsigned number, time_t time, const char *line)
     histlist.Newest = new->Prev->next = &new->link;
     new->number = number;
     new->time = time;
+    new->signature = history_signature(line);
+#if YASH_ENABLE_LINEEDIT
+    new->prediction_weight = 0.0;
+#endif
     strcpy(new->value, line);
 
+    index_append(new);
     histlist.count++;
     assert(histlist.count <= histsize);
 
+#if YASH_ENABLE_LINEEDIT
+    le_prediction_add_history_entry(new);
+#endif
+
     return new;
 }
 
@@ -251,6 +311,15 @@ void remove_entry(histentry_T *entry)
 {
     assert(!hist_lock);
     assert(&entry->link != Histlist);
+#if YASH_ENABLE_LINEEDIT
+    le_prediction_remove_history_entry(entry);
+#endif
+    if (&entry->link == histlist.Oldest)
+	index_remove(0);
+    else if (&entry->link == histlist.Newest)
+	index_remove(histlist.count - 1);
+    else
+	index_remove(index_position(entry->number));
     entry->Prev->next = entry->Next;
     entry->Next->prev = entry->Prev;
     histlist.count--;
@@ -282,6 +351,9 @@ void clear_all_entries(void)
 {
     assert(!hist_lock);
 
+#if YASH_ENABLE_LINEEDIT
+    le_prediction_clear_history();
+#endif
     histlink_T *l = histlist.Oldest;
     while (l != Histlist) {
 	histlink_T *next = l->next;
@@ -290,6 +362,97 @@ void clear_all_entries(void)
     }
     histlist.Oldest = histlist.Newest = Histlist;
     histlist.count = 0;
+    histindex.start = 0;
+}
+
+/* Returns a pointer to the slot of `histindex' for the `i'th oldest entry. */
+histentry_T **index_slot(size_t i)
+{
+    return &histindex.entries[(histindex.start + i) & (histindex.capacity - 1)];
+}
+
+/* Adds `e' to the end of `histindex'.
+ * Must be called before `histlist.count' is incremented. */
+void index_append(histentry_T *e)
+{
+    size_t count = histlist.count;
+    if (count == histindex.capacity) {
+	size_t newcapacity = (count > 0) ? mul(count, 2) : 16;
+	histentry_T **newentries = xmallocn(newcapacity, sizeof *newentries);
+	for (size_t i = 0; i < count; i++)
+	    newentries[i] = *index_slot(i);
+	free(histindex.entries);
+	histindex.entries = newentries;
+	histindex.capacity = newcapacity;
+	histindex.start = 0;
+    }
+    *index_slot(count) = e;
+}
+
+/* Removes the `i'th oldest entry from `histindex'.
+ * The entries on the shorter side of the removed one are shifted.
+ * Must be called before `histlist.count' is decremented. */
+void index_remove(size_t i)
+{
+    size_t count = histlist.count;
+    assert(i < count);
+    assert(*index_slot(i) == ashistentry(
+		i == 0 ? histlist.Oldest : (*index_slot(i - 1))->Next));
+    if (i < count / 2) {
+	for (; i > 0; i--)
+	    *index_slot(i) = *index_slot(i - 1);
+	histindex.start = (histindex.start + 1) & (histindex.capacity - 1);
+    } else {
+	for (; i + 1 < count; i++)
+	    *index_slot(i) = *index_slot(i + 1);
+    }
+}
+
+/* Maps an entry number to a value that increases monotonically from the
+ * oldest entry to the newest, taking the wrap-around at `max_number' into
+ * account. The history must not be empty. */
+unsigned normalize_number(unsigned number)
+{
+    unsigned oldest = ashistentry(histlist.Oldest)->number;
+    unsigned newest = ashistentry(histlist.Newest)->number;
+    if (newest < oldest && number <= newest)
+	number += max_number;
+    return number;
+}
+
+/* Returns the position of the oldest entry whose number is not less than
+ * `number' (in terms of `normalize_number'). The position is `histlist.count'
+ * if there is no such entry.
+ * As entry numbers increase by at least one per entry, the position is
+ * guessed from the difference from the oldest number. The guess is exact
+ * unless some entries have been removed or skipped, in which case the entry
+ * is searched for by bisection below the guess. */
+size_t index_position(unsigned number)
+{
+    if (histlist.count == 0)
+	return 0;
+
+    unsigned oldest = ashistentry(histlist.Oldest)->number;
+    unsigned target = normalize_number(number);
+    if (target <= oldest)
+	return 0;
+
+    size_t lo = 0, hi = target - oldest;
+    if (hi >= histlist.count)
+	hi = histlist.count;
+    else if (normalize_number((*index_slot(hi))->number) == target)
+	return hi;
+    else
+	hi++;
+    /* The answer is in [lo, hi). */
+    while (lo < hi) {
+	size_t mid = lo + (hi - lo) / 2;
+	if (normalize_number((*index_slot(mid))->number) < target)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return lo;
 }
 
 /* Searches for the entry that has the specified `number'.
@@ -307,48 +470,19 @@ struct search_result_T search_entry_by_number(unsigned number)
 	return result;
     }
 
-    unsigned oldestnum = ashistentry(histlist.Oldest)->number;
-    unsigned nnewestnum = ashistentry(histlist.Newest)->number;
-    unsigned nnumber = number;
-    if (nnewestnum < oldestnum) {
-	if (nnumber <= nnewestnum)
-	    nnumber += max_number;
-	nnewestnum += max_number;
-    }
-    if (nnumber < oldestnum) {
-	result.prev = Histlist;
-	result.next = histlist.Oldest;
-	return result;
-    } else if (nnumber > nnewestnum) {
+    size_t i = index_position(number);
+    if (i == histlist.count) {
 	result.prev = histlist.Newest;
 	result.next = Histlist;
 	return result;
     }
 
-    histlink_T *l;
-    if (2 * (nnumber - oldestnum) < nnewestnum - oldestnum) {
-	/* search from the oldest */
-	l = histlist.Oldest;
-	while (number < ashistentry(l)->number)
-	    l = l->next;
-	while (number > ashistentry(l)->number)
-	    l = l->next;
-	result.next = l;
-	if (number != ashistentry(l)->number)
-	    l = l->prev;
-	result.prev = l;
-    } else {
-	/* search from the newest */
-	l = histlist.Newest;
-	while (number > ashistentry(l)->number)
-	    l = l->prev;
-	while (number < ashistentry(l)->number)
-	    l = l->prev;
-	result.prev = l;
-	if (number != ashistentry(l)->number)
-	    l = l->next;
-	result.next = l;
-    }
+    histentry_T *e = *index_slot(i);
+    result.next = &e->link;
+    if (e->number == number)
+	result.prev = &e->link;
+    else
+	result.prev = e->Prev;
     return result;
 }
 
@@ -358,11 +492,9 @@ histlink_T *get_nth_newest_entry(unsigned n)
 {
     if (histlist.count <= n)
 	return histlist.Oldest;
-
-    histlink_T *l = Histlist;
-    while (n-- > 0)
-	l = l->prev;
-    return l;
+    if (n == 0)
+	return Histlist;
+    return &(*index_slot(histlist.count - n))->link;
 }
 
 /* Searches for the newest entry whose value begins with the specified `prefix'.
@@ -395,14 +527,7 @@ bool search_result_is_newer(
 bool entry_is_newer(const histentry_T *e1, const histentry_T *e2)
 {
     assert(histlist.count > 0);
-
-    unsigned n1 = e1->number;
-    unsigned n2 = e2->number;
-    unsigned newest = ashistentry(histlist.Newest)->number;
-    unsigned oldest = ashistentry(histlist.Oldest)->number;
-
-    return (n1 <= newest && newest < oldest && oldest <= n2)
-	|| (n2 <= n1 && (oldest <= n2 || n1 <= newest));
+    return normalize_number(e1->number) > normalize_number(e2->number);
 }
 
 
@@ -464,7 +589,7 @@ void write_histfile_pids(void)
 {
     assert(histfile != NULL);
     for (size_t i = 0; i < histfilepids.count; i++)
-	wprintf_histfile(L"p%jd\n", (intmax_t) histfilepids.pids[i]);
+	write_pid_record((intmax_t) histfilepids.pids[i]);
     histfilelines += histfilepids.count;
 }
 
@@ -504,8 +629,36 @@ void write_histfile_pids(void)
  *    pXXX
  * where `XXX' is the process id (decimal integer). For addition `XXX' is
  * positive and for elimination `XXX' is negative.
+ *
+ ***** BINARY FORMAT OF THE HISTORY FILE *****
+ *
+ * The history file may alternatively be in the binary format, which can be
+ * read without converting every line to a wide string. The first line has the
+ * following fixed-length form:
+ *    #$# yash history v1 rXXXXXXXXXXXXXXXXXXXX
+ * where the revision number is padded with zeros to 20 digits.
+ *
+ * The rest of the file is a sequence of records. A record consists of:
+ *    a 4-byte length of the payload,
+ *    a 4-byte checksum of the payload (see `record_checksum'), and
+ *    the payload, whose first byte is the type of the record.
+ * All integers are unsigned big-endian. The record types correspond to the
+ * line types of the text format:
+ *    'e'   history entry: 4-byte number, 8-byte time (all ones if unknown),
+ *          and the command (without a terminating null byte)
+ *    'c'   history entry cancellation: no data
+ *    'd'   history entry deletion: 4-byte number
+ *    'p'   shell process addition/elimination: 8-byte two's complement process
+ *          id
+ * Records are appended to the end of the file. A record that is truncated or
+ * has a wrong checksum ends the valid part of the file, and the file is
+ * refreshed at the next chance.
  */
 
+#define BINARY_SIGNATURE "#$# yash history v1 r"
+#define BINARY_SIGNATURE_LENGTH (sizeof BINARY_SIGNATURE - 1 + 20 + 1)
+#define RECORD_HEADER_LENGTH 8
+
 /* Opens the history file.
  * Returns NULL on failure. */
 FILE *open_histfile(void)
@@ -551,6 +704,8 @@ FILE *open_histfile(void)
  * Returns true iff successful. */
 bool lock_histfile(short type)
 {
+    if (type == F_UNLCK)
+	flush_binary_records();
     if (type == F_UNLCK && histneedflush) {
 	histneedflush = false;
 	fflush(histfile);
@@ -639,7 +794,8 @@ bool try_read_line(FILE *restrict f, xwcsbuf_T *restrict buf)
 /* Reads the signature of the history file (`histfile') and checks if it is a
  * valid signature.
  * If valid:
- *   - the file is positioned just after the signature,
+ *   - `histfilebinary' is set according to the format of the file,
+ *   - the file is positioned just after the signature if in the text format,
  *   - the return value is the revision of the file (non-negative).
  * Otherwise:
  *   - the file position is undefined,
@@ -653,9 +809,15 @@ long read_signature(void)
 
     assert(histfile != NULL);
     rewind(histfile);
+
+    rev = read_binary_signature();
+    histfilebinary = (rev >= 0);
+    if (histfilebinary)
+	return rev;
+
     if (!read_line(histfile, wb_initwithmax(&buf, HISTORY_DEFAULT_LINE_LENGTH)))
 	goto end;
-    
+
     s = matchwcsprefix(buf.contents, L"#$# yash history v0 r");
     if (s == NULL || !iswdigit(s[0]))
 	goto end;
@@ -667,6 +829,29 @@ end:
     return rev;
 }
 
+/* Reads the signature of the history file in the binary format.
+ * Returns the revision of the file if the signature is valid. Otherwise,
+ * returns a negative value. The file position is not changed. */
+long read_binary_signature(void)
+{
+    char sig[BINARY_SIGNATURE_LENGTH + 1];
+    ssize_t n;
+
+    while ((n = pread(fileno(histfile), sig, BINARY_SIGNATURE_LENGTH, 0)) < 0
+	    && errno == EINTR);
+    if (n != (ssize_t) BINARY_SIGNATURE_LENGTH)
+	return -1;
+    sig[BINARY_SIGNATURE_LENGTH] = '\0';
+
+    const char *s = matchstrprefix(sig, BINARY_SIGNATURE);
+    if (s == NULL || s[strspn(s, "0123456789")] != '\n')
+	return -1;
+
+    errno = 0;
+    long rev = strtol(s, NULL, 10);
+    return (errno == 0) ? rev : -1;
+}
+
 /* Reads history entries from the history file, which must have been open.
  * The file format is assumed a simple text, one entry per line.
  * The file is read from the current position.
@@ -727,6 +912,20 @@ void read_history(void)
     wb_destroy(&buf);
 }
 
+/* Reads history entries from the history file in the format of the file.
+ * In the text format, the file is read from the current position. In the
+ * binary format, the file is read from `histfileoffset'.
+ * Returns false on error. */
+/* The file should be locked. */
+bool read_history_file(void)
+{
+    if (histfilebinary)
+	return read_history_binary();
+
+    read_history();
+    return !ferror(histfile) && feof(histfile);
+}
+
 void parse_history_entry(const wchar_t *line)
 {
     unsigned long num;
@@ -779,12 +978,7 @@ void parse_removed_entry(const wchar_t *numstr)
     num = wcstoul(numstr, &end, 0x10);
     if (errno || (*end != L'\0' && !iswspace(*end)))
 	return;
-    if (num > max_number)
-	return;
-
-    struct search_result_T sr = search_entry_by_number((unsigned) num);
-    if (sr.prev == sr.next)
-	remove_entry(ashistentry(sr.prev));
+    remove_entry_by_number(num);
 }
 
 void parse_process_id(const wchar_t *numstr)
@@ -799,6 +993,24 @@ void parse_process_id(const wchar_t *numstr)
     num = wcstoimax(numstr, &end, 10);
     if (errno || (*end != L'\0' && !iswspace(*end)))
 	return;
+    apply_process_id(num);
+}
+
+/* Removes the entry that has the specified number, if any. */
+void remove_entry_by_number(unsigned long num)
+{
+    if (num > max_number)
+	return;
+
+    struct search_result_T sr = search_entry_by_number((unsigned) num);
+    if (sr.prev == sr.next)
+	remove_entry(ashistentry(sr.prev));
+}
+
+/* Adds or removes a process ID to or from `histfilepids' according to the
+ * sign of `num'. */
+void apply_process_id(intmax_t num)
+{
     if (num > 0)
 	add_histfile_pid((pid_t) num);
     else if (num < 0)
@@ -806,6 +1018,151 @@ void parse_process_id(const wchar_t *numstr)
     /* XXX: this cast and negation may be unsafe */
 }
 
+/* Reads records from the binary history file, starting at `histfileoffset'.
+ * The file contents are mapped into memory if possible.
+ * Returns false on error. */
+/* The file should be locked. */
+bool read_history_binary(void)
+{
+    int fd = fileno(histfile);
+    struct stat st;
+
+    if (fstat(fd, &st) < 0 || st.st_size < histfileoffset)
+	return false;
+    if (st.st_size == histfileoffset)
+	return true;
+
+    size_t size = (size_t) (st.st_size - histfileoffset);
+    size_t consumed;
+#if HAVE_MMAP
+    long pagesize = sysconf(_SC_PAGESIZE);
+    if (pagesize <= 0)
+	pagesize = 1;
+    off_t base = histfileoffset - histfileoffset % pagesize;
+    size_t skip = (size_t) (histfileoffset - base);
+    void *map = mmap(NULL, skip + size, PROT_READ, MAP_SHARED, fd, base);
+    if (map != MAP_FAILED) {
+	consumed = parse_binary_records((unsigned char *) map + skip, size);
+	munmap(map, skip + size);
+	goto done;
+    }
+#endif /* HAVE_MMAP */
+
+    unsigned char *data = xmalloc(size);
+    size_t n = 0;
+    while (n < size) {
+	ssize_t r = pread(fd, data + n, size - n, histfileoffset + n);
+	if (r < 0 && errno == EINTR)
+	    continue;
+	if (r <= 0)
+	    break;
+	n += (size_t) r;
+    }
+    consumed = parse_binary_records(data, n);
+    free(data);
+#if HAVE_MMAP
+done:
+#endif
+    if (consumed < size) {
+	/* The rest of the file is broken. Skip it and refresh the file. */
+	histfileoffset = st.st_size;
+	histfilelines = SIZE_MAX / 2;
+    } else {
+	histfileoffset += consumed;
+    }
+    return true;
+}
+
+/* Parses records in `data' and applies them to the history.
+ * Returns the number of bytes of the valid records that were parsed. */
+size_t parse_binary_records(const unsigned char *data, size_t size)
+{
+    size_t i = 0;
+    while (size - i >= RECORD_HEADER_LENGTH) {
+	size_t len = (size_t) get_be(&data[i], 4);
+	const unsigned char *payload = &data[i + RECORD_HEADER_LENGTH];
+	if (len == 0 || len > size - i - RECORD_HEADER_LENGTH)
+	    break;
+	if (get_be(&data[i + 4], 4) != record_checksum(payload, len))
+	    break;
+	parse_binary_record(payload, len);
+	histfilelines++;
+	i += RECORD_HEADER_LENGTH + len;
+    }
+    return i;
+}
+
+/* Applies a record of the binary history file to the history.
+ * `p' is the payload of the record and `len' is its length. */
+void parse_binary_record(const unsigned char *p, size_t len)
+{
+    switch (p[0]) {
+	case 'e': {
+	    if (len < 1 + 4 + 8 || memchr(&p[13], '\0', len - 13) != NULL)
+		break;
+
+	    unsigned long num = (unsigned long) get_be(&p[1], 4);
+	    uint_least64_t t = get_be(&p[5], 8);
+	    time_t time;
+	    if (num == 0 || num > max_number)
+		break;
+	    if (t == UINT64_C(0xFFFFFFFFFFFFFFFF))
+		time = -1;
+	    else if (t > (uint_least64_t) now)
+		time = now;
+	    else
+		time = (time_t) t;
+
+	    char *value = xmalloc(len - 13 + 1);
+	    memcpy(value, &p[13], len - 13);
+	    value[len - 13] = '\0';
+	    new_entry((unsigned) num, time, value);
+	    free(value);
+	    break;
+	}
+	case 'c':
+	    remove_last_entry();
+	    break;
+	case 'd':
+	    if (len >= 1 + 4 && histlist.count > 0)
+		remove_entry_by_number((unsigned long) get_be(&p[1], 4));
+	    break;
+	case 'p':
+	    if (len >= 1 + 8)
+		apply_process_id((intmax_t) (int_least64_t) get_be(&p[1], 8));
+	    break;
+    }
+}
+
+/* Computes the checksum of a record payload: the 32-bit FNV-1a hash. */
+uint_least32_t record_checksum(const unsigned char *p, size_t len)
+{
+    uint_least32_t hash = UINT32_C(2166136261);
+    for (size_t i = 0; i < len; i++) {
+	hash ^= p[i];
+	hash = (hash * UINT32_C(16777619)) & UINT32_C(0xFFFFFFFF);
+    }
+    return hash;
+}
+
+/* Returns the `n'-byte big-endian unsigned integer at `p'. */
+uint_least64_t get_be(const unsigned char *p, size_t n)
+{
+    uint_least64_t value = 0;
+    for (size_t i = 0; i < n; i++)
+	value = value << 8 | p[i];
+    return value;
+}
+
+/* Appends `value' to `buf' as an `n'-byte big-endian unsigned integer. */
+void put_be(xstrbuf_T *buf, uint_least64_t value, size_t n)
+{
+    while (n > 0) {
+	n--;
+	sb_ccat(buf, (char) ((value >> (8 * n)) & 0xFF));
+    }
+}
+
 /* Re-reads history from the history file.
  * Changes that have been made to the file by other shell processes are brought
  * into this shell's history. The current data in this shell's history may be
@@ -820,7 +1177,7 @@ void parse_process_id(const wchar_t *numstr)
  * This function must be called just before writing to the history file. */
 void update_history(bool refresh)
 {
-    bool posfail;
+    bool posfail, wasbinary;
     fpos_t pos;
     long rev;
 
@@ -833,13 +1190,15 @@ void update_history(bool refresh)
 #else
     posfail = fgetpos(histfile, &pos);
 #endif
+    wasbinary = histfilebinary;
     rev = read_signature();
     if (rev < 0)
 	goto error;
-    if (!posfail && rev == histfilerev) {
+    if (rev == histfilerev && wasbinary == histfilebinary
+	    && (histfilebinary || !posfail)) {
 	/* The revision has not been changed. Just read new entries. */
-	fsetpos(histfile, &pos);
-	read_history();
+	if (!histfilebinary)
+	    fsetpos(histfile, &pos);
     } else {
 	/* The revision has been changed. Re-read everything. */
 	clear_all_entries();
@@ -847,9 +1206,9 @@ void update_history(bool refresh)
 	add_histfile_pid(shell_pid);
 	histfilerev = rev;
 	histfilelines = 0;
-	read_history();
+	histfileoffset = BINARY_SIGNATURE_LENGTH;
     }
-    if (ferror(histfile) || !feof(histfile))
+    if (!read_history_file())
 	goto error;
 
     if (refresh)
@@ -900,7 +1259,16 @@ void write_signature(void)
 	histfilerev = 0;
     else
 	histfilerev++;
-    wprintf_histfile(L"#$# yash history v0 r%ld\n", histfilerev);
+    if (histfilebuf.contents != NULL)
+	sb_clear(&histfilebuf);
+    if (histfilebinary) {
+	if (histfilebuf.contents == NULL)
+	    sb_init(&histfilebuf);
+	sb_printf(&histfilebuf, BINARY_SIGNATURE "%020ld\n", histfilerev);
+	histfileoffset = 0;
+    } else {
+	wprintf_histfile(L"#$# yash history v0 r%ld\n", histfilerev);
+    }
     histfilelines = 0;
 }
 
@@ -912,6 +1280,21 @@ void write_history_entry(const histentry_T *entry)
 {
     assert(histfile != NULL);
 
+    if (histfilebinary) {
+	xstrbuf_T payload;
+	sb_initwithmax(&payload, 13 + strlen(entry->value));
+	sb_ccat(&payload, 'e');
+	put_be(&payload, entry->number, 4);
+	put_be(&payload, entry->time >= 0
+		? (uint_least64_t) entry->time : UINT64_C(0xFFFFFFFFFFFFFFFF),
+		8);
+	sb_cat(&payload, entry->value);
+	write_binary_record(&payload);
+	sb_destroy(&payload);
+	histfilelines++;
+	return;
+    }
+
     /* don't print very long line */
     if (xstrnlen(entry->value, LINE_MAX) >= LINE_MAX)
 	return;
@@ -925,6 +1308,91 @@ void write_history_entry(const histentry_T *entry)
     histfilelines++;
 }
 
+/* Writes a history entry cancellation to the history file. */
+/* The file should be locked. */
+void write_cancel_record(void)
+{
+    if (histfilebinary) {
+	xstrbuf_T payload;
+	sb_init(&payload);
+	sb_ccat(&payload, 'c');
+	write_binary_record(&payload);
+	sb_destroy(&payload);
+    } else {
+	wprintf_histfile(L"c\n");
+    }
+}
+
+/* Writes a history entry deletion to the history file. */
+/* The file should be locked. */
+void write_delete_record(unsigned number)
+{
+    if (histfilebinary) {
+	xstrbuf_T payload;
+	sb_init(&payload);
+	sb_ccat(&payload, 'd');
+	put_be(&payload, number, 4);
+	write_binary_record(&payload);
+	sb_destroy(&payload);
+    } else {
+	wprintf_histfile(L"d%X\n", number);
+    }
+}
+
+/* Writes a shell process addition (if `pid' is positive) or elimination (if
+ * negative) to the history file. */
+/* The file should be locked. */
+void write_pid_record(intmax_t pid)
+{
+    if (histfilebinary) {
+	xstrbuf_T payload;
+	sb_init(&payload);
+	sb_ccat(&payload, 'p');
+	put_be(&payload, (uint_least64_t) pid, 8);
+	write_binary_record(&payload);
+	sb_destroy(&payload);
+    } else {
+	wprintf_histfile(L"p%jd\n", pid);
+    }
+}
+
+/* Frames the specified record payload and appends it to `histfilebuf'.
+ * The record is actually written to the file by `flush_binary_records'. */
+void write_binary_record(const xstrbuf_T *payload)
+{
+    if (histfilebuf.contents == NULL)
+	sb_init(&histfilebuf);
+    put_be(&histfilebuf, payload->length, 4);
+    put_be(&histfilebuf, record_checksum(
+		(const unsigned char *) payload->contents, payload->length), 4);
+    sb_ncat_force(&histfilebuf, payload->contents, payload->length);
+}
+
+/* Appends the contents of `histfilebuf' to the binary history file.
+ * As this process has read all the records in the file before writing, the
+ * written records are not read again. */
+/* The file should be locked. */
+void flush_binary_records(void)
+{
+    if (histfilebuf.contents == NULL || histfilebuf.length == 0)
+	return;
+
+    int fd = fileno(histfile);
+    off_t end = lseek(fd, 0, SEEK_END);
+    size_t n = 0;
+    while (n < histfilebuf.length) {
+	ssize_t r = write(fd, &histfilebuf.contents[n], histfilebuf.length - n);
+	if (r < 0 && errno == EINTR)
+	    continue;
+	if (r <= 0)
+	    break;
+	n += (size_t) r;
+    }
+    if (end >= 0 && end == histfileoffset)
+	histfileoffset = end + n;
+    sb_clear(&histfilebuf);
+}
+
 /* Clears and rewrites the contents of the history file.
  * The file will have a new revision number. */
 /* The file should be locked. */
@@ -979,8 +1447,8 @@ void maybe_init_history(void)
 	    read_history_raw();
 	    goto refresh;
 	}
-	read_history();
-	if (ferror(histfile) || !feof(histfile)) {
+	histfileoffset = BINARY_SIGNATURE_LENGTH;
+	if (!read_history_file()) {
 	    close_history_file();
 	    return;
 	}
@@ -995,7 +1463,7 @@ refresh:
 	}
 
 	add_histfile_pid(shell_pid);
-	wprintf_histfile(L"p%jd\n", (intmax_t) shell_pid);
+	write_pid_record((intmax_t) shell_pid);
 	histfilelines++;
 
 	lock_histfile(F_UNLCK);
@@ -1014,7 +1482,7 @@ void finalize_history(void)
     update_time();
     update_history(true);
     if (histfile != NULL) {
-	wprintf_histfile(L"p%jd\n", (intmax_t) -shell_pid);
+	write_pid_record(-(intmax_t) shell_pid);
 	// histfilelines++;
 	close_history_file();
     }
@@ -1030,6 +1498,7 @@ void close_history_file(void)
     /* By closing the file descriptor for the history file, the file is
      * automatically unlocked. */
     // lock_histfile(F_UNLCK);
+    flush_binary_records();
     remove_shellfd(fileno(histfile));
     fclose(histfile);
     histfile = NULL;
@@ -1123,7 +1592,7 @@ void remove_duplicates(const char *line)
 	histentry_T *e = ashistentry(l);
 	if (strcmp(e->value, line) == 0) {
 	    if (histfile != NULL) {
-		wprintf_histfile(L"d%X\n", e->number);
+		write_delete_record(e->number);
 		histfilelines++;
 	    }
 	    remove_entry(e);
@@ -1140,6 +1609,22 @@ const histlink_T *get_history_entry(unsigned number)
     return (sr.prev == sr.next) ? sr.prev : Histlist;
 }
 
+/* Computes the signature of string `s'.
+ * See the definition of `histsig_T' for what the signature is. */
+histsig_T history_signature(const char *s)
+{
+    histsig_T signature = 0;
+
+    if (s[0] == '\0')
+	return signature;
+    for (size_t i = 1; s[i] != '\0'; i++) {
+	uint_fast32_t pair =
+	    (unsigned char) s[i - 1] << 8 | (unsigned char) s[i];
+	signature |= (histsig_T) 1 << ((pair * 40503 >> 10) & 63);
+    }
+    return signature;
+}
+
 #if YASH_ENABLE_LINEEDIT
 
 /* Calls `maybe_init_history' or `update_history' and locks the history. */
@@ -1203,6 +1688,8 @@ static int history_read(const wchar_t *s)
 static int history_write(const wchar_t *s)
     __attribute__((nonnull));
 static void history_refresh_file(void);
+static int history_convert_file(const wchar_t *format)
+    __attribute__((nonnull));
 
 const struct xgetopt_T fc_options[] = {
     { L'e', L"editor",     OPTARG_REQUIRED, true,  NULL, },
@@ -1353,6 +1840,12 @@ check_rev:
 	    ashistentry(lfirst.next == Histlist ? lfirst.prev : lfirst.next);
     const histentry_T *elast =
 	    ashistentry(llast.prev == Histlist ? llast.next : llast.prev);
+    if (entry_is_newer(efirst, elast)) {
+	/* Both <first> and <last> fall between the same pair of entries. */
+	assert(vfirst != NULL);
+	xerror(0, Ngt("no such history entry `%ls'"), vfirst);
+	return Exit_FAILURE;
+    }
     if (list)
 	return fc_print_entries(stdout, efirst, elast, rev, ptype);
     else
@@ -1405,7 +1898,7 @@ void fc_remove_last_entry(void)
 	update_history(true);
 	remove_last_entry();
 	if (histfile != NULL) {
-	    wprintf_histfile(L"c\n");
+	    write_cancel_record();
 	    histfilelines++;
 	    lock_histfile(F_UNLCK);
 	}
@@ -1461,7 +1954,7 @@ int fc_print_entries(
 	    default:
 		assert(false);
 	}
-	if (r < 0) {
+	if (r < 0 || (f == stdout && !flush_stdout_if_unbuffered())) {
 	    xerror(errno, Ngt("cannot print to the standard output"));
 	    return Exit_FAILURE;
 	}
@@ -1646,6 +2139,7 @@ const struct xgetopt_T history_options[] = {
     { L'r', L"read",       OPTARG_REQUIRED, true,  NULL, },
     { L's', L"set",        OPTARG_REQUIRED, true,  NULL, },
     { L'w', L"write",      OPTARG_REQUIRED, true,  NULL, },
+    { L'f', L"file-format", OPTARG_REQUIRED, true, NULL, },
     { L'F', L"flush-file", OPTARG_NONE,     true,  NULL, },
 #if YASH_ENABLE_HELP
     { L'-', L"help",       OPTARG_NONE,     false, NULL, },
@@ -1659,6 +2153,7 @@ const struct xgetopt_T history_options[] = {
  *  -r: read history from a file
  *  -s: add history entry
  *  -w: write history into a file
+ *  -f: convert history file into the specified format
  *  -F: flush history file */
 int history_builtin(int argc, void **argv)
 {
@@ -1696,6 +2191,9 @@ int history_builtin(int argc, void **argv)
 	    case L'w':
 		result = history_write(xoptarg);
 		break;
+	    case L'f':
+		result = history_convert_file(xoptarg);
+		break;
 	    case L'F':
 		history_refresh_file();
 		break;
@@ -1784,7 +2282,7 @@ int history_delete(const wchar_t *s)
     if (l != Histlist) {
 	histentry_T *e = ashistentry(l);
 	if (histfile != NULL) {
-	    wprintf_histfile(L"d%X\n", e->number);
+	    write_delete_record(e->number);
 	    histfilelines++;
 	}
 	remove_entry(e);
@@ -1878,12 +2376,41 @@ void history_refresh_file(void)
     }
 }
 
+/* Rewrites the history file in the specified format, which must be "text" or
+ * "binary". */
+int history_convert_file(const wchar_t *format)
+{
+    bool binary;
+    if (wcscmp(format, L"text") == 0) {
+	binary = false;
+    } else if (wcscmp(format, L"binary") == 0) {
+	binary = true;
+    } else {
+	xerror(0, Ngt("`%ls' is not a valid history file format"), format);
+	return Exit_ERROR;
+    }
+
+    if (histfile != NULL) {
+	lock_histfile(F_WRLCK);
+	update_time();
+	update_history(false);
+	if (histfile != NULL) {
+	    remove_histfile_pid(0);
+	    histfilebinary = binary;
+	    refresh_file();
+	    lock_histfile(F_UNLCK);
+	}
+    }
+    return Exit_SUCCESS;
+}
+
 #if YASH_ENABLE_HELP
 const char history_help[] = Ngt(
 "manage command history"
 );
 const char history_syntax[] = Ngt(
-"\thistory [-cF] [-d entry] [-s command] [-r file] [-w file] [count]\n"
+"\thistory [-cF] [-d entry] [-f format] [-s command] [-r file] \\\n"
+"\t        [-w file] [count]\n"
 );
 #endif
 
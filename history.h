@@ -20,6 +20,7 @@
 #define YASH_HISTORY_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include <sys/types.h>
 #include "xgetopt.h"
 
@@ -31,11 +32,22 @@ typedef struct histlink_T {
 /* `prev' and `next' are always non-NULL: the newest entry's `next' and the
  * oldest entry's `prev' point to `histlist'. */
 
+/* The type of history entry signatures.
+ * A signature is a set of the hash values of all pairs of adjacent bytes in a
+ * string. If a string contains another, the signature of the former includes
+ * all bits of that of the latter, so an entry whose signature lacks some bits
+ * of the signature of a search string does not contain the string. */
+typedef uint_least64_t histsig_T;
+
 /* The structure type of history entries. */
 typedef struct histentry_T {
     histlink_T link;
     unsigned number;
     time_t time;
+    histsig_T signature;
+#if YASH_ENABLE_LINEEDIT
+    double prediction_weight;
+#endif
     char value[];
 } histentry_T;
 #define Prev link.prev
@@ -48,6 +60,8 @@ typedef struct histentry_T {
  * The limit is no less than $HISTSIZE, so all the entries have different
  * numbers anyway. */
 /* When the time is unknown, `time' is -1. */
+/* `prediction_weight' is the weight of the entry in the command prediction
+ * model, or zero if the entry is not included in the model. */
 
 /* The structure type of the history list. */
 typedef struct histlist_T {
@@ -78,6 +92,8 @@ extern void add_history(const wchar_t *line)
     __attribute__((nonnull));
 const histlink_T *get_history_entry(unsigned number)
     __attribute__((pure));
+extern histsig_T history_signature(const char *s)
+    __attribute__((nonnull,pure));
 #if YASH_ENABLE_LINEEDIT
 extern void start_using_history(void);
 extern void end_using_history(void);
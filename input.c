@@ -53,6 +53,8 @@
 
 
 static bool is_seekable_file(int fd);
+static struct input_file_info_T *get_read_ahead_info(void)
+    __attribute__((warn_unused_result));
 static inputresult_T optimized_read_input(
 	struct xwcsbuf_T *buf, struct input_file_info_T *info, _Bool trap)
     __attribute__((nonnull));
@@ -114,6 +116,7 @@ inputresult_T read_input(
 
     size_t initlen = buf->length;
     inputresult_T status = INPUT_EOF;
+    bool ascii = is_ascii_compatible_encoding();
 
     for (;;) {
 	if (info->bufpos >= info->bufmax) {
@@ -151,6 +154,30 @@ read_input:  /* if there's nothing in the buffer, read the next input */
 	    info->bufmax = readcount;
 	}
 
+	/* append a run of ASCII characters without calling `mbrtowc' */
+	if (ascii && mbsinit(&info->state)) {
+	    const unsigned char *s =
+		(const unsigned char *) &info->buf[info->bufpos];
+	    size_t n = 0, max = info->bufmax - info->bufpos;
+	    bool newline = false;
+	    while (n < max && s[n] != '\0' && s[n] < 0x80) {
+		if (s[n++] == '\n') {
+		    newline = true;
+		    break;
+		}
+	    }
+	    if (n > 0) {
+		wb_ensuremax(buf, add(buf->length, n));
+		for (size_t i = 0; i < n; i++)
+		    buf->contents[buf->length++] = s[i];
+		buf->contents[buf->length] = L'\0';
+		info->bufpos += n;
+		if (newline)
+		    goto end;
+		continue;
+	    }
+	}
+
 	/* convert bytes in `info->buf' into a wide character and
 	 * append it to `buf' */
 	wb_ensuremax(buf, add(buf->length, 1));
@@ -184,6 +211,70 @@ end:
 	return status;
 }
 
+/* The read-ahead buffer for `read_input_ahead'. */
+static struct input_file_info_T *read_ahead_info = NULL;
+/* The device and i-node numbers of the file from which the bytes in
+ * `read_ahead_info' were read. */
+static dev_t read_ahead_dev;
+static ino_t read_ahead_ino;
+
+/* Reads one line from the standard input and appends it to `buf'.
+ * Unlike `read_input' with `stdin_input_file_info', this function reads the
+ * standard input in blocks and keeps the bytes following the line in the
+ * read-ahead buffer for the next call. The kept bytes are not available to
+ * other commands reading the same file, including subshells, so this function should be used only
+ * when no other command consumes the input or the user requested it.
+ * If the standard input is a regular file, this function works just like
+ * `read_input' since the file offset is restored after reading anyway.
+ * The arguments and the return value are the same as `read_input'. */
+inputresult_T read_input_ahead(xwcsbuf_T *buf, bool trap)
+{
+    struct input_file_info_T *info = get_read_ahead_info();
+    if (info == NULL)
+	return read_input(buf, stdin_input_file_info, trap);
+    return read_input(buf, info, trap);
+}
+
+/* Returns the read-ahead buffer for the current standard input.
+ * The buffer is associated with the file from which it was filled. If the
+ * standard input is another file and the buffer still has some bytes from the
+ * original file, the bytes are kept for the original file and NULL is returned
+ * so that the other file is read without buffering. If the buffer is empty, it
+ * is associated with the current standard input.
+ * Returns NULL also if the standard input is a regular file or not open. */
+struct input_file_info_T *get_read_ahead_info(void)
+{
+    struct stat st;
+    if (fstat(STDIN_FILENO, &st) < 0 || S_ISREG(st.st_mode))
+	return NULL;
+
+    if (read_ahead_info == NULL) {
+	read_ahead_info = xmallocs(sizeof *read_ahead_info,
+		BUFSIZ, sizeof *read_ahead_info->buf);
+	read_ahead_info->fd = STDIN_FILENO;
+	read_ahead_info->bufsize = BUFSIZ;
+    } else if (read_ahead_dev == st.st_dev && read_ahead_ino == st.st_ino) {
+	return read_ahead_info;
+    } else if (read_ahead_info->bufpos < read_ahead_info->bufmax) {
+	return NULL;
+    }
+
+    read_ahead_info->bufpos = read_ahead_info->bufmax = 0;
+    memset(&read_ahead_info->state, 0, sizeof read_ahead_info->state);
+    read_ahead_dev = st.st_dev;
+    read_ahead_ino = st.st_ino;
+    return read_ahead_info;
+}
+
+/* Discards the bytes kept in the read-ahead buffer.
+ * This function is called in a new child process so that the bytes that the
+ * parent has already read from the file are not read again by the child. */
+void discard_read_ahead(void)
+{
+    free(read_ahead_info);
+    read_ahead_info = NULL;
+}
+
 /* Checks if the file descriptor is seekable. */
 bool is_seekable_file(int fd)
 {
@@ -200,8 +291,14 @@ bool is_seekable_file(int fd)
 inputresult_T optimized_read_input(
 	struct xwcsbuf_T *buf, struct input_file_info_T *info, _Bool trap)
 {
-    struct input_file_info_T *tmpinfo =
-	xmallocs(sizeof *tmpinfo, BUFSIZ, sizeof *tmpinfo->buf);
+    /* The temporary buffer is kept for the next call. It is taken out of
+     * `cache' while in use because a trap handled in `read_input' may call this
+     * function again. */
+    static struct input_file_info_T *cache = NULL;
+    struct input_file_info_T *tmpinfo = cache;
+    cache = NULL;
+    if (tmpinfo == NULL)
+	tmpinfo = xmallocs(sizeof *tmpinfo, BUFSIZ, sizeof *tmpinfo->buf);
     tmpinfo->fd = info->fd;
     tmpinfo->state = info->state;
     tmpinfo->bufpos = tmpinfo->bufmax = 0;
@@ -224,7 +321,10 @@ inputresult_T optimized_read_input(
     }
 
     info->state = tmpinfo->state;
-    free(tmpinfo);
+    if (cache == NULL)
+	cache = tmpinfo;
+    else
+	free(tmpinfo);
     return result;
 }
 
@@ -434,6 +534,8 @@ wchar_t *expand_ps1_posix(wchar_t *s)
  * These are ignored in this function. */
 void print_prompt(const wchar_t *s)
 {
+    flush_stdout();
+
 #if YASH_ENABLE_LINEEDIT
     if (le_try_print_prompt(s))
 	return;
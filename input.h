@@ -58,6 +58,9 @@ struct input_file_info_T;
 extern inputresult_T read_input(
 	struct xwcsbuf_T *buf, struct input_file_info_T *info, _Bool trap)
     __attribute__((nonnull));
+extern inputresult_T read_input_ahead(struct xwcsbuf_T *buf, _Bool trap)
+    __attribute__((nonnull));
+extern void discard_read_ahead(void);
 
 /* The type of input functions.
  * An input function reads input and appends it to buffer `buf'.
@@ -35,6 +35,7 @@
 #include <wctype.h>
 #include "builtin.h"
 #include "exec.h"
+#include "hashtable.h"
 #include "option.h"
 #include "plist.h"
 #include "redir.h"
@@ -54,6 +55,18 @@
 static inline job_T *get_job(size_t jobnumber)
     __attribute__((pure));
 static inline void free_job(job_T *job);
+static hashval_T hashpid(const void *p)
+    __attribute__((nonnull,pure));
+static int htpidcmp(const void *p1, const void *p2)
+    __attribute__((nonnull,pure));
+static void index_job_processes(job_T *job)
+    __attribute__((nonnull));
+static void unindex_job_processes(job_T *job)
+    __attribute__((nonnull));
+static void unindex_process(process_T *pr)
+    __attribute__((nonnull));
+static void count_process_status(job_T *job, jobstatus_T status, int delta)
+    __attribute__((nonnull));
 static void trim_joblist(void);
 static void set_current_jobnumber(size_t jobnumber);
 static size_t find_next_job(size_t numlimit);
@@ -95,12 +108,73 @@ static plist_T joblist;
 /* number of the current/previous jobs. 0 if none. */
 static size_t current_jobnumber, previous_jobnumber;
 
+/* A hashtable that maps process IDs to the jobs containing the processes.
+ * The keys are pointers to the `pr_pid' members of the processes in the job
+ * list, and the values are pointers to the jobs.
+ * Only processes that have a positive process ID and are not yet finished are
+ * contained, so that `do_wait' can find the process for a process ID reported
+ * by `waitpid' without scanning the whole job list. */
+static hashtable_T pidtable;
+
 /* Initializes the job list. */
 void init_job(void)
 {
     assert(joblist.contents == NULL);
     pl_init(&joblist);
     pl_add(&joblist, NULL);
+    ht_init(&pidtable, hashpid, htpidcmp);
+}
+
+/* A hash function for process IDs.
+ * The argument is a pointer to a `pid_t' value. */
+hashval_T hashpid(const void *p)
+{
+    return (hashval_T) *(const pid_t *) p;
+}
+
+/* Compares two process IDs pointed to by the arguments. */
+int htpidcmp(const void *p1, const void *p2)
+{
+    return *(const pid_t *) p1 != *(const pid_t *) p2;
+}
+
+/* Adds the unfinished processes of the specified job to `pidtable'. */
+void index_job_processes(job_T *job)
+{
+    for (size_t i = 0; i < job->j_pcount; i++) {
+	process_T *pr = &job->j_procs[i];
+	if (pr->pr_pid > 0 && pr->pr_status != JS_DONE)
+	    ht_set(&pidtable, &pr->pr_pid, job);
+    }
+}
+
+/* Removes the processes of the specified job from `pidtable'. */
+void unindex_job_processes(job_T *job)
+{
+    for (size_t i = 0; i < job->j_pcount; i++)
+	unindex_process(&job->j_procs[i]);
+}
+
+/* Removes the specified process from `pidtable' if it is contained. */
+void unindex_process(process_T *pr)
+{
+    if (pr->pr_pid <= 0)
+	return;
+
+    kvpair_T kv = ht_get(&pidtable, &pr->pr_pid);
+    if (kv.key == &pr->pr_pid)
+	ht_remove(&pidtable, &pr->pr_pid);
+}
+
+/* Adds `delta' to the running or stopped process count of the job according
+ * to `status'. */
+void count_process_status(job_T *job, jobstatus_T status, int delta)
+{
+    switch (status) {
+	case JS_RUNNING:  job->j_runcount  += delta;  break;
+	case JS_STOPPED:  job->j_stopcount += delta;  break;
+	case JS_DONE:                                 break;
+    }
 }
 
 /* Sets the active job. */
@@ -109,6 +183,11 @@ void set_active_job(job_T *job)
     assert(ACTIVE_JOBNO < joblist.length);
     assert(joblist.contents[ACTIVE_JOBNO] == NULL);
     joblist.contents[ACTIVE_JOBNO] = job;
+
+    job->j_runcount = job->j_stopcount = 0;
+    for (size_t i = 0; i < job->j_pcount; i++)
+	count_process_status(job, job->j_procs[i].pr_status, 1);
+    index_job_processes(job);
 }
 
 /* Moves the active job into the job list.
@@ -153,7 +232,10 @@ job_T *get_job(size_t jobnumber)
  * (another job is assigned to it). */
 void remove_job(size_t jobnumber)
 {
-    free_job(get_job(jobnumber));
+    job_T *job = get_job(jobnumber);
+    if (job != NULL)
+	unindex_job_processes(job);
+    free_job(job);
     joblist.contents[jobnumber] = NULL;
     trim_joblist();
     set_current_jobnumber(current_jobnumber);
@@ -166,6 +248,7 @@ void remove_all_jobs(void)
 	free_job(joblist.contents[i]);
 	joblist.contents[i] = NULL;
     }
+    ht_clear(&pidtable, NULL);
     trim_joblist();
     current_jobnumber = previous_jobnumber = 0;
 }
@@ -204,6 +287,9 @@ void neglect_all_jobs(void)
 	if (job != NULL)
 	    job->j_legacy = true;
     }
+    /* Legacy jobs are not children of this process, so their process IDs may
+     * be reused by new children. */
+    ht_clear(&pidtable, NULL);
     current_jobnumber = previous_jobnumber = 0;
 }
 
@@ -386,23 +472,20 @@ start:
 	return;
     }
 
-    size_t jobnumber, pnumber;
-    job_T *job;
-    process_T *pr;
-
-    /* determine `jobnumber', `job' and `pr' from `pid' */
-    for (jobnumber = 0; jobnumber < joblist.length; jobnumber++)
-	if ((job = joblist.contents[jobnumber]) != NULL)
-	    for (pnumber = 0; pnumber < job->j_pcount; pnumber++)
-		if ((pr = &job->j_procs[pnumber])->pr_pid == pid &&
-			pr->pr_status != JS_DONE)
-		    goto found;
+    /* determine `job' and `pr' from `pid' */
+    kvpair_T kv = ht_get(&pidtable, &pid);
+    if (kv.key == NULL) {
+	/* If `pid' was not found in the job list, we simply ignore it. This
+	 * may happen on some occasions: e.g. the job has been "disown"ed. */
+	goto start;
+    }
 
-    /* If `pid' was not found in the job list, we simply ignore it. This may
-     * happen on some occasions: e.g. the job has been "disown"ed. */
-    goto start;
+    job_T *job = kv.value;
+    process_T *pr =
+	(process_T *) ((char *) kv.key - offsetof(process_T, pr_pid));
+    jobstatus_T oldprstatus = pr->pr_status;
+    assert(oldprstatus != JS_DONE);
 
-found:
     pr->pr_statuscode = status;
     if (WIFEXITED(status) || WIFSIGNALED(status))
 	pr->pr_status = JS_DONE;
@@ -415,22 +498,18 @@ found:
      * be careful about the order of these checks. */
 #endif
 
+    count_process_status(job, oldprstatus, -1);
+    count_process_status(job, pr->pr_status, 1);
+    if (pr->pr_status == JS_DONE)
+	unindex_process(pr);
+
     /* decide the job status from the process status:
      * - JS_RUNNING if any of the processes is running.
      * - JS_STOPPED if no processes are running but some are stopped.
      * - JS_DONE if all the processes are finished. */
     jobstatus_T oldstatus = job->j_status;
-    bool anyrunning = false, anystopped = false;
-    /* check if there are running/stopped processes */
-    for (size_t i = 0; i < job->j_pcount; i++) {
-	switch (job->j_procs[i].pr_status) {
-	    case JS_RUNNING:  anyrunning = true;  goto out_of_loop;
-	    case JS_STOPPED:  anystopped = true;  break;
-	    default:                              break;
-	}
-    }
-out_of_loop:
-    job->j_status = anyrunning ? JS_RUNNING : anystopped ? JS_STOPPED : JS_DONE;
+    job->j_status = job->j_runcount > 0 ? JS_RUNNING
+	: job->j_stopcount > 0 ? JS_STOPPED : JS_DONE;
     if (job->j_status != oldstatus)
 	job->j_statuschanged = true;
 
@@ -1095,6 +1174,8 @@ bool jobs_builtin_print_job(size_t jobnumber,
     } else {
 	err = print_job_status(jobnumber, changedonly, verbose, true, stdout);
     }
+    if (err == 0 && !flush_stdout_if_unbuffered())
+	err = errno;
     if (err != 0) {
 	xerror(err, Ngt("cannot print to the standard output"));
 	return false;
@@ -49,12 +49,17 @@ typedef struct job_T {
     _Bool       j_legacy;        /* not a true child of the shell? */
     _Bool       j_nonotify;      /* suppress printing job status? */
     size_t      j_pcount;        /* # of processes in `j_procs' */
+    size_t      j_runcount;      /* # of running processes in `j_procs' */
+    size_t      j_stopcount;     /* # of stopped processes in `j_procs' */
     process_T   j_procs[];       /* info about processes */
 } job_T;
 /* When job control is off, `j_pgid' is 0 since the job shares the process group
  * ID with the shell.
  * In subshells, the `j_legacy' flag is set to indicate that the job is not
- * a direct child of the current shell process. */
+ * a direct child of the current shell process.
+ * `j_runcount' and `j_stopcount' are initialized by `set_active_job' and kept
+ * up to date as process statuses change, so that `j_status' can be decided
+ * without scanning all the processes. */
 
 
 /* job number of the active job */
@@ -19,7 +19,6 @@
 #include "../common.h"
 #include "complete.h"
 #include <assert.h>
-#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #if HAVE_GETGRENT
@@ -43,6 +42,8 @@
 #include <wchar.h>
 #include <wctype.h>
 #include <sys/stat.h>
+#include <sys/times.h>
+#include <unistd.h>
 #include "../builtin.h"
 #include "../exec.h"
 #include "../expand.h"
@@ -112,6 +113,8 @@ static void free_candidate(void *c)
     __attribute__((nonnull));
 static void free_context(le_context_T *ctxt);
 static void sort_candidates(void);
+static const wchar_t *candidate_origvalue(const void *cand)
+    __attribute__((nonnull,pure));
 static int sort_candidates_cmp(const void *cp1, const void *cp2)
     __attribute__((nonnull));
 static void print_context_info(const le_context_T *ctxt)
@@ -121,6 +124,9 @@ static void print_compopt_info(const le_compopt_T *compopt)
 
 static void execute_completion_function(void);
 static void complete_command_default(void);
+static bool generation_cancelled(void);
+static long elapsed_milliseconds(clock_t since);
+static void show_candidates_so_far(void);
 
 static void simple_completion(le_candgentype_T type);
 static void generate_candidates(const le_compopt_T *compopt)
@@ -133,6 +139,8 @@ static void generate_file_candidates(const le_compopt_T *compopt)
     __attribute__((nonnull));
 static void generate_external_command_candidates(const le_compopt_T *compopt)
     __attribute__((nonnull));
+static char *pattern_literal_prefix(const wchar_t *pattern)
+    __attribute__((nonnull,malloc,warn_unused_result));
 static void generate_keyword_candidates(const le_compopt_T *compopt)
     __attribute__((nonnull));
 static void generate_logname_candidates(const le_compopt_T *compopt)
@@ -173,6 +181,23 @@ size_t le_selected_candidate_index;
  * The value is ((size_t) -1) when not computed. */
 static size_t common_prefix_length;
 
+/* Candidate generation that has taken at least this many milliseconds is
+ * cancelled when the user types a key. */
+#define CANCEL_DELAY 200
+/* During such a long generation, the candidates found so far are shown at
+ * intervals of this many milliseconds. */
+#define PROGRESS_INTERVAL 200
+/* Pending input is checked once in every this many generated items. */
+#define CANCEL_CHECK_INTERVAL 16
+
+/* The times when the current candidate generation started and when the
+ * candidates were last shown during the generation. */
+static clock_t generation_start, progress_time;
+/* The number of calls to `generation_cancelled' in the current generation. */
+static unsigned generation_checks;
+/* Set when the current generation is cancelled by a key typed by the user. */
+static bool cancelled_by_input;
+
 
 /* Performs command line completion.
  * Existing candidates are deleted, if any, and candidates are computed from
@@ -204,12 +229,24 @@ void le_complete(le_compresult_T lecr)
     if (le_state_is_compdebug)
 	print_context_info(ctxt);
 
+    struct tms tms;
+    generation_start = progress_time = times(&tms);
+    generation_checks = 0;
+    cancelled_by_input = false;
+
     execute_completion_function();
-    sort_candidates();
-    le_compdebug("total of %zu candidate(s)", le_candidates.length);
 
-    /* display the results */
-    lecr();
+    if (cancelled_by_input) {
+	/* The key typed will be processed as usual after we return. */
+	reset_interrupted();
+	le_complete_cleanup();
+    } else {
+	sort_candidates();
+	le_compdebug("total of %zu candidate(s)", le_candidates.length);
+
+	/* display the results */
+	lecr();
+    }
 
     if (le_state_is_compdebug) {
 	le_compdebug("completion end");
@@ -417,21 +454,38 @@ void free_context(le_context_T *ctxt)
 /* Sorts the candidates in the candidate list and removes duplicates. */
 void sort_candidates(void)
 {
-    qsort(le_candidates.contents,
-	    le_candidates.length, sizeof *le_candidates.contents,
-	    sort_candidates_cmp);
-
-    if (le_candidates.length >= 2) {
-	for (size_t i = le_candidates.length - 1; i > 0; i--) {
-	    le_candidate_T *cand1 = le_candidates.contents[i];
-	    le_candidate_T *cand2 = le_candidates.contents[i - 1];
-	    // XXX case-sensitive
-	    if (wcscoll(cand1->origvalue, cand2->origvalue) == 0) {
-		free_candidate(cand1);
-		pl_remove(&le_candidates, i, 1);
-	    }
+    /* Candidates that start with a hyphen come after the others. The others
+     * are sorted by the collation keys of their values and the hyphened ones
+     * by `sort_candidates_cmp'. */
+    void **cands = le_candidates.contents;
+    size_t count = le_candidates.length, plain = 0;
+    for (size_t i = 0; i < count; i++) {
+	le_candidate_T *cand = cands[i];
+	if (cand->origvalue[0] != L'-') {
+	    cands[i] = cands[plain];
+	    cands[plain++] = cand;
 	}
     }
+    sort_wcscoll(cands, plain, candidate_origvalue);
+    qsort(&cands[plain], count - plain, sizeof *cands, sort_candidates_cmp);
+
+    /* remove duplicates */
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+	le_candidate_T *cand = cands[i];
+	// XXX case-sensitive
+	if (n > 0 && wcscoll(cand->origvalue,
+		    ((le_candidate_T *) cands[n - 1])->origvalue) == 0)
+	    free_candidate(cand);
+	else
+	    cands[n++] = cand;
+    }
+    pl_truncate(&le_candidates, n);
+}
+
+const wchar_t *candidate_origvalue(const void *cand)
+{
+    return ((const le_candidate_T *) cand)->origvalue;
 }
 
 int sort_candidates_cmp(const void *cp1, const void *cp2)
@@ -600,6 +654,66 @@ void execute_completion_function(void)
 
 }
 
+/* Checks if the current candidate generation should be stopped.
+ * Candidate generators that may take long call this function for each item
+ * they examine. If the generation has already taken some time and the user has
+ * typed a key, the generation is cancelled: the shell is marked as interrupted
+ * so that `wglob' and completion functions stop as they do on SIGINT. While a
+ * long generation goes on, the candidates found so far are shown from time to
+ * time.
+ * Returns true iff the generation should be stopped. */
+bool generation_cancelled(void)
+{
+    if (is_interrupted())
+	return true;
+    if (le_state_is_compdebug)
+	return false;
+    if (++generation_checks % CANCEL_CHECK_INTERVAL != 0)
+	return false;
+    if (elapsed_milliseconds(generation_start) < CANCEL_DELAY)
+	return false;
+
+    if (wait_for_input(STDIN_FILENO, false, 0) == W_READY) {
+	cancelled_by_input = true;
+	set_interrupted();
+	return true;
+    }
+
+    if (elapsed_milliseconds(progress_time) >= PROGRESS_INTERVAL) {
+	show_candidates_so_far();
+	struct tms tms;
+	progress_time = times(&tms);
+    }
+    return false;
+}
+
+/* Returns the number of milliseconds elapsed since the specified time, which
+ * must be a value returned by `times'. */
+long elapsed_milliseconds(clock_t since)
+{
+    static long ticks = 0;
+    if (ticks <= 0) {
+	ticks = sysconf(_SC_CLK_TCK);
+	if (ticks <= 0)
+	    ticks = 100;
+    }
+
+    struct tms tms;
+    return (long) (times(&tms) - since) * 1000 / ticks;
+}
+
+/* Updates the display to show the candidates that have been generated so far.
+ */
+void show_candidates_so_far(void)
+{
+    sort_candidates();
+    le_selected_candidate_index = le_candidates.length;
+    le_display_make_rawvalues();
+    le_display_complete_cleanup();
+    le_display_update(true);
+    le_display_flush();
+}
+
 /* Sets special local variables $WORDS and $TARGETWORD in the current variable
  * environment. Also sets the $IFS variable to the default value. */
 void set_completion_variables(void)
@@ -680,6 +794,8 @@ void generate_candidates(const le_compopt_T *compopt)
     generate_file_candidates(compopt);
     generate_builtin_candidates(compopt);
     generate_external_command_candidates(compopt);
+    if (is_interrupted())
+	goto end;
     generate_function_candidates(compopt);
     generate_keyword_candidates(compopt);
     generate_alias_candidates(compopt);
@@ -692,6 +808,7 @@ void generate_candidates(const le_compopt_T *compopt)
     generate_bindkey_candidates(compopt);
     generate_dirstack_candidates(compopt);
 
+end:
     for (const le_comppattern_T *p = compopt->patterns; p != NULL; p = p->next)
 	xfnm_free(p->cpattern);
 }
@@ -871,7 +988,9 @@ void generate_file_candidates(const le_compopt_T *compopt)
     if (!le_compile_cpatterns(compopt))
 	return;
 
-    enum wglobflags_T flags = 0;
+    /* The results need not be sorted here as all candidates are sorted
+     * afterwards. */
+    enum wglobflags_T flags = WGLB_NOSORT;
     // if (shopt_nocaseglob)   flags |= WGLB_CASEFOLD;  XXX case-sensitive
     if (shopt_dotglob)      flags |= WGLB_PERIOD;
     if (shopt_extendedglob) flags |= WGLB_RECDIR;
@@ -887,6 +1006,10 @@ void generate_file_candidates(const le_compopt_T *compopt)
     /* check pathnames in `list' and add them to the candidate list */
     for (size_t i = 0; i < list.length; i++) {
 	wchar_t *name = list.contents[i];
+	if (generation_cancelled()) {
+	    free(name);
+	    continue;
+	}
 	if (p != NULL) {
 	    const wchar_t *basename = wcsrchr(name, L'/');
 	    if (basename == NULL)
@@ -940,36 +1063,59 @@ void generate_external_command_candidates(const le_compopt_T *compopt)
     if (!le_compile_cpatterns(compopt))
 	return;
 
-    char *const *paths = get_path_array(PA_PATH);
+    char *prefix = pattern_literal_prefix(compopt->patterns->pattern);
+    size_t prefixlen = strlen(prefix);
+    size_t count;
+    const pathdir_T *dirs = get_path_index(&count);
     xstrbuf_T path;
 
-    if (paths == NULL)
-	return;
     sb_init(&path);
-    for (const char *dirpath; (dirpath = *paths) != NULL; paths++) {
-	DIR *dir = opendir(dirpath);
-	struct dirent *de;
-	size_t dirpathlen;
+    for (size_t i = 0; i < count; i++) {
+	if (is_interrupted())
+	    break;
 
-	if (dir == NULL)
-	    continue;
-	sb_cat(&path, dirpath);
+	const pathdir_T *dir = &dirs[i];
+	sb_cat(&path, dir->pd_path);
 	if (path.length > 0 && path.contents[path.length - 1] != '/')
 	    sb_ccat(&path, '/');
-	dirpathlen = path.length;
-	while ((de = readdir(dir)) != NULL) {
-	    if (!le_match_comppatterns(compopt, de->d_name))
+	size_t dirpathlen = path.length;
+	for (size_t j = pathdir_find_prefix(dir, prefix);
+		j < dir->pd_count && !generation_cancelled(); j++) {
+	    const char *name = dir->pd_names[j];
+	    if (strncmp(name, prefix, prefixlen) != 0)
+		break;
+	    if (!le_match_comppatterns(compopt, name))
 		continue;
-	    sb_cat(&path, de->d_name);
+	    sb_cat(&path, name);
 	    if (is_executable_regular(path.contents))
 		le_new_candidate(CT_COMMAND,
-			malloc_mbstowcs(de->d_name), NULL, compopt);
+			malloc_mbstowcs(name), NULL, compopt);
 	    sb_truncate(&path, dirpathlen);
 	}
 	sb_clear(&path);
-	closedir(dir);
     }
     sb_destroy(&path);
+    free(prefix);
+}
+
+/* Returns the literal part at the beginning of the specified pattern as a
+ * newly malloced multibyte string. Any string that matches the pattern starts
+ * with the returned string. An empty string is returned if the literal part
+ * cannot be converted to a multibyte string. */
+char *pattern_literal_prefix(const wchar_t *pattern)
+{
+    xwcsbuf_T buf;
+    wb_init(&buf);
+    for (const wchar_t *p = pattern; *p != L'\0'; p++) {
+	if (*p == L'*' || *p == L'?' || *p == L'[')
+	    break;
+	if (*p == L'\\' && *++p == L'\0')
+	    break;
+	wb_wccat(&buf, *p);
+    }
+
+    char *prefix = realloc_wcstombs(wb_towcs(&buf));
+    return (prefix != NULL) ? prefix : xstrdup("");
 }
 
 /* Generates candidates that are keywords matching the pattern. */
@@ -836,6 +836,7 @@ wordunit_T *cparse_paramexp_raw(le_contexttype_T ctxttype)
 	wu->wu_param->pe_name = xwcsndup(&BUF[INDEX + 1], namelen);
 	wu->wu_param->pe_start = wu->wu_param->pe_end =
 	wu->wu_param->pe_match = wu->wu_param->pe_subst = NULL;
+	wu->wu_param->pe_startcode = wu->wu_param->pe_endcode = NULL;
     }
 
     INDEX += namelen + 1;
@@ -855,6 +856,7 @@ wordunit_T *cparse_paramexp_in_brace(le_contexttype_T ctxttype)
     pe->pe_type = 0;
     pe->pe_name = NULL;
     pe->pe_start = pe->pe_end = pe->pe_match = pe->pe_subst = NULL;
+    pe->pe_startcode = pe->pe_endcode = NULL;
 
     const size_t origindex = INDEX;
     assert(BUF[INDEX] == L'{');
@@ -1034,6 +1036,7 @@ check_closing_paren:
 	    pe2->pe_type = PT_MINUS;
 	    pe2->pe_name = pe->pe_name;
 	    pe2->pe_start = pe2->pe_end = pe2->pe_match = pe2->pe_subst = NULL;
+	    pe2->pe_startcode = pe2->pe_endcode = NULL;
 
 	    wordunit_T *nest = xmalloc(sizeof *nest);
 	    nest->next = NULL;
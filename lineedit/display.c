@@ -65,7 +65,13 @@
  * when the cursor is sticking, or we cannot track the cursor position
  * correctly. To deal with this problem, if we finish printing a text at the end
  * of a line, we print a dummy space character and erase it to ensure the cursor
- * is no longer sticking. */
+ * is no longer sticking.
+ *
+ * The edit line is redrawn each time it is edited, so it is modeled as a grid
+ * of screen cells (`editgrid'). The new contents are laid out in another grid
+ * and only the cells that differ between the grids are printed. While printing
+ * the changed cells, a sticking cursor is moved back by the "cr" capability
+ * rather than by printing a dummy character. */
 
 
 #if HAVE_WCWIDTH
@@ -335,13 +341,55 @@ bool lebuf_putchar1_trunc(int c)
 typedef struct candpage_T candpage_T;
 typedef struct candcol_T candcol_T;
 
+/* The kinds of screen cells in the edit line. */
+typedef enum cellkind_T {
+    CELL_BLANK,    /* nothing is printed in the cell */
+    CELL_TEXT,     /* a character of the main text is printed */
+    CELL_PREDICT,  /* a character of the predicted text is printed */
+    CELL_CONT,     /* covered by the wide character in the previous cell */
+    CELL_UNKNOWN,  /* the cell may contain anything */
+} cellkind_T;
+/* The type of screen cells. */
+typedef struct cell_T {
+    wchar_t c;        /* the character printed in the cell */
+    cellkind_T kind;
+} cell_T;
+/* A grid of cells that models the edit line on the screen.
+ * The first row is the line of `editbasepos'. */
+struct cellgrid_T {
+    cell_T *cells;    /* `rows' rows of `columns' cells */
+    int rows, columns;
+    size_t capacity;  /* number of cells allocated in `cells' */
+};
+/* The text styles that may be active while the edit line is printed. */
+typedef enum textstyle_T {
+    STYLE_UNKNOWN, STYLE_NONE, STYLE_TEXT, STYLE_PREDICT,
+} textstyle_T;
+
 static void finish(void);
 static void clear_to_end_of_screen(void);
 static void clear_editline(void);
 static void maybe_print_promptsp(void);
 static void update_editline(void);
-static bool current_display_is_uptodate(size_t index)
-    __attribute__((pure));
+static void layout_editline(void);
+static void layout_wchar(wchar_t c, cellkind_T kind);
+static void layout_glyph(wchar_t c, int width, cellkind_T kind);
+static cell_T *grid_cell(struct cellgrid_T *grid, le_pos_T p)
+    __attribute__((nonnull));
+static void grid_extend(struct cellgrid_T *grid, int rows)
+    __attribute__((nonnull));
+static void grid_free(struct cellgrid_T *grid)
+    __attribute__((nonnull));
+static bool cell_changed(const cell_T *old, const cell_T *new)
+    __attribute__((nonnull,pure));
+static void print_changed_cells(int row, textstyle_T *style)
+    __attribute__((nonnull));
+static void print_cell(const cell_T *cell, textstyle_T *style)
+    __attribute__((nonnull));
+static void set_cell_style(cellkind_T kind, textstyle_T *style)
+    __attribute__((nonnull));
+static void go_to_cell(le_pos_T p, bool printing, textstyle_T *style)
+    __attribute__((nonnull));
 static void check_cand_overwritten(void);
 static void update_styler(void);
 static void reset_style_before_moving(void);
@@ -395,17 +443,20 @@ static struct promptset_T prompt;
 /* The position of the first character of the edit line, just after the prompt.
  */
 static le_pos_T editbasepos;
-/* The content of the edit line that is currently displayed on the screen. */
-static wchar_t *current_editline = NULL;
+/* The contents of the edit line that are currently displayed on the screen.
+ * The grid has no cells while the edit line is not displayed. */
+static struct cellgrid_T editgrid = { .cells = NULL };
+/* The grid into which the edit line is laid out before it is compared with
+ * `editgrid'. */
+static struct cellgrid_T newgrid = { .cells = NULL };
 /* An array of cursor positions of each character in the edit line.
- * If the nth character of `current_editline' is positioned at line `l', column
- * `c', then cursor_positions[n] == l * le_columns + c. */
+ * If the nth character of the edit line is positioned at line `l', column `c',
+ * then cursor_positions[n] == l * le_columns + c. */
 static int *cursor_positions = NULL;
-/* The current index in the edit line that divides the line into two (cf.
- * `le_main_buffer'). */
-static size_t current_length = 0;
 /* The line number of the last edit line (or the search buffer). */
 static int last_edit_line;
+/* The cursor shape that was last sent to the terminal, or '\0' if unknown. */
+static char cursor_shape;
 /* True when the terminal's current font setting is the one set by the styler
  * prompt. */
 static bool styler_active;
@@ -508,23 +559,27 @@ void finish(void)
     clear_to_end_of_screen(), candbaseline = -1;
     le_display_complete_cleanup();
 
-    free(current_editline), current_editline = NULL;
+    grid_free(&editgrid);
+    grid_free(&newgrid);
     free(cursor_positions), cursor_positions = NULL;
     free(rprompt.value);
     free(sprompt.value);
 
     le_display_flush();
     display_active = false;
+    cursor_shape = '\0';
 }
 
 /* Flushes the contents of the print buffer to the standard error and destroys
  * the buffer. */
 void le_display_flush(void)
 {
-    if (le_mode_to_id(le_current_mode) == LE_MODE_VI_COMMAND) {
-	fprintf(stderr, "[2 q");
-    } else {
-	fprintf(stderr, "[6 q");
+    /* The cursor shape is sent only when it changes. */
+    char shape = (le_mode_to_id(le_current_mode) == LE_MODE_VI_COMMAND)
+	    ? '2' : '6';
+    if (cursor_shape != shape) {
+	fprintf(stderr, "\033[%c q", shape);
+	cursor_shape = shape;
     }
     current_position = lebuf.pos;
     fwrite(lebuf.buf.contents, 1, lebuf.buf.length, stderr);
@@ -667,89 +722,354 @@ void maybe_print_promptsp(void)
 }
 
 /* Prints the content of the edit line.
+ * The edit line is laid out into a grid of screen cells, which is compared
+ * with the grid of the previous update so that only the changed cells are
+ * reprinted.
  * The cursor may be anywhere when this function is called.
  * The cursor is left at an unspecified position when this function returns. */
 void update_editline(void)
 {
-    size_t index = 0;
+    if (editgrid.cells == NULL || editgrid.columns != lebuf.maxcolumn) {
+	/* print the whole edit line */
+	go_to(editbasepos);
+	clear_editline();
+	if (last_edit_line < editbasepos.line)
+	    last_edit_line = editbasepos.line;
+	editgrid.rows = 0;
+	editgrid.columns = lebuf.maxcolumn;
+    }
 
-    if (current_editline != NULL) {
-	/* We only reprint what have been changed from the last update:
-	 * skip the unchanged part at the beginning of the line. */
-	assert(cursor_positions != NULL);
+    layout_editline();
+
+    int endpos = cursor_positions[le_main_buffer.length];
+    int endline = endpos / lebuf.maxcolumn;
+    int endcolumn = endpos % lebuf.maxcolumn;
+
+    int rows = newgrid.rows;
+    if (rows < editgrid.rows)
+	rows = editgrid.rows;
+    if (rows < last_edit_line - editbasepos.line + 1)
+	rows = last_edit_line - editbasepos.line + 1;
+    grid_extend(&editgrid, rows);
+    grid_extend(&newgrid, rows);
+
+    /* Lines below `last_edit_line' and lines of the candidate area (which may
+     * start on the last edit line if it is empty) have unknown contents. Such
+     * lines are cleared when the edit line extends to them. */
+    int overwritten = -1;
+    for (int line = editbasepos.line; line <= endline; line++) {
+	if (line <= last_edit_line
+		&& (candbaseline < 0 || line < candbaseline))
+	    continue;
+	if (line > line_max)
+	    break;
 
-	while (current_editline[index] != L'\0' &&
-		current_display_is_uptodate(index))
-	    index++;
+	cell_T *cells = grid_cell(&editgrid, (le_pos_T) { line, 0 });
+	const cell_T *newcells = grid_cell(&newgrid, (le_pos_T) { line, 0 });
+	if (line <= last_edit_line) {
+	    int i = 0;
+	    while (i < newgrid.columns && newcells[i].kind == CELL_BLANK)
+		i++;
+	    if (i == newgrid.columns)
+		continue;
+	}
+	for (int i = 0; i < editgrid.columns; i++)
+	    cells[i].kind = CELL_UNKNOWN;
+	overwritten = line;
+    }
 
-	/* return if nothing has changed */
-	if (current_editline[index] == L'\0'
-		&& le_main_buffer.contents[index] == L'\0')
-	    return;
+    /* The right prompt is left intact if it is on the last line of the edit
+     * line and the edit line does not reach it. Otherwise it is cleared. */
+    if (rprompt_line >= 0 && (rprompt_line != endline
+		|| endcolumn > lebuf.maxcolumn - rprompt.width - 2)) {
+	cell_T *cells = grid_cell(&editgrid, (le_pos_T) {
+		rprompt_line, lebuf.maxcolumn - rprompt.width - 1 });
+	for (int i = 0; i < rprompt.width; i++)
+	    cells[i].kind = CELL_UNKNOWN;
+	rprompt_line = -1;
+    }
 
-	go_to_index(index);
-	if (current_editline[index] != L'\0')
-	    clear_editline();
-    } else {
-	/* print the whole edit line */
-	go_to(editbasepos);
-	clear_editline();
+    textstyle_T style = styler_active ? STYLE_TEXT : STYLE_UNKNOWN;
+    for (int row = 0; row < rows; row++)
+	print_changed_cells(row, &style);
+    if (style == STYLE_PREDICT)
+	lebuf_print_sgr0();
+
+    /* make sure the line of the end of the edit line exists on the screen */
+    if (line_max < lebuf.pos.line)
+	line_max = lebuf.pos.line;
+    if (line_max < endline || lebuf.maxcolumn <= lebuf.pos.column)
+	go_to_cell((le_pos_T) { endline, 0 }, false, &style);
+
+    last_edit_line = (endline >= rprompt_line) ? endline : rprompt_line;
+
+    /* Lines below `last_edit_line' are not tracked because the candidate area
+     * may be printed there. */
+    struct cellgrid_T grid = editgrid;
+    editgrid = newgrid, newgrid = grid;
+    editgrid.rows = last_edit_line - editbasepos.line + 1;
+
+    if (0 <= candbaseline && candbaseline <= overwritten) {
+	candbaseline = overwritten + 1;
+	candoverwritten = true;
     }
+}
 
-    update_styler();
+/* Lays out the edit line into `newgrid' and sets `cursor_positions'
+ * accordingly. */
+void layout_editline(void)
+{
+    le_pos_T save_pos = lebuf.pos;
+
+    newgrid.rows = 0;
+    newgrid.columns = lebuf.maxcolumn;
+    lebuf.pos = editbasepos;
 
     // No need to check for overflow in `le_main_buffer.length + 1' here. Should
     // overflow occur, the buffer would not have been allocated successfully.
-    current_editline = xreallocn(current_editline,
-	    le_main_buffer.length + 1, sizeof *current_editline);
     cursor_positions = xreallocn(cursor_positions,
 	    le_main_buffer.length + 1, sizeof *cursor_positions);
-    for (;;) {
-	wchar_t c = le_main_buffer.contents[index];
-	current_editline[index] = c;
+    for (size_t index = 0; ; index++) {
 	cursor_positions[index]
 	    = lebuf.pos.line * lebuf.maxcolumn + lebuf.pos.column;
 	if (index == le_main_buffer.length)
 	    break;
-	if (styler_active && index >= le_main_length) {
-	    lebuf_print_sgr0();
-	    lebuf_print_prompt(prompt.predict);
-	    styler_active = false;
-	}
-	lebuf_putwchar(c, true);
-	index++;
+	layout_wchar(le_main_buffer.contents[index],
+		index < le_main_length ? CELL_TEXT : CELL_PREDICT);
     }
-    lebuf_print_sgr0();
+    grid_extend(&newgrid, cursor_positions[le_main_buffer.length]
+	    / lebuf.maxcolumn - editbasepos.line + 1);
 
-    current_length = le_main_length;
+    lebuf.pos = save_pos;
+}
 
-    fillip_cursor();
+/* Lays out the specified character as `lebuf_putwchar(c, true)' would print
+ * it. */
+void layout_wchar(wchar_t c, cellkind_T kind)
+{
+    int width = wcwidth(c);
+    if (width > 0) {
+	layout_glyph(c, width, kind);
+    } else if (c < L'\040') {
+	layout_glyph(L'^', 1, kind);
+	layout_wchar(c + L'\100', kind);
+    } else if (c == L'\177') {
+	layout_glyph(L'^', 1, kind);
+	layout_glyph(L'?', 1, kind);
+    } else {
+	wchar_t *s = malloc_wprintf(L"<%jX>", (uintmax_t) c);
+	for (size_t i = 0; s[i] != L'\0'; i++)
+	    layout_glyph(s[i], 1, kind);
+	free(s);
+    }
+}
 
-    last_edit_line =
-	(lebuf.pos.line >= rprompt_line) ? lebuf.pos.line : rprompt_line;
+/* Puts a printable character of the specified width into the cells at the
+ * position of `lebuf.pos' and advances the position. */
+void layout_glyph(wchar_t c, int width, cellkind_T kind)
+{
+    le_pos_T p = lebuf.pos;
+    lebuf_update_position(width);
+    if (lebuf.pos.line != p.line && lebuf.pos.column != 0) {
+	/* The character did not fit in the line and was wrapped. */
+	p.line = lebuf.pos.line, p.column = 0;
+    }
 
-    /* clear the right prompt if the edit line reaches it. */
-    if (rprompt_line == lebuf.pos.line
-	    && lebuf.pos.column > lebuf.maxcolumn - rprompt.width - 2) {
-	lebuf_print_el();
-	rprompt_line = -1;
-    } else if (rprompt_line < lebuf.pos.line) {
-	rprompt_line = -1;
+    cell_T *cells = grid_cell(&newgrid, p);
+    cells[0] = (cell_T) { .c = c, .kind = kind };
+    for (int i = 1; i < width && p.column + i < newgrid.columns; i++)
+	cells[i] = (cell_T) { .c = L'\0', .kind = CELL_CONT };
+}
+
+/* Returns a pointer to the cell at the specified position in the grid.
+ * The grid is extended if the position is beyond the last row. */
+cell_T *grid_cell(struct cellgrid_T *grid, le_pos_T p)
+{
+    int row = p.line - editbasepos.line;
+    assert(row >= 0);
+    assert(0 <= p.column && p.column < grid->columns);
+    grid_extend(grid, row + 1);
+    return &grid->cells[(size_t) row * (size_t) grid->columns + p.column];
+}
+
+/* Adds blank rows to the grid so that it has at least `rows' rows. */
+void grid_extend(struct cellgrid_T *grid, int rows)
+{
+    if (grid->rows >= rows)
+	return;
+
+    size_t oldcount = (size_t) grid->rows * (size_t) grid->columns;
+    size_t newcount = (size_t) rows * (size_t) grid->columns;
+    if (grid->capacity < newcount) {
+	size_t capacity = grid->capacity * 2;
+	if (capacity < newcount)
+	    capacity = newcount;
+	grid->cells = xreallocn(grid->cells, capacity, sizeof *grid->cells);
+	grid->capacity = capacity;
     }
+    for (size_t i = oldcount; i < newcount; i++)
+	grid->cells[i] = (cell_T) { .c = L'\0', .kind = CELL_BLANK };
+    grid->rows = rows;
+}
 
-    /* clear the remaining of the current line if we're overwriting the
-     * candidate area. */
-    check_cand_overwritten();
+/* Frees the cells of the grid. */
+void grid_free(struct cellgrid_T *grid)
+{
+    free(grid->cells);
+    grid->cells = NULL;
+    grid->rows = grid->columns = 0;
+    grid->capacity = 0;
 }
 
-bool current_display_is_uptodate(size_t index)
+/* Returns true iff the old cell on the screen must be reprinted to show the
+ * new cell. */
+bool cell_changed(const cell_T *old, const cell_T *new)
 {
-    if (current_editline[index] != le_main_buffer.contents[index])
-	return false;
-    if ((index == current_length || index == le_main_length) &&
-	    current_length != le_main_length)
-	return false;
-    return true;
+    return old->kind == CELL_UNKNOWN
+	|| old->kind != new->kind || old->c != new->c;
+}
+
+/* Prints the cells of `newgrid' that differ from `editgrid' in the specified
+ * row. Nearby runs of changed cells are printed together as reprinting a few
+ * unchanged cells is cheaper than moving the cursor over them. The rest of the
+ * line is cleared by the "el" capability unless the right prompt is on the
+ * line. */
+void print_changed_cells(int row, textstyle_T *style)
+{
+    enum { MERGE_GAP = 4, };
+
+    int columns = editgrid.columns;
+    const cell_T *old = &editgrid.cells[(size_t) row * (size_t) columns];
+    const cell_T *new = &newgrid.cells[(size_t) row * (size_t) columns];
+    int line = editbasepos.line + row;
+    int start = (row == 0) ? editbasepos.column : 0;
+    bool keeprp = (line == rprompt_line);
+
+    /* `newend' is the column after the last non-blank new cell. */
+    int newend = columns;
+    while (newend > start && new[newend - 1].kind == CELL_BLANK)
+	newend--;
+
+    for (int col = start; ; ) {
+	while (col < columns && !cell_changed(&old[col], &new[col]))
+	    col++;
+	if (col >= columns)
+	    break;
+
+	/* find the run of changed cells, including whole wide characters */
+	int runstart = col, runend = col + 1;
+	while (runstart > start && (old[runstart].kind == CELL_CONT
+		    || new[runstart].kind == CELL_CONT))
+	    runstart--;
+	for (;;) {
+	    while (runend < columns && (old[runend].kind == CELL_CONT
+			|| new[runend].kind == CELL_CONT))
+		runend++;
+
+	    int next = runend;
+	    while (next < columns && next <= runend + MERGE_GAP
+		    && !cell_changed(&old[next], &new[next]))
+		next++;
+	    if (next >= columns || next > runend + MERGE_GAP)
+		break;
+	    runend = next + 1;
+	}
+
+	int printend = (keeprp || runend <= newend) ? runend : newend;
+	if (runstart < printend) {
+	    go_to_cell((le_pos_T) { line, runstart }, true, style);
+	    for (int i = runstart; i < printend; i++)
+		print_cell(&new[i], style);
+	}
+	if (printend < runend) {
+	    go_to_cell((le_pos_T) { line, printend }, false, style);
+	    set_cell_style(CELL_BLANK, style);
+	    lebuf_print_el();
+	    break;
+	}
+	col = runend;
+    }
+}
+
+/* Prints the specified cell at the current position. */
+void print_cell(const cell_T *cell, textstyle_T *style)
+{
+    switch (cell->kind) {
+	case CELL_CONT:
+	    break;
+	case CELL_BLANK:
+	    set_cell_style(CELL_BLANK, style);
+	    lebuf_putwchar(L' ', false);
+	    break;
+	case CELL_TEXT:
+	case CELL_PREDICT:
+	    set_cell_style(cell->kind, style);
+	    lebuf_putwchar(cell->c, false);
+	    break;
+	case CELL_UNKNOWN:
+	    assert(false);
+    }
+}
+
+/* Changes the text style, if necessary, to print cells of the specified kind.
+ * Blank cells can be printed in the style of the styler prompt. */
+void set_cell_style(cellkind_T kind, textstyle_T *style)
+{
+    switch (kind) {
+	case CELL_TEXT:
+	    if (*style != STYLE_TEXT) {
+		styler_active = false;
+		update_styler();
+		*style = STYLE_TEXT;
+	    }
+	    break;
+	case CELL_PREDICT:
+	    if (*style != STYLE_PREDICT) {
+		lebuf_print_sgr0();
+		lebuf_print_prompt(prompt.predict);
+		styler_active = false;
+		*style = STYLE_PREDICT;
+	    }
+	    break;
+	default:
+	    if (*style != STYLE_NONE && *style != STYLE_TEXT) {
+		lebuf_print_sgr0();
+		styler_active = false;
+		*style = STYLE_NONE;
+	    }
+	    break;
+    }
+}
+
+/* Moves the cursor to the specified position in the edit line, adding lines
+ * below `line_max' as needed.
+ * If `printing' is true and the cursor is sticking to the end of the line just
+ * above the target, the cursor is not moved because the next printed character
+ * will wrap to the target. */
+void go_to_cell(le_pos_T p, bool printing, textstyle_T *style)
+{
+    if (line_max < lebuf.pos.line)
+	line_max = lebuf.pos.line;
+    if (lebuf.pos.line == p.line && lebuf.pos.column == p.column)
+	return;
+
+    if (lebuf.maxcolumn <= lebuf.pos.column) {
+	if (printing && p.line == lebuf.pos.line + 1 && p.column == 0)
+	    return;
+	reset_style_before_moving();
+	lebuf_print_cr();
+    }
+    if (line_max < p.line) {
+	go_to((le_pos_T) { line_max, 0 });
+	reset_style_before_moving();
+	while (lebuf.pos.line < p.line)
+	    lebuf_print_nel();
+	line_max = p.line;
+    }
+    go_to(p);
+
+    if (!le_ti_msgr)
+	*style = STYLE_NONE;
 }
 
 /* Sets the `candoverwritten' flag and clears to the end of line if the current
@@ -820,7 +1140,7 @@ void print_search(void)
 {
     assert(le_search_buffer.contents != NULL);
 
-    free(current_editline), current_editline = NULL;
+    grid_free(&editgrid);
     free(cursor_positions), cursor_positions = NULL;
 
     go_to(editbasepos);
@@ -931,6 +1251,7 @@ void fillip_cursor(void)
 
 
 /* Sets the `raw' and `width' members of candidates in `le_candidates'.
+ * Candidates whose members have already been set are skipped.
  * This function uses the print buffer to calculate the widths. */
 void le_display_make_rawvalues(void)
 {
@@ -938,8 +1259,9 @@ void le_display_make_rawvalues(void)
 
     for (size_t i = 0; i < le_candidates.length; i++) {
 	le_candidate_T *cand = le_candidates.contents[i];
+	if (cand->rawvalue.raw != NULL)
+	    continue;  /* already made while the candidates were generated */
 
-	assert(cand->rawvalue.raw == NULL);
 	lebuf_init_with_max((le_pos_T) { 0, 0 }, -1);
 
 	print_candidate_rawvalue(cand);
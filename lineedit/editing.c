@@ -24,6 +24,8 @@
 # include <libintl.h>
 #endif
 #include <limits.h>
+#include <locale.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -100,6 +102,16 @@ static struct {
     enum le_search_type_T type;
     wchar_t *value;
 } last_search;
+/* The last search performed by `perform_search'. If the next search starts
+ * from the same entry with a refined pattern, it resumes from `result' because
+ * the entries skipped by the last search cannot match the refined pattern.
+ * `pattern' is NULL if there is no search to resume. */
+static struct {
+    const histlink_T *start, *result;
+    enum le_search_direction_T direction;
+    enum le_search_type_T type;
+    wchar_t *pattern;
+} resumable_search;
 
 /* The last executed command and the currently executing command. */
 static struct le_command_T last_command, current_command;
@@ -202,8 +214,33 @@ static bool reset_completion;
 /* The next value of `reset_completion'. */
 static bool next_reset_completion;
 
-/* Probability distribution tree for command prediction. */
+/* Probability distribution tree for command prediction.
+ * The tree is built when prediction is first needed and then kept up to date
+ * as history entries are added and removed. It is NULL when not built. */
 static trie_T *prediction_tree = NULL;
+/* The oldest history entry whose weight is included in `prediction_tree' and
+ * the number of such entries. The entries are the newest ones in the history.
+ */
+static const histlink_T *prediction_oldest;
+static size_t prediction_count;
+/* The number of entries removed from `prediction_tree' since it was built. */
+static size_t prediction_removed_count;
+/* The weight of the history entry that is added to `prediction_tree' next.
+ * The weights actually added to the tree are rounded to integers so that
+ * subtracting them leaves no rounding errors in the tree. */
+static double prediction_next_weight;
+/* The value of the LC_CTYPE locale category when `prediction_tree' was built.
+ * The tree is re-created if the locale changes because history entries are
+ * converted to wide strings differently. */
+static char *prediction_locale;
+/* A command added to `prediction_tree' for the current command line because it
+ * follows commands that match the newest history entries. */
+typedef struct contextprediction_T {
+    double weight;
+    wchar_t command[];
+} contextprediction_T;
+/* The list of `contextprediction_T' that are added to `prediction_tree'. */
+static plist_T context_predictions;
 
 
 static void reset_state(void);
@@ -296,6 +333,11 @@ static void cancel_undo(int offset);
 static void check_reset_completion(void);
 
 static void create_prediction_tree(void);
+static void destroy_prediction_tree(void);
+static void add_prediction(histentry_T *e)
+    __attribute__((nonnull));
+static void add_context_predictions(void);
+static void remove_context_predictions(void);
 static size_t count_matching_previous_commands(const histentry_T *e1)
     __attribute__((nonnull,pure));
 static void clear_prediction(void);
@@ -326,6 +368,11 @@ static void update_search(void);
 static void perform_search(const wchar_t *pattern,
 	enum le_search_direction_T dir, enum le_search_type_T type)
     __attribute__((nonnull));
+static bool can_resume_search(const wchar_t *pattern,
+	enum le_search_direction_T dir, enum le_search_type_T type)
+    __attribute__((nonnull,pure));
+static histsig_T pattern_signature(const wchar_t *pattern)
+    __attribute__((nonnull));
 static void search_again(enum le_search_direction_T dir);
 static void beginning_search(enum le_search_direction_T dir);
 static inline bool beginning_search_check_go_to_history(const wchar_t *prefix)
@@ -367,8 +414,15 @@ void le_editing_init(void)
     set_overwriting(false);
 
     if (shopt_le_predict) {
-	create_prediction_tree();
+	if (prediction_tree != NULL
+		&& strcmp(prediction_locale, setlocale(LC_CTYPE, NULL)) != 0)
+	    destroy_prediction_tree();
+	if (prediction_tree == NULL)
+	    create_prediction_tree();
+	add_context_predictions();
 	update_buffer_with_prediction();
+    } else {
+	destroy_prediction_tree();
     }
 }
 
@@ -384,9 +438,10 @@ wchar_t *le_editing_finalize(void)
 
     end_using_history();
     free(main_history_value);
+    free(resumable_search.pattern), resumable_search.pattern = NULL;
 
     clear_prediction();
-    trie_destroy(prediction_tree), prediction_tree = NULL;
+    remove_context_predictions();
     wb_wccat(&le_main_buffer, L'\n');
     return wb_towcs(&le_main_buffer);
 }
@@ -2495,30 +2550,172 @@ void check_reset_completion(void)
 #define MAX_PREDICTION_SAMPLE 10000
 #endif /* ifndef MAX_PREDICTION_SAMPLE */
 
-/* Create a probability distribution tree for command prediction based on the
- * current history. The result is set to `prediction_tree'. */
+#ifndef PREDICTION_HALF_LIFE
+#define PREDICTION_HALF_LIFE 1000
+#endif /* ifndef PREDICTION_HALF_LIFE */
+
+/* The ratio of the weight of a history entry to that of the previous entry.
+ * The weight of an entry is half that of the entry added
+ * PREDICTION_HALF_LIFE entries later. */
+#define PREDICTION_GROWTH exp2(1.0 / PREDICTION_HALF_LIFE)
+
+/* The weight of the first history entry added to a new prediction tree.
+ * As the weights are rounded to integers, this determines their precision. The
+ * tree is re-created before the weights grow so large that their sums in the
+ * tree are no longer exact. */
+#define PREDICTION_INITIAL_WEIGHT 4096.0
+
+/* Creates a probability distribution tree for command prediction based on the
+ * newest MAX_PREDICTION_SAMPLE entries of the current history. The result is
+ * set to `prediction_tree'. */
 void create_prediction_tree(void)
 {
-    trie_T *t = trie_create();
+    assert(prediction_tree == NULL);
+
+    const histlink_T *l = Histlist;
+    for (size_t i = 0; i < MAX_PREDICTION_SAMPLE; i++)
+	if ((l = l->prev) == Histlist)
+	    break;
+    if (l == Histlist)
+	l = l->next;
+
+    prediction_tree = trie_create();
+    prediction_locale = xstrdup(setlocale(LC_CTYPE, NULL));
+    prediction_oldest = l;
+    prediction_count = prediction_removed_count = 0;
+    prediction_next_weight = PREDICTION_INITIAL_WEIGHT;
+    for (; l != Histlist; l = l->next)
+	add_prediction(ashistentry(l));
+    pl_init(&context_predictions);
+}
+
+/* Destroys `prediction_tree'. It will be re-created when needed. */
+void destroy_prediction_tree(void)
+{
+    if (prediction_tree == NULL)
+	return;
+
+    for (const histlink_T *l = prediction_oldest; l != Histlist; l = l->next)
+	ashistentry(l)->prediction_weight = 0.0;
+    trie_destroy(prediction_tree), prediction_tree = NULL;
+    free(prediction_locale);
+    plfree(pl_toary(&context_predictions), free);
+}
+
+/* Adds the command of history entry `e' to `prediction_tree' with the weight
+ * of `prediction_next_weight'. Entry `e' must be the newest of the entries in
+ * the tree. */
+void add_prediction(histentry_T *e)
+{
+    double weight = round(prediction_next_weight);
+    wchar_t *cmd = malloc_mbstowcs(e->value);
+    if (cmd != NULL) {
+	prediction_tree = trie_add_probability(prediction_tree, cmd, weight);
+	free(cmd);
+    }
+    e->prediction_weight = weight;
+    prediction_count++;
+    prediction_next_weight *= PREDICTION_GROWTH;
+}
+
+/* Updates `prediction_tree' after history entry `e' has been added to the end
+ * of the history. */
+void le_prediction_add_history_entry(histentry_T *e)
+{
+    if (prediction_tree == NULL)
+	return;
+
+    if (prediction_count == 0)
+	prediction_oldest = &e->link;
+    add_prediction(e);
+    if (prediction_count > MAX_PREDICTION_SAMPLE)
+	le_prediction_remove_history_entry(ashistentry(prediction_oldest));
+}
+
+/* Updates `prediction_tree' before history entry `e' is removed from the
+ * history. */
+void le_prediction_remove_history_entry(histentry_T *e)
+{
+    if (prediction_tree == NULL || e->prediction_weight == 0.0)
+	return;
+
+    wchar_t *cmd = malloc_mbstowcs(e->value);
+    if (cmd != NULL) {
+	prediction_tree = trie_add_probability(
+		prediction_tree, cmd, -e->prediction_weight);
+	free(cmd);
+    }
+    e->prediction_weight = 0.0;
+    if (&e->link == prediction_oldest)
+	prediction_oldest = prediction_oldest->next;
+    prediction_count--;
+
+    /* The weights keep growing, so the tree is re-created once in a while to
+     * keep the sums of the weights in the tree exact. */
+    if (++prediction_removed_count >= MAX_PREDICTION_SAMPLE)
+	destroy_prediction_tree();
+}
+
+/* Destroys `prediction_tree' before all the history entries are removed. */
+void le_prediction_clear_history(void)
+{
+    destroy_prediction_tree();
+}
+
+/* Adds weights to the commands that followed commands matching the newest
+ * history entries, so that command succession patterns are taken into account.
+ * The weights are removed by `remove_context_predictions'. */
+void add_context_predictions(void)
+{
+    assert(prediction_tree != NULL);
+    assert(context_predictions.length == 0);
+
+    double top_weight = prediction_next_weight / PREDICTION_GROWTH;
 #define N 4
     size_t hits[N] = {0};
+    size_t count = 0;
     for (const histlink_T *l = Histlist; (l = l->prev) != Histlist; ) {
-	const histentry_T *e = (const histentry_T *) l;
+	if (++count > prediction_count)
+	    break;
+
+	const histentry_T *e = ashistentry(l);
 	size_t k = count_matching_previous_commands(e);
 	assert(k < N);
-	for (size_t i = 0; i <= k; i++)
+	if (k == 0)
+	    continue;
+	for (size_t i = 1; i <= k; i++)
 	    hits[i]++;
-	if (hits[0] >= MAX_PREDICTION_SAMPLE)
-	    break;
 
-	wchar_t *cmd = malloc_mbstowcs(e->value);
-	if (cmd == NULL)
+	contextprediction_T *p = xmallocs(sizeof *p,
+		add(strlen(e->value), 1), sizeof *p->command);
+	size_t n = mbstowcs(p->command, e->value, strlen(e->value) + 1);
+	if (n == (size_t) -1) {
+	    free(p);
 	    continue;
-	t = trie_add_probability(t, cmd, 1.0 / (hits[k] + 1));
-	free(cmd);
+	}
+	p->weight = round(top_weight / (hits[k] + 1));
+	if (p->weight <= 0.0) {
+	    free(p);
+	    continue;
+	}
+	prediction_tree =
+	    trie_add_probability(prediction_tree, p->command, p->weight);
+	pl_add(&context_predictions, p);
     }
+}
 
-    prediction_tree = t;
+/* Removes the weights added by `add_context_predictions'. */
+void remove_context_predictions(void)
+{
+    if (prediction_tree == NULL)
+	return;
+
+    for (size_t i = 0; i < context_predictions.length; i++) {
+	contextprediction_T *p = context_predictions.contents[i];
+	prediction_tree =
+	    trie_add_probability(prediction_tree, p->command, -p->weight);
+    }
+    pl_clear(&context_predictions, free);
 }
 
 // Counts N-1 at most
@@ -2531,7 +2728,8 @@ size_t count_matching_previous_commands(const histentry_T *e)
 
 	const histentry_T *e1 = (const histentry_T *) l1;
 	const histentry_T *e2 = (const histentry_T *) l2;
-	if (strcmp(e1->value, e2->value) != 0)
+	if (e1->signature != e2->signature
+		|| strcmp(e1->value, e2->value) != 0)
 	    break;
 	count++;
 	if (count >= N - 1)
@@ -3690,45 +3888,56 @@ void perform_search(const wchar_t *pattern,
 	enum le_search_direction_T dir, enum le_search_type_T type)
 {
     const histlink_T *l = main_history_entry;
-    xfnmatch_T *xfnm;
+    const wchar_t *glob = pattern;
+    wchar_t *escaped = NULL;
+    xfnmflags_T flags;
 
     if (dir == FORWARD && l == Histlist)
 	goto done;
 
     switch (type) {
-	case SEARCH_PREFIX: {
-	    wchar_t *p = escape(pattern, NULL);
-	    xfnm = xfnm_compile(p, XFNM_HEADONLY);
-	    free(p);
+	case SEARCH_PREFIX:
+	    glob = escaped = escape(pattern, NULL);
+	    flags = XFNM_HEADONLY;
 	    break;
-	}
-	case SEARCH_VI: {
-	    xfnmflags_T flags = 0;
-	    if (pattern[0] == L'^') {
+	case SEARCH_VI:
+	    flags = 0;
+	    if (glob[0] == L'^') {
 		flags |= XFNM_HEADONLY;
-		pattern++;
-		if (pattern[0] == L'\0') {
+		glob++;
+		if (glob[0] == L'\0') {
 		    l = Histlist;
 		    goto done;
 		}
 	    }
-	    xfnm = xfnm_compile(pattern, flags);
 	    break;
-	}
-	case SEARCH_EMACS: {
-	    wchar_t *p = escape(pattern, NULL);
-	    xfnm = xfnm_compile(p, 0);
-	    free(p);
+	case SEARCH_EMACS:
+	    glob = escaped = escape(pattern, NULL);
+	    flags = 0;
 	    break;
-	}
 	default:
 	    assert(false);
     }
+
+    xfnmatch_T *xfnm = xfnm_compile(glob, flags);
+    histsig_T signature = pattern_signature(glob);
+    free(escaped);
     if (xfnm == NULL) {
 	l = Histlist;
 	goto done;
     }
 
+    if (can_resume_search(pattern, dir, type)) {
+	/* Start from the last result, which may match the refined pattern. */
+	l = resumable_search.result;
+	if (l == Histlist)
+	    goto cache;
+	switch (dir) {
+	    case FORWARD:   l = l->prev;  break;
+	    case BACKWARD:  l = l->next;  break;
+	}
+    }
+
     for (;;) {
 	switch (dir) {
 	    case FORWARD:   l = l->next;  break;
@@ -3736,14 +3945,98 @@ void perform_search(const wchar_t *pattern,
 	}
 	if (l == Histlist)
 	    break;
-	if (xfnm_match(xfnm, ashistentry(l)->value) == 0)
+
+	const histentry_T *e = ashistentry(l);
+	if ((e->signature & signature) == signature
+		&& xfnm_match(xfnm, e->value) == 0)
 	    break;
     }
+cache:
     xfnm_free(xfnm);
+    free(resumable_search.pattern);
+    resumable_search.start = main_history_entry;
+    resumable_search.result = l;
+    resumable_search.direction = dir;
+    resumable_search.type = type;
+    resumable_search.pattern = xwcsdup(pattern);
 done:
     le_search_result = l;
 }
 
+/* Checks if the search for `pattern' can resume from the result of the last
+ * search, that is, if the search starts from the same entry in the same way
+ * and any entry that matches `pattern' also matches the last pattern. */
+bool can_resume_search(const wchar_t *pattern,
+	enum le_search_direction_T dir, enum le_search_type_T type)
+{
+    if (resumable_search.pattern == NULL
+	    || resumable_search.start != main_history_entry
+	    || resumable_search.direction != dir
+	    || resumable_search.type != type)
+	return false;
+    if (matchwcsprefix(pattern, resumable_search.pattern) == NULL)
+	return false;
+    if (type != SEARCH_VI)
+	return true;
+
+    /* Appending characters to a glob narrows it down unless the last pattern
+     * ends with a backslash or contains a bracket expression that may be
+     * completed by the appended characters. */
+    for (const wchar_t *p = resumable_search.pattern; *p != L'\0'; p++) {
+	if (*p == L'[')
+	    return false;
+	if (*p == L'\\' && *++p == L'\0')
+	    return false;
+    }
+    return true;
+}
+
+/* Computes the signature of the literal parts of glob `pattern'.
+ * The signature is used to skip history entries that cannot match the
+ * pattern without performing pattern matching on them. */
+histsig_T pattern_signature(const wchar_t *pattern)
+{
+    histsig_T signature = 0;
+
+    /* In a state-dependent encoding, the same character may be encoded in
+     * different byte sequences, so the signature would be useless. */
+    if (mbtowc(NULL, NULL, 0) != 0)
+	return signature;
+
+    xwcsbuf_T buf;
+    wb_init(&buf);
+    for (;;) {
+	switch (*pattern) {
+	    case L'\\':
+		if (pattern[1] == L'\0')
+		    break;
+		pattern++;
+		/* falls thru! */
+	    default:
+		wb_wccat(&buf, *pattern++);
+		continue;
+	    case L'*':
+	    case L'?':
+	    case L'[':
+	    case L'\0':
+		break;
+	}
+
+	/* The literal part ends here. */
+	char *mbs = malloc_wcstombs(buf.contents);
+	if (mbs != NULL) {
+	    signature |= history_signature(mbs);
+	    free(mbs);
+	}
+	wb_clear(&buf);
+	if (*pattern != L'*' && *pattern != L'?')
+	    break;
+	pattern++;
+    }
+    wb_destroy(&buf);
+    return signature;
+}
+
 /* Redoes the last search. */
 void cmd_search_again(wchar_t c __attribute__((unused)))
 {
@@ -20,6 +20,7 @@
 #define YASH_EDITING_H
 
 #include <stddef.h>
+#include "../history.h"
 #include "../strbuf.h"
 #include "key.h"
 
@@ -43,6 +44,12 @@ extern wchar_t *le_editing_finalize(void)
 extern void le_invoke_command(le_command_func_T *cmd, wchar_t arg)
     __attribute__((nonnull));
 
+extern void le_prediction_add_history_entry(histentry_T *e)
+    __attribute__((nonnull));
+extern void le_prediction_remove_history_entry(histentry_T *e)
+    __attribute__((nonnull));
+extern void le_prediction_clear_history(void);
+
 
 /********** Commands **********/
 
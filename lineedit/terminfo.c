@@ -33,6 +33,7 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #if HAVE_TIOCGWINSZ
 # include <sys/ioctl.h>
 #endif
@@ -283,8 +284,6 @@ static void move_cursor(char *capone, char *capmul, long count, int affcnt)
     __attribute__((nonnull));
 static _Bool move_cursor_1(char *capone, long count)
     __attribute__((nonnull));
-static _Bool move_cursor_mul(char *capmul, long count, int affcnt)
-    __attribute__((nonnull));
 static void print_color_code(long color, char *seta, char *set)
     __attribute__((nonnull));
 static void print_smkx(void);
@@ -597,13 +596,21 @@ void lebuf_print_nel(void)
 void move_cursor(char *capone, char *capmul, long count, int affcnt)
 {
     if (count > 0) {
-	if (count == 1) {
-	    if (!move_cursor_1(capone, 1))
-		move_cursor_mul(capmul, 1, affcnt);
-	} else {
-	    if (!move_cursor_mul(capmul, count, affcnt))
-		move_cursor_1(capone, count);
-	}
+	/* Use whichever of the repeated `capone' and the parameterized `capmul'
+	 * is shorter. */
+	char *one = tigetstr(capone);
+	size_t onelength = is_strcap_valid(one) ? strlen(one) : 0;
+	char *mul = tigetstr(capmul);
+	if (is_strcap_valid(mul))
+	    mul = tparm(mul, count, 0L, 0L, 0L, 0L, 0L, 0L, 0L, 0L);
+	else
+	    mul = NULL;
+
+	if (onelength > 0 &&
+		(mul == NULL || onelength * (size_t) count <= strlen(mul)))
+	    move_cursor_1(capone, count);
+	else if (mul != NULL)
+	    tputs(mul, affcnt, lebuf_putchar);
     }
 }
 
@@ -620,19 +627,6 @@ _Bool move_cursor_1(char *capone, long count)
     }
 }
 
-_Bool move_cursor_mul(char *capmul, long count, int affcnt)
-{
-    char *v = tigetstr(capmul);
-    if (is_strcap_valid(v)) {
-	v = tparm(v, count, 0L, 0L, 0L, 0L, 0L, 0L, 0L, 0L);
-	if (v != NULL) {
-	    tputs(v, affcnt, lebuf_putchar);
-	    return 1;
-	}
-    }
-    return 0;
-}
-
 /* Prints the "cub"/"cub1" code to the print buffer.
  * (move cursor backward by `count' columns)
  * `count' must be small enough not to go beyond the screen bounds. */
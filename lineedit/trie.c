@@ -19,7 +19,6 @@
 #include "../common.h"
 #include "trie.h"
 #include <assert.h>
-#include <math.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <string.h>
@@ -411,7 +410,11 @@ void trie_destroy(trienode_T *node)
 /********** Functions for prediction **********/
 
 /* Adds the given probability value `p' to each node on the given key string
- * `keywcs'. */
+ * `keywcs'.
+ * A negative `p' removes a key added before. A node whose probability falls to
+ * zero or below is removed together with its descendants, so the caller should
+ * use values whose sums are exact (such as integers) to remove keys
+ * completely. */
 trienode_T *trie_add_probability(
 	trienode_T *node, const wchar_t *keywcs, double p)
 {
@@ -433,6 +436,12 @@ trienode_T *trie_add_probability(
     }
     node->entries[index].child = trie_add_probability(
 	    node->entries[index].child, &keywcs[1], p);
+    if (node->entries[index].child->value.probability <= 0.0) {
+	trie_destroy(node->entries[index].child);
+	memmove(&node->entries[index], &node->entries[index + 1],
+		sizeof *node->entries * (node->count - index - 1));
+	node = shrink(node);
+    }
     return node;
 }
 
@@ -477,10 +486,10 @@ wchar_t *trie_probable_key(const trienode_T *node, const wchar_t *skipkey)
 }
 
 /* Find the given node's child that have the most probability value.
- * Returns NULL iff the node has no children. */
+ * Returns NULL iff the node has no children with a positive probability. */
 const trieentry_T *most_probable_child(const trienode_T *node)
 {
-    double max_probability = -HUGE_VAL;
+    double max_probability = 0.0;
     const trieentry_T *entry = NULL;
     for (size_t i = 0; i < node->count; i++) {
 	assert(node->entries[i].child->valuevalid);
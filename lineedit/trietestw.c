@@ -33,6 +33,13 @@ void print(const trie_T *t, const wchar_t *key)
     }
 }
 
+void print_probable_key(const trie_T *t, const wchar_t *key)
+{
+    wchar_t *result = trie_probable_key(t, key);
+    printf("%-10ls: predict \"%ls\"\n", key, result);
+    free(result);
+}
+
 int main(int argc, char **argv)
 {
     (void) argc, (void) argv;
@@ -84,6 +91,25 @@ int main(int argc, char **argv)
 
     trie_destroy(t);
 
+    printf("\n");
+
+    t = trie_create();
+    t = trie_add_probability(t, L"echo zqsecret", 3.0);
+    t = trie_add_probability(t, L"echo a", 1.0);
+    t = trie_add_probability(t, L"echo b", 1.0);
+    print_probable_key(t, L"echo ");
+    print_probable_key(t, L"echo zq");
+
+    /* A removed key must not be predicted any more. */
+    t = trie_add_probability(t, L"echo zqsecret", -3.0);
+    print_probable_key(t, L"echo ");
+    print_probable_key(t, L"echo zq");
+    t = trie_add_probability(t, L"echo a", -1.0);
+    t = trie_add_probability(t, L"echo b", -1.0);
+    print_probable_key(t, L"");
+
+    trie_destroy(t);
+
     exit(EXIT_SUCCESS);
 }
 
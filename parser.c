@@ -34,12 +34,14 @@
 #include <wchar.h>
 #include <wctype.h>
 #include "alias.h"
+#include "arith.h"
 #include "expand.h"
 #include "input.h"
 #include "option.h"
 #include "plist.h"
 #include "strbuf.h"
 #include "util.h"
+#include "xfnmatch.h"
 #if YASH_ENABLE_DOUBLE_BRACKET
 # include "builtins/test.h"
 #endif
@@ -62,9 +64,17 @@ static void wordfree_vp(void *w);
 static void assignsfree(assign_T *a);
 static void redirsfree(redir_T *r);
 static void embedcmdfree(embedcmd_T c);
+static void caseitemxfnmsfree(void *ci)
+    __attribute__((nonnull));
+static void parsearenafree(parsearena_T *a);
 
 void andorsfree(and_or_T *a)
 {
+    if (a != NULL && a->ao_arena != NULL) {
+	parsearenafree(a->ao_arena);
+	return;
+    }
+
     while (a != NULL) {
 	pipesfree(a->ao_pipelines);
 
@@ -87,6 +97,11 @@ void pipesfree(pipeline_T *p)
 
 void comsfree(command_T *c)
 {
+    if (c != NULL && c->c_arena != NULL) {
+	parsearenafree(c->c_arena);
+	return;
+    }
+
     while (c != NULL) {
 	if (!refcount_decrement(&c->refcount))
 	    break;
@@ -149,6 +164,8 @@ void ifcmdsfree(ifcommand_T *i)
 void caseitemsfree(caseitem_T *i)
 {
     while (i != NULL) {
+	caseitemxfnmsfree(i);
+	free(i->ci_xfnms);
 	plfree(i->ci_patterns, wordfree_vp);
 	andorsfree(i->ci_commands);
 
@@ -197,6 +214,7 @@ void wordunitfree(wordunit_T *wu)
 	    break;
 	case WT_ARITH:
 	    wordfree(wu->wu_arith);
+	    arithcodefree(wu->wu_arithcode);
 	    break;
     }
     free(wu);
@@ -225,6 +243,8 @@ void paramfree(paramexp_T *p)
 	    free(p->pe_name);
 	wordfree(p->pe_start);
 	wordfree(p->pe_end);
+	arithcodefree(p->pe_startcode);
+	arithcodefree(p->pe_endcode);
 	wordfree(p->pe_match);
 	wordfree(p->pe_subst);
 	free(p);
@@ -283,6 +303,163 @@ void embedcmdfree(embedcmd_T c)
 }
 
 
+/********** Parse Tree Arena **********/
+
+/* An arena is a list of memory blocks from which the nodes of a parse tree are
+ * allocated. The nodes are never freed individually; all the blocks are freed
+ * at once when the reference count of the arena drops to zero. Objects that
+ * belong to the tree but are not allocated in the arena are freed by cleanup
+ * functions registered to the arena. */
+
+/* type used to align memory allocated in arenas */
+typedef union arenaalign_T {
+    void *p;
+    void (*f)(void);
+    intmax_t i;
+    double d;
+} arenaalign_T;
+
+/* memory block of an arena */
+struct arenablock_T {
+    struct arenablock_T *next;
+    arenaalign_T data[];
+};
+
+/* cleanup function that is called when an arena is freed */
+struct arenacleanup_T {
+    struct arenacleanup_T *next;
+    void (*func)(void *);
+    void *arg;
+};
+
+struct parsearena_T {
+    refcount_T refcount;
+    struct arenablock_T *blocks;     /* the most recent block comes first */
+    char *free;                      /* unused memory in `blocks' */
+    size_t freesize;                 /* size of `free' */
+    size_t nextsize;                 /* size of the next block to allocate */
+    struct arenacleanup_T *cleanups;
+};
+/* The arena structure itself is allocated in its first block. */
+
+#define ARENA_BLOCK_MIN 1024
+#define ARENA_BLOCK_MAX (64 * 1024)
+
+static parsearena_T *new_parsearena(void)
+    __attribute__((malloc,warn_unused_result));
+static void *arena_alloc(parsearena_T *a, size_t size)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static void arena_add_cleanup(parsearena_T *a, void func(void *), void *arg)
+    __attribute__((nonnull(1,2)));
+static void arithcodefree_vp(void *code);
+static void parsearenafree_vp(void *a);
+
+/* Creates a new arena with the reference count of 1. */
+parsearena_T *new_parsearena(void)
+{
+    struct arenablock_T *b = xmalloc(
+	    offsetof(struct arenablock_T, data) + ARENA_BLOCK_MIN);
+    b->next = NULL;
+
+    parsearena_T *a = (parsearena_T *) b->data;
+    a->refcount = 1;
+    a->blocks = b;
+    a->nextsize = 2 * ARENA_BLOCK_MIN;
+    a->cleanups = NULL;
+
+    size_t size = (sizeof *a + sizeof (arenaalign_T) - 1)
+	/ sizeof (arenaalign_T) * sizeof (arenaalign_T);
+    a->free = (char *) b->data + size;
+    a->freesize = ARENA_BLOCK_MIN - size;
+    return a;
+}
+
+/* Allocates memory of the specified size in the arena. */
+void *arena_alloc(parsearena_T *a, size_t size)
+{
+    size = add(size, sizeof (arenaalign_T) - 1)
+	/ sizeof (arenaalign_T) * sizeof (arenaalign_T);
+    if (size <= a->freesize) {
+	void *result = a->free;
+	a->free += size;
+	a->freesize -= size;
+	return result;
+    }
+
+    struct arenablock_T *b;
+    if (size > a->nextsize / 4) {
+	/* Allocate a dedicated block so that the unused memory in the current
+	 * block remains available. */
+	b = xmalloc(add(offsetof(struct arenablock_T, data), size));
+	b->next = a->blocks->next;
+	a->blocks->next = b;
+	return b->data;
+    }
+
+    b = xmalloc(offsetof(struct arenablock_T, data) + a->nextsize);
+    b->next = a->blocks;
+    a->blocks = b;
+    a->free = (char *) b->data + size;
+    a->freesize = a->nextsize - size;
+    if (a->nextsize < ARENA_BLOCK_MAX)
+	a->nextsize *= 2;
+    return b->data;
+}
+
+/* Registers a function that is called with `arg' when the arena is freed. */
+void arena_add_cleanup(parsearena_T *a, void func(void *), void *arg)
+{
+    struct arenacleanup_T *c = arena_alloc(a, sizeof *c);
+    c->next = a->cleanups;
+    c->func = func;
+    c->arg = arg;
+    a->cleanups = c;
+}
+
+/* Increases the reference count of the specified arena. */
+void parsearenadup(parsearena_T *a)
+{
+    refcount_increment(&a->refcount);
+}
+
+/* Decreases the reference count of the specified arena and frees it with all
+ * the nodes in it if the count reaches zero. */
+void parsearenafree(parsearena_T *a)
+{
+    if (a == NULL || !refcount_decrement(&a->refcount))
+	return;
+
+    for (struct arenacleanup_T *c = a->cleanups; c != NULL; c = c->next)
+	c->func(c->arg);
+
+    /* `a' is in one of the blocks, so don't touch it after freeing them. */
+    struct arenablock_T *b = a->blocks;
+    while (b != NULL) {
+	struct arenablock_T *next = b->next;
+	free(b);
+	b = next;
+    }
+}
+
+void arithcodefree_vp(void *code)
+{
+    arithcodefree(code);
+}
+
+void parsearenafree_vp(void *a)
+{
+    parsearenafree(a);
+}
+
+/* Frees the compiled patterns cached in the specified case item. */
+void caseitemxfnmsfree(void *ci)
+{
+    caseitem_T *i = ci;
+    for (size_t j = 0; i->ci_patterns[j] != NULL; j++)
+	xfnm_free(i->ci_xfnms[j]);
+}
+
+
 /********** Auxiliary Functions for Parser **********/
 
 typedef enum tokentype_T {
@@ -552,7 +729,8 @@ typedef struct parsestate_T {
     tokentype_T tokentype;
     /* the current token (NULL when `tokentype' is an operator token) */
     wordunit_T *token;
-    /* here-documents whose contents have not been read */
+    /* here-documents whose contents have not been read, each followed by the
+     * arena in which the contents are allocated */
     struct plist_T pending_heredocs;
     /* false when alias substitution is suppressed */
     bool enable_alias;
@@ -561,8 +739,25 @@ typedef struct parsestate_T {
     /* record of alias substitutions that are responsible for the current
      * `index' */
     struct aliaslist_T *aliases;
+    /* arena in which the parse tree is allocated (NULL to use `malloc') */
+    parsearena_T *arena;
 } parsestate_T;
 
+static void *ps_malloc(parsestate_T *ps, size_t size)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static wchar_t *ps_wcsndup(parsestate_T *ps, const wchar_t *s, size_t len)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static wchar_t *ps_wcsown(parsestate_T *ps, wchar_t *s)
+    __attribute__((nonnull(1),warn_unused_result));
+static void **ps_toary(parsestate_T *ps, plist_T *list)
+    __attribute__((nonnull,warn_unused_result));
+static void ps_wordfree(parsestate_T *ps, wordunit_T *w)
+    __attribute__((nonnull(1)));
+static void ps_andorsfree(parsestate_T *ps, and_or_T *a)
+    __attribute__((nonnull(1)));
+static void ps_comsfree(parsestate_T *ps, command_T *c)
+    __attribute__((nonnull(1)));
+
 static void serror(parsestate_T *restrict ps, const char *restrict format, ...)
     __attribute__((nonnull(1,2),format(printf,2,3)));
 static void print_errmsg_token(parsestate_T *ps, const char *message)
@@ -607,6 +802,9 @@ static wordunit_T *parse_cmdsubst_in_backquote(parsestate_T *ps, bool bsdq)
     __attribute__((nonnull,malloc,warn_unused_result));
 static wordunit_T *tryparse_arith(parsestate_T *ps)
     __attribute__((nonnull,malloc,warn_unused_result));
+static arithcode_T *compile_literal_arithmetic(
+	parsestate_T *ps, const wordunit_T *w)
+    __attribute__((nonnull(1),malloc,warn_unused_result));
 
 static void next_line(parsestate_T *ps)
     __attribute__((nonnull));
@@ -688,6 +886,8 @@ static command_T *parse_function(parsestate_T *ps)
     __attribute__((nonnull,malloc,warn_unused_result));
 static command_T *try_reparse_as_function(parsestate_T *ps, command_T *c)
     __attribute__((nonnull,warn_unused_result));
+static command_T *parse_funcbody(parsestate_T *ps)
+    __attribute__((nonnull,warn_unused_result));
 
 static void read_heredoc_contents(parsestate_T *ps, redir_T *redir)
     __attribute__((nonnull));
@@ -727,7 +927,8 @@ static wordunit_T **parse_string_without_quotes(
  * beforehand.
  * The resulting parse tree is assigned to `*resultp' if successful. If there is
  * no command in the next line or the shell was interrupted while reading input,
- * `*resultp' is assigned NULL.
+ * `*resultp' is assigned NULL. The tree is allocated in an arena that is freed
+ * by `andorsfree'. Function bodies in the tree have arenas of their own.
  * Returns PR_OK           if successful,
  *         PR_SYNTAX_ERROR if a syntax error occurred,
  *         PR_INPUT_ERROR  if an input error occurred, or
@@ -747,6 +948,7 @@ parseresult_T read_and_parse(parseparam_T *info, and_or_T **restrict resultp)
 	.enable_alias = info->enable_alias,
 	.reparse = false,
 	.aliases = NULL,
+	.arena = new_parsearena(),
     };
 
     if (ps.info->interactive) {
@@ -766,28 +968,30 @@ parseresult_T read_and_parse(parseparam_T *info, and_or_T **restrict resultp)
     wb_destroy(&ps.src);
     pl_destroy(&ps.pending_heredocs);
     destroy_aliaslist(ps.aliases);
-    wordfree(ps.token);
 
+    /* The arena is owned by `r' if `r' is returned. */
     switch (ps.info->lastinputresult) {
 	case INPUT_OK:
 	case INPUT_EOF:
 	    if (ps.error) {
-		andorsfree(r);
+		parsearenafree(ps.arena);
 		return PR_SYNTAX_ERROR;
 	    } else if (length == 0) {
-		andorsfree(r);
+		parsearenafree(ps.arena);
 		return PR_EOF;
 	    } else {
 		assert(ps.index == length);
+		if (r == NULL)
+		    parsearenafree(ps.arena);
 		*resultp = r;
 		return PR_OK;
 	    }
 	case INPUT_INTERRUPTED:
-	    andorsfree(r);
+	    parsearenafree(ps.arena);
 	    *resultp = NULL;
 	    return PR_OK;
 	case INPUT_ERROR:
-	    andorsfree(r);
+	    parsearenafree(ps.arena);
 	    return PR_INPUT_ERROR;
     }
     assert(false);
@@ -813,6 +1017,7 @@ bool parse_string(parseparam_T *info, wordunit_T **restrict resultp)
 	.enable_alias = false,
 	.reparse = false,
 	.aliases = NULL,
+	.arena = NULL,
     };
     wb_init(&ps.src);
 
@@ -837,6 +1042,75 @@ bool parse_string(parseparam_T *info, wordunit_T **restrict resultp)
     }
 }
 
+/***** Memory allocation for parse trees *****/
+
+/* Allocates memory for a node of the parse tree. */
+void *ps_malloc(parsestate_T *ps, size_t size)
+{
+    if (ps->arena != NULL)
+	return arena_alloc(ps->arena, size);
+    else
+	return xmalloc(size);
+}
+
+/* Like `xwcsndup', but allocates the result like `ps_malloc'. */
+wchar_t *ps_wcsndup(parsestate_T *ps, const wchar_t *s, size_t len)
+{
+    if (ps->arena == NULL)
+	return xwcsndup(s, len);
+
+    len = xwcsnlen(s, len);
+    wchar_t *result = arena_alloc(ps->arena, mul(add(len, 1), sizeof *s));
+    result[len] = L'\0';
+    return wmemcpy(result, s, len);
+}
+
+/* Moves the specified string that was allocated by `malloc' into the arena.
+ * If there is no arena, the string is returned intact. */
+wchar_t *ps_wcsown(parsestate_T *ps, wchar_t *s)
+{
+    if (ps->arena == NULL || s == NULL)
+	return s;
+
+    wchar_t *result = ps_wcsndup(ps, s, SIZE_MAX);
+    free(s);
+    return result;
+}
+
+/* Like `pl_toary', but allocates the result like `ps_malloc'. */
+void **ps_toary(parsestate_T *ps, plist_T *list)
+{
+    if (ps->arena == NULL)
+	return pl_toary(list);
+
+    size_t size = mul(add(list->length, 1), sizeof *list->contents);
+    void **result = memcpy(arena_alloc(ps->arena, size), list->contents, size);
+    pl_destroy(list);
+    return result;
+}
+
+/* The following functions free a (part of a) parse tree that was allocated by
+ * the above functions. They do nothing if the tree is in the arena because
+ * the memory is reclaimed when the arena is freed. */
+
+void ps_wordfree(parsestate_T *ps, wordunit_T *w)
+{
+    if (ps->arena == NULL)
+	wordfree(w);
+}
+
+void ps_andorsfree(parsestate_T *ps, and_or_T *a)
+{
+    if (ps->arena == NULL)
+	andorsfree(a);
+}
+
+void ps_comsfree(parsestate_T *ps, command_T *c)
+{
+    if (ps->arena == NULL)
+	comsfree(c);
+}
+
 /***** Error message utility *****/
 
 /* Prints the specified error message to the standard error.
@@ -1019,7 +1293,7 @@ size_t count_name_length(parsestate_T *ps, bool isnamechar(wchar_t c))
  * The existing `token' is freed. */
 void next_token(parsestate_T *ps)
 {
-    wordfree(ps->token);
+    ps_wordfree(ps, ps->token);
     ps->token = NULL;
 
     size_t index = ps->next_index;
@@ -1120,7 +1394,7 @@ skip_blanks:
 	    wordunit_T *token = parse_word(ps, is_token_delimiter_char);
 	    index = ps->index;
 
-	    wordfree(ps->token);
+	    ps_wordfree(ps, ps->token);
 	    ps->token = token;
 
 	    /* Is this an IO_NUMBER token? */
@@ -1159,10 +1433,11 @@ wordunit_T *parse_word(parsestate_T *ps, bool testfunc(wchar_t c))
     do {                                                                 \
 	size_t len = ps->index - startindex;                             \
         if (len > 0) {                                                   \
-            wordunit_T *w = xmalloc(sizeof *w);                          \
+            wordunit_T *w = ps_malloc(ps, sizeof *w);                    \
             w->next = NULL;                                              \
             w->wu_type = WT_STRING;                                      \
-            w->wu_string = xwcsndup(&ps->src.contents[startindex], len); \
+            w->wu_string = ps_wcsndup(ps,                                \
+                    &ps->src.contents[startindex], len);                 \
             *lastp = w;                                                  \
             lastp = &w->next;                                            \
         }                                                                \
@@ -1307,12 +1582,13 @@ wordunit_T *tryparse_paramexp_raw(parsestate_T *ps)
 	namelen = count_name_length(ps, is_portable_name_char);
 
 success:;
-    paramexp_T *pe = xmalloc(sizeof *pe);
+    paramexp_T *pe = ps_malloc(ps, sizeof *pe);
     pe->pe_type = PT_NONE;
-    pe->pe_name = xwcsndup(&ps->src.contents[ps->index], namelen);
+    pe->pe_name = ps_wcsndup(ps, &ps->src.contents[ps->index], namelen);
     pe->pe_start = pe->pe_end = pe->pe_match = pe->pe_subst = NULL;
+    pe->pe_startcode = pe->pe_endcode = NULL;
 
-    wordunit_T *result = xmalloc(sizeof *result);
+    wordunit_T *result = ps_malloc(ps, sizeof *result);
     result->next = NULL;
     result->wu_type = WT_PARAM;
     result->wu_param = pe;
@@ -1330,10 +1606,11 @@ error:
  * called and the position is advanced to the closing brace L'}'. */
 wordunit_T *parse_paramexp_in_brace(parsestate_T *ps)
 {
-    paramexp_T *pe = xmalloc(sizeof *pe);
+    paramexp_T *pe = ps_malloc(ps, sizeof *pe);
     pe->pe_type = 0;
     pe->pe_name = NULL;
     pe->pe_start = pe->pe_end = pe->pe_match = pe->pe_subst = NULL;
+    pe->pe_startcode = pe->pe_endcode = NULL;
 
     assert(ps->src.contents[ps->index] == L'{');
     ps->index++;
@@ -1395,7 +1672,8 @@ parse_name:;
 	    serror(ps, Ngt("the parameter name is missing or invalid"));
 	    goto end;
 	}
-	pe->pe_name = xwcsndup(&ps->src.contents[namestartindex], namelen);
+	pe->pe_name =
+	    ps_wcsndup(ps, &ps->src.contents[namestartindex], namelen);
     }
 
     /* parse indices */
@@ -1405,11 +1683,13 @@ parse_name:;
 	pe->pe_start = parse_word(ps, is_comma_or_closing_bracket);
 	if (pe->pe_start == NULL)
 	    serror(ps, Ngt("the index is missing"));
+	pe->pe_startcode = compile_literal_arithmetic(ps, pe->pe_start);
 	if (ps->src.contents[ps->index] == L',') {
 	    ps->index++;
 	    pe->pe_end = parse_word(ps, is_comma_or_closing_bracket);
 	    if (pe->pe_end == NULL)
 		serror(ps, Ngt("the index is missing"));
+	    pe->pe_endcode = compile_literal_arithmetic(ps, pe->pe_end);
 	}
 	if (ps->src.contents[ps->index] == L']') {
 	    maybe_line_continuations(ps, ++ps->index);
@@ -1508,7 +1788,7 @@ check_closing_brace:
 		(wint_t) L'#');
 
 end:;
-    wordunit_T *result = xmalloc(sizeof *result);
+    wordunit_T *result = ps_malloc(ps, sizeof *result);
     result->next = NULL;
     result->wu_type = WT_PARAM;
     result->wu_param = pe;
@@ -1529,7 +1809,7 @@ wordunit_T *parse_cmdsubst_in_paren(parsestate_T *ps)
     else
 	serror(ps, Ngt("`%ls' is missing"), L")");
 
-    wordunit_T *result = xmalloc(sizeof *result);
+    wordunit_T *result = ps_malloc(ps, sizeof *result);
     result->next = NULL;
     result->wu_type = WT_CMDSUB;
     result->wu_cmdsub = cmd;
@@ -1576,10 +1856,10 @@ wchar_t *extract_command_in_paren_unparsed(parsestate_T *ps)
 
     size_t startindex = ps->next_index;
     next_token(ps);
-    andorsfree(parse_compound_list(ps));
+    ps_andorsfree(ps, parse_compound_list(ps));
     assert(startindex <= ps->index);
 
-    wchar_t *result = xwcsndup(
+    wchar_t *result = ps_wcsndup(ps,
 	    &ps->src.contents[startindex], ps->index - startindex);
 
     ps->enable_alias = save_enable_alias;
@@ -1631,11 +1911,11 @@ wordunit_T *parse_cmdsubst_in_backquote(parsestate_T *ps, bool bsdq)
 	}
     }
 end:;
-    wordunit_T *result = xmalloc(sizeof *result);
+    wordunit_T *result = ps_malloc(ps, sizeof *result);
     result->next = NULL;
     result->wu_type = WT_CMDSUB;
     result->wu_cmdsub.is_preparsed = false;
-    result->wu_cmdsub.value.unparsed = wb_towcs(&buf);
+    result->wu_cmdsub.value.unparsed = ps_wcsown(ps, wb_towcs(&buf));
     return result;
 }
 
@@ -1709,18 +1989,37 @@ wordunit_T *tryparse_arith(parsestate_T *ps)
 	ps->index++;
     }
 end:;
-    wordunit_T *result = xmalloc(sizeof *result);
+    wordunit_T *result = ps_malloc(ps, sizeof *result);
     result->next = NULL;
     result->wu_type = WT_ARITH;
     result->wu_arith = first;
+    result->wu_arithcode = compile_literal_arithmetic(ps, first);
     return result;
 
 not_arithmetic_expansion:
-    wordfree(first);
+    ps_wordfree(ps, first);
     rewind_index(ps, saveindex);
     return NULL;
 }
 
+/* Compiles the specified word as an arithmetic expression if it is a string
+ * that is not subject to any expansion or quote removal, that is, if the
+ * expansion of the word always yields the word itself.
+ * Returns NULL if the word is not such a string or is not compilable.
+ * If the parse tree is in an arena, the result is freed with the arena. */
+arithcode_T *compile_literal_arithmetic(parsestate_T *ps, const wordunit_T *w)
+{
+    if (w == NULL || w->next != NULL || w->wu_type != WT_STRING)
+	return NULL;
+    if (wcspbrk(w->wu_string, L"\"'\\") != NULL)
+	return NULL;
+
+    arithcode_T *code = compile_arithmetic(w->wu_string);
+    if (code != NULL && ps->arena != NULL)
+	arena_add_cleanup(ps->arena, arithcodefree_vp, code);
+    return code;
+}
+
 /***** Newline token parser *****/
 
 /* Parses the newline token at the current position and proceeds to the next
@@ -1732,11 +2031,15 @@ void next_line(parsestate_T *ps)
     ps->index++;
     ps->info->lineno++;
 
-    for (size_t i = 0; i < ps->pending_heredocs.length; i++)
+    parsearena_T *savearena = ps->arena;
+    for (size_t i = 0; i < ps->pending_heredocs.length; i += 2) {
+	ps->arena = ps->pending_heredocs.contents[i + 1];
 	read_heredoc_contents(ps, ps->pending_heredocs.contents[i]);
+    }
+    ps->arena = savearena;
     pl_truncate(&ps->pending_heredocs, 0);
 
-    wordfree(ps->token);
+    ps_wordfree(ps, ps->token);
     ps->token = NULL;
     ps->tokentype = TT_UNKNOWN;
     ps->next_index = ps->index;
@@ -1843,7 +2146,7 @@ and_or_T *parse_command_list(parsestate_T *ps, bool toeol)
 		    next_token(ps);
 		    continue;
 		}
-		wordfree(ps->token);
+		ps_wordfree(ps, ps->token);
 		ps->token = NULL;
 		ps->index = ps->next_index;
 		ps->tokentype = TT_END_OF_INPUT;
@@ -1907,9 +2210,10 @@ and_or_T *parse_and_or_list(parsestate_T *ps)
 	return NULL;
     }
 
-    and_or_T *result = xmalloc(sizeof *result);
+    and_or_T *result = ps_malloc(ps, sizeof *result);
     result->next = NULL;
     result->ao_pipelines = p;
+    result->ao_arena = ps->arena;
     result->ao_async = (ps->tokentype == TT_AMP);
     return result;
 }
@@ -1983,7 +2287,7 @@ parse_after_bang:
 	}
     }
 
-    pipeline_T *result = xmalloc(sizeof *result);
+    pipeline_T *result = ps_malloc(ps, sizeof *result);
     result->next = NULL;
     result->pl_commands = c;
     result->pl_neg = neg;
@@ -2049,9 +2353,10 @@ command_T *parse_command(parsestate_T *ps)
     }
 
     /* parse as a simple command */
-    result = xmalloc(sizeof *result);
+    result = ps_malloc(ps, sizeof *result);
     result->next = NULL;
     result->refcount = 1;
+    result->c_arena = ps->arena;
     result->c_lineno = ps->info->lineno;
     result->c_type = CT_SIMPLE;
     result->c_assigns = NULL;
@@ -2062,7 +2367,7 @@ command_T *parse_command(parsestate_T *ps)
     if (result->c_words[0] == NULL && result->c_assigns == NULL &&
 	    result->c_redirs == NULL) {
 	/* an empty command */
-	comsfree(result);
+	ps_comsfree(ps, result);
 	if (ps->tokentype == TT_END_OF_INPUT || ps->tokentype == TT_NEWLINE)
 	    serror(ps, Ngt("a command is missing at the end of input"));
 	else
@@ -2118,7 +2423,7 @@ next:
 	goto next;
     }
 
-    return pl_toary(&words);
+    return ps_toary(ps, &words);
 }
 
 /* Parses words.
@@ -2141,7 +2446,7 @@ void **parse_words(parsestate_T *ps, bool skip_newlines)
 	pl_add(&wordlist, ps->token), ps->token = NULL;
 	next_token(ps);
     }
-    return pl_toary(&wordlist);
+    return ps_toary(ps, &wordlist);
 }
 
 /* Parses as many redirections as possible.
@@ -2176,9 +2481,9 @@ assign_T *tryparse_assignment(parsestate_T *ps)
     if (namelen == 0 || *nameend != L'=')
 	return NULL;
 
-    assign_T *result = xmalloc(sizeof *result);
+    assign_T *result = ps_malloc(ps, sizeof *result);
     result->next = NULL;
-    result->a_name = xwcsndup(ps->token->wu_string, namelen);
+    result->a_name = ps_wcsndup(ps, ps->token->wu_string, namelen);
 
     /* remove the name and '=' from the token */
     size_t index_after_first_token = ps->next_index;
@@ -2187,7 +2492,8 @@ assign_T *tryparse_assignment(parsestate_T *ps)
     wmemmove(first_token->wu_string, &nameend[1], wcslen(&nameend[1]) + 1);
     if (first_token->wu_string[0] == L'\0') {
 	wordunit_T *wu = first_token->next;
-	wordunitfree(first_token);
+	if (ps->arena == NULL)
+	    wordunitfree(first_token);
 	first_token = wu;
     }
 
@@ -2241,7 +2547,7 @@ redir_T *tryparse_redirect(parsestate_T *ps)
 	return NULL;
     }
 
-    redir_T *result = xmalloc(sizeof *result);
+    redir_T *result = ps_malloc(ps, sizeof *result);
     result->next = NULL;
     result->rd_fd = fd;
     switch (ps->tokentype) {
@@ -2307,13 +2613,13 @@ redir_T *tryparse_redirect(parsestate_T *ps)
 parse_here_document_tag:
     next_token(ps);
     validate_redir_operand(ps);
-    result->rd_hereend =
-	xwcsndup(&ps->src.contents[ps->index], ps->next_index - ps->index);
+    result->rd_hereend = ps_wcsndup(ps,
+	    &ps->src.contents[ps->index], ps->next_index - ps->index);
     result->rd_herecontent = NULL;
     if (ps->token == NULL) {
 	serror(ps, Ngt("the end-of-here-document indicator is missing"));
     } else {
-	pl_add(&ps->pending_heredocs, result);
+	pl_add(pl_add(&ps->pending_heredocs, result), ps->arena);
 	next_token(ps);
     }
     return result;
@@ -2435,9 +2741,10 @@ command_T *parse_group(parsestate_T *ps)
     else
 	print_errmsg_token_missing(ps, ends);
 
-    command_T *result = xmalloc(sizeof *result);
+    command_T *result = ps_malloc(ps, sizeof *result);
     result->next = NULL;
     result->refcount = 1;
+    result->c_arena = ps->arena;
     result->c_type = type;
     result->c_lineno = lineno;
     result->c_redirs = NULL;
@@ -2452,9 +2759,10 @@ command_T *parse_if(parsestate_T *ps)
     assert(ps->tokentype == TT_IF);
     next_token(ps);
 
-    command_T *result = xmalloc(sizeof *result);
+    command_T *result = ps_malloc(ps, sizeof *result);
     result->next = NULL;
     result->refcount = 1;
+    result->c_arena = ps->arena;
     result->c_type = CT_IF;
     result->c_lineno = ps->info->lineno;
     result->c_redirs = NULL;
@@ -2463,7 +2771,7 @@ command_T *parse_if(parsestate_T *ps)
     ifcommand_T **lastp = &result->c_ifcmds;
     bool after_else = false;
     while (!ps->error) {
-	ifcommand_T *ic = xmalloc(sizeof *ic);
+	ifcommand_T *ic = ps_malloc(ps, sizeof *ic);
 	*lastp = ic;
 	lastp = &ic->next;
 	ic->next = NULL;
@@ -2508,15 +2816,16 @@ command_T *parse_for(parsestate_T *ps)
     next_token(ps);
     psubstitute_alias_recursive(ps, 0);
 
-    command_T *result = xmalloc(sizeof *result);
+    command_T *result = ps_malloc(ps, sizeof *result);
     result->next = NULL;
     result->refcount = 1;
+    result->c_arena = ps->arena;
     result->c_type = CT_FOR;
     result->c_lineno = ps->info->lineno;
     result->c_redirs = NULL;
 
-    result->c_forname =
-	xwcsndup(&ps->src.contents[ps->index], ps->next_index - ps->index);
+    result->c_forname = ps_wcsndup(ps,
+	    &ps->src.contents[ps->index], ps->next_index - ps->index);
     if (!is_name_word(ps->token)) {
 	if (ps->token == NULL)
 	    serror(ps, Ngt("an identifier is required after `for'"));
@@ -2581,9 +2890,10 @@ command_T *parse_while(parsestate_T *ps)
     }
     next_token(ps);
 
-    command_T *result = xmalloc(sizeof *result);
+    command_T *result = ps_malloc(ps, sizeof *result);
     result->next = NULL;
     result->refcount = 1;
+    result->c_arena = ps->arena;
     result->c_type = CT_WHILE;
     result->c_lineno = ps->info->lineno;
     result->c_redirs = NULL;
@@ -2620,9 +2930,10 @@ command_T *parse_case(parsestate_T *ps)
     next_token(ps);
     psubstitute_alias_recursive(ps, 0);
 
-    command_T *result = xmalloc(sizeof *result);
+    command_T *result = ps_malloc(ps, sizeof *result);
     result->next = NULL;
     result->refcount = 1;
+    result->c_arena = ps->arena;
     result->c_type = CT_CASE;
     result->c_lineno = ps->info->lineno;
     result->c_redirs = NULL;
@@ -2665,11 +2976,17 @@ caseitem_T *parse_case_list(parsestate_T *ps)
 	if (psubstitute_alias(ps, 0))
 	    continue;
 
-	caseitem_T *ci = xmalloc(sizeof *ci);
+	caseitem_T *ci = ps_malloc(ps, sizeof *ci);
 	*lastp = ci;
 	lastp = &ci->next;
 	ci->next = NULL;
 	ci->ci_patterns = parse_case_patterns(ps);
+	size_t count = plcount(ci->ci_patterns);
+	ci->ci_xfnms = ps_malloc(ps, mul(count, sizeof *ci->ci_xfnms));
+	for (size_t i = 0; i < count; i++)
+	    ci->ci_xfnms[i] = NULL;
+	if (ps->arena != NULL)
+	    arena_add_cleanup(ps->arena, caseitemxfnmsfree, ci);
 	ci->ci_commands = parse_compound_list(ps);
 	/* `ci_commands' may be NULL unlike for and while commands */
 	if (ps->tokentype == TT_DOUBLE_SEMICOLON)
@@ -2728,7 +3045,7 @@ void **parse_case_patterns(parsestate_T *ps)
 	psubstitute_alias_recursive(ps, 0);
     } while (!ps->error);
 
-    return pl_toary(&wordlist);
+    return ps_toary(ps, &wordlist);
 }
 
 #if YASH_ENABLE_DOUBLE_BRACKET
@@ -2747,9 +3064,10 @@ command_T *parse_double_bracket(parsestate_T *ps)
     next_token(ps);
     psubstitute_alias_recursive(ps, 0);
 
-    command_T *result = xmalloc(sizeof *result);
+    command_T *result = ps_malloc(ps, sizeof *result);
     result->next = NULL;
     result->refcount = 1;
+    result->c_arena = ps->arena;
     result->c_type = CT_BRACKET;
     result->c_lineno = ps->info->lineno;
     result->c_redirs = NULL;
@@ -2780,7 +3098,7 @@ dbexp_T *parse_double_bracket_ors(parsestate_T *ps)
     next_token(ps);
     psubstitute_alias_recursive(ps, 0);
 
-    dbexp_T *result = xmalloc(sizeof *result);
+    dbexp_T *result = ps_malloc(ps, sizeof *result);
     result->type = DBE_OR;
     result->operator = NULL;
     result->lhs.subexp = lhs;
@@ -2798,7 +3116,7 @@ dbexp_T *parse_double_bracket_ands(parsestate_T *ps)
     next_token(ps);
     psubstitute_alias_recursive(ps, 0);
 
-    dbexp_T *result = xmalloc(sizeof *result);
+    dbexp_T *result = ps_malloc(ps, sizeof *result);
     result->type = DBE_AND;
     result->operator = NULL;
     result->lhs.subexp = lhs;
@@ -2815,7 +3133,7 @@ dbexp_T *parse_double_bracket_nots(parsestate_T *ps)
     next_token(ps);
     psubstitute_alias_recursive(ps, 0);
 
-    dbexp_T *result = xmalloc(sizeof *result);
+    dbexp_T *result = ps_malloc(ps, sizeof *result);
     result->type = DBE_NOT;
     result->operator = NULL;
     result->lhs.subexp = NULL;
@@ -2866,7 +3184,8 @@ dbexp_T *parse_double_bracket_primary(parsestate_T *ps)
 
     if (ps->tokentype == TT_LESS || ps->tokentype == TT_GREATER) {
 	type = DBE_BINARY;
-	op = xwcsndup(&ps->src.contents[ps->index], ps->next_index - ps->index);
+	op = ps_wcsndup(ps,
+		&ps->src.contents[ps->index], ps->next_index - ps->index);
     } else if (is_single_string_word(ps->token) &&
 	    is_binary_primary(ps->token->wu_string)) {
 	type = DBE_BINARY;
@@ -2889,7 +3208,7 @@ parse_primary_operator:
 	rhs = parse_double_bracket_operand(ps);
 
 return_result:;
-    dbexp_T *result = xmalloc(sizeof *result);
+    dbexp_T *result = ps_malloc(ps, sizeof *result);
     result->type = type;
     result->operator = op;
     result->lhs.word = lhs;
@@ -3025,7 +3344,7 @@ end:;
     MAKE_WORDUNIT_STRING;
     ps->next_index = ps->index;
     ps->index = grandstartindex;
-    wordfree(ps->token), ps->token = token;
+    ps_wordfree(ps, ps->token), ps->token = token;
     ps->tokentype = TT_WORD;
     return parse_double_bracket_operand(ps);
 }
@@ -3043,9 +3362,10 @@ command_T *parse_function(parsestate_T *ps)
     next_token(ps);
     psubstitute_alias_recursive(ps, 0);
 
-    command_T *result = xmalloc(sizeof *result);
+    command_T *result = ps_malloc(ps, sizeof *result);
     result->next = NULL;
     result->refcount = 1;
+    result->c_arena = ps->arena;
     result->c_type = CT_FUNCDEF;
     result->c_lineno = ps->info->lineno;
     result->c_redirs = NULL;
@@ -3075,7 +3395,7 @@ parse_close_parenthesis:
 parse_function_body:
     parse_newline_list(ps);
 
-    result->c_funcbody = parse_compound_command(ps);
+    result->c_funcbody = parse_funcbody(ps);
     if (result->c_funcbody == NULL) {
 	if (psubstitute_alias(ps, 0)) {
 	    if (paren)
@@ -3127,13 +3447,14 @@ command_T *try_reparse_as_function(parsestate_T *ps, command_T *c)
     }
     next_token(ps);
 
-    free(c->c_words);
+    if (ps->arena == NULL)
+	free(c->c_words);
     c->c_type = CT_FUNCDEF;
     c->c_funcname = name;
 
 parse_function_body:
     parse_newline_list(ps);
-    c->c_funcbody = parse_compound_command(ps);
+    c->c_funcbody = parse_funcbody(ps);
     if (c->c_funcbody == NULL) {
 	if (psubstitute_alias(ps, 0))
 	    goto parse_function_body;
@@ -3143,6 +3464,24 @@ parse_function_body:
     return c;
 }
 
+/* Parses the compound command that is the body of a function definition.
+ * If the parse tree is in an arena, the body is allocated in a new arena of its
+ * own so that the function, which keeps the body after the definition has been
+ * executed, does not keep the rest of the enclosing command. The new arena is
+ * freed with the enclosing one unless the body has been duplicated. */
+command_T *parse_funcbody(parsestate_T *ps)
+{
+    parsearena_T *outer = ps->arena;
+    if (outer == NULL)
+	return parse_compound_command(ps);
+
+    ps->arena = new_parsearena();
+    arena_add_cleanup(outer, parsearenafree_vp, ps->arena);
+    command_T *result = parse_compound_command(ps);
+    ps->arena = outer;
+    return result;
+}
+
 /***** Here-document contents *****/
 
 /* Reads the contents of a here-document. */
@@ -3195,10 +3534,10 @@ void read_heredoc_contents_without_expansion(parsestate_T *ps, redir_T *r)
     }
     free(eoc);
     
-    wordunit_T *wu = xmalloc(sizeof *wu);
+    wordunit_T *wu = ps_malloc(ps, sizeof *wu);
     wu->next = NULL;
     wu->wu_type = WT_STRING;
-    wu->wu_string = escape(buf.contents, L"\\");
+    wu->wu_string = ps_wcsown(ps, escape(buf.contents, L"\\"));
     r->rd_herecontent = wu;
 
     wb_destroy(&buf);
@@ -3262,7 +3601,7 @@ bool is_end_of_heredoc_contents(
 /* Prints an error message for each pending here-document. */
 void reject_pending_heredocs(parsestate_T *ps)
 {
-    for (size_t i = 0; i < ps->pending_heredocs.length; i++) {
+    for (size_t i = 0; i < ps->pending_heredocs.length; i += 2) {
 	const redir_T *r = ps->pending_heredocs.contents[i];
 	const char *operator;
 	switch (r->rd_type) {
@@ -33,10 +33,19 @@
 /* Basically, parse tree structure elements constitute linked lists.
  * For each element, the `next' member points to the next element. */
 
+/* A parse tree returned from `read_and_parse' is allocated in an arena, which
+ * is freed at once when the tree is no longer used. The `ao_arena' and
+ * `c_arena' members point to the arena containing the node, or are NULL if the
+ * node is allocated individually by `malloc'. The body of a function definition
+ * is in a separate arena so that the function can be kept without the rest of
+ * the tree. */
+typedef struct parsearena_T parsearena_T;
+
 /* and/or list */
 typedef struct and_or_T {
     struct and_or_T   *next;
     struct pipeline_T *ao_pipelines;  /* pipelines in this and/or list */
+    parsearena_T      *ao_arena;
     _Bool              ao_async;
 } and_or_T;
 /* ao_async: indicates this and/or list is postfixed by "&", which means the
@@ -72,6 +81,7 @@ typedef enum {
 typedef struct command_T {
     struct command_T *next;
     refcount_T        refcount;
+    parsearena_T     *c_arena;
     commandtype_T     c_type;
     unsigned long     c_lineno;   /* line number */
     struct redir_T   *c_redirs;   /* redirections */
@@ -118,7 +128,9 @@ typedef struct command_T {
 #define c_dbexp    c_content.dbexp
 #define c_funcname c_content.funcdef.funcname
 #define c_funcbody c_content.funcdef.funcbody
-/* `c_words' and `c_forwords' are NULL-terminated arrays of pointers to
+/* `refcount' is not used if `c_arena' is non-NULL, in which case the arena is
+ * reference-counted instead.
+ * `c_words' and `c_forwords' are NULL-terminated arrays of pointers to
  * `wordunit_T' that are cast to `void *'.
  * If `c_forwords' is NULL, the for loop doesn't have the "in" clause.
  * If `c_forwords[0]' is NULL, the "in" clause exists and is empty. */
@@ -133,12 +145,16 @@ typedef struct ifcommand_T {
 
 /* patterns and commands of a case command */
 typedef struct caseitem_T {
-    struct caseitem_T *next;
-    void             **ci_patterns;  /* patterns to do matching */
-    struct and_or_T   *ci_commands;  /* commands executed if match succeeds */
+    struct caseitem_T  *next;
+    void              **ci_patterns;  /* patterns to do matching */
+    struct xfnmatch_T **ci_xfnms;     /* compiled patterns */
+    struct and_or_T    *ci_commands;  /* commands executed if match succeeds */
 } caseitem_T;
 /* `ci_patterns' is a NULL-terminated array of pointers to `wordunit_T' that are
- * cast to `void *'. */
+ * cast to `void *'.
+ * `ci_xfnms' is an array of the same length as `ci_patterns'. Each element is
+ * initially NULL and caches the compiled form of the corresponding pattern if
+ * the pattern contains no expansion whose result may vary. */
 
 /* type of dbexp_T */
 typedef enum {
@@ -190,15 +206,22 @@ typedef struct wordunit_T {
 	wchar_t           *string;  /* string (including quotes) */
 	struct paramexp_T *param;   /* parameter expansion */
 	struct embedcmd_T  cmdsub;  /* command substitution */
-	struct wordunit_T *arith;   /* expression for arithmetic expansion */
+	struct {
+	    struct wordunit_T  *expr;  /* expression for arithmetic expansion */
+	    struct arithcode_T *code;  /* compiled expression */
+	} arith;
     } wu_value;
 } wordunit_T;
-#define wu_string wu_value.string
-#define wu_param  wu_value.param
-#define wu_cmdsub wu_value.cmdsub
-#define wu_arith  wu_value.arith
+#define wu_string    wu_value.string
+#define wu_param     wu_value.param
+#define wu_cmdsub    wu_value.cmdsub
+#define wu_arith     wu_value.arith.expr
+#define wu_arithcode wu_value.arith.code
 /* In arithmetic expansion, the expression is subject to parameter expansion
- * before it is parsed. So `wu_arith' is of type `wordunit_T *'. */
+ * before it is parsed. So `wu_arith' is of type `wordunit_T *'.
+ * If the expression is a literal string that needs no expansion, it is
+ * compiled when parsed and `wu_arithcode' is the result. Otherwise,
+ * `wu_arithcode' is NULL. */
 
 /* type of paramexp_T */
 typedef enum {
@@ -247,6 +270,7 @@ typedef struct paramexp_T {
 	struct wordunit_T *nest;
     } pe_value;
     struct wordunit_T *pe_start, *pe_end;
+    struct arithcode_T *pe_startcode, *pe_endcode;
     struct wordunit_T *pe_match, *pe_subst;
 } paramexp_T;
 #define pe_name pe_value.name
@@ -258,6 +282,8 @@ typedef struct paramexp_T {
  * pe_match: word to be matched with the value of the parameter
  * pe_subst: word to to substitute the matched string with
  * `pe_start' and `pe_end' is NULL if the indices are not specified.
+ * `pe_startcode' and `pe_endcode' are the compiled forms of `pe_start' and
+ * `pe_end' like `wu_arithcode'.
  * `pe_match' and `pe_subst' may be NULL to denote an empty string. */
 
 /* type of assignment */
@@ -384,12 +410,17 @@ static inline command_T *comsdup(command_T *c);
 extern void comsfree(command_T *c);
 extern void wordfree(wordunit_T *w);
 extern void paramfree(paramexp_T *p);
+extern void parsearenadup(parsearena_T *a)
+    __attribute__((nonnull));
 
 
 /* Duplicates the specified command (virtually). */
 command_T *comsdup(command_T *c)
 {
-    refcount_increment(&c->refcount);
+    if (c->c_arena != NULL)
+	parsearenadup(c->c_arena);
+    else
+	refcount_increment(&c->refcount);
     return c;
 }
 
@@ -17,6 +17,11 @@
 
 
 #include "common.h"
+#if D_TYPE_NEEDS_DEFAULT_SOURCE
+/* Some C libraries declare the DT_* constants for the `d_type' member of the
+ * `dirent' structure only if _DEFAULT_SOURCE is defined. */
+# define _DEFAULT_SOURCE 1
+#endif
 #include "path.h"
 #include <assert.h>
 #include <ctype.h>
@@ -357,6 +362,8 @@ static inline void forget_command_path(const char *command)
     __attribute__((nonnull));
 static wchar_t *get_default_path(void)
     __attribute__((malloc,warn_unused_result));
+static char *search_path_index(const char *name)
+    __attribute__((nonnull,malloc,warn_unused_result));
 
 /* A hashtable from command names to their full path.
  * Keys are pointers to a multibyte string containing a command name and
@@ -385,7 +392,9 @@ void clear_cmdhash(void)
  * If `forcelookup' is false and the command is already entered in the command
  * hashtable, the value in the hashtable is returned. Otherwise, `which' is
  * called to search for the command, the result is entered into the hashtable,
- * and then it is returned. If no command is found, NULL is returned. */
+ * and then it is returned. If no command is found, NULL is returned.
+ * In an interactive shell, the command path index is searched instead of
+ * calling `which' unless `forcelookup' is true. */
 const char *get_command_path(const char *name, bool forcelookup)
 {
     const char *path;
@@ -396,7 +405,10 @@ const char *get_command_path(const char *name, bool forcelookup)
 	    return path;
     }
 
-    path = which(name, get_path_array(PA_PATH), is_executable_regular);
+    if (!forcelookup && is_interactive_now)
+	path = search_path_index(name);
+    else
+	path = which(name, get_path_array(PA_PATH), is_executable_regular);
     if (path != NULL) {
 	size_t namelen = strlen(name), pathlen = strlen(path);
 	const char *nameinpath = path + pathlen - namelen;
@@ -408,6 +420,16 @@ const char *get_command_path(const char *name, bool forcelookup)
     return path;
 }
 
+/* Like `get_command_path', but does not modify the command hashtable.
+ * The result is returned as a newly malloced string. */
+char *peek_command_path(const char *name)
+{
+    const char *path = ht_get(&cmdhash, name).value;
+    if (path != NULL && path[0] == '/' && is_executable_regular(path))
+	return xstrdup(path);
+    return which(name, get_path_array(PA_PATH), is_executable_regular);
+}
+
 /* Removes the specified command from the command hashtable. */
 void forget_command_path(const char *command)
 {
@@ -466,6 +488,231 @@ wchar_t *get_default_path(void)
 }
 
 
+/********** Command Path Index **********/
+
+/* The command path index remembers the names of the files in each directory
+ * of $PATH so that commands can be looked up and completed without reading or
+ * probing all the directories every time. The names are sorted by `strcmp',
+ * so names that start with a given prefix can be found by binary search.
+ * A directory is read again when its device number, i-node number, or
+ * modification time has changed. Since the modification time has a resolution
+ * of a second, a directory that was modified in the same second it was read
+ * is considered outdated, too. A directory that cannot be read has no names
+ * in the index and is always probed directly when looking up a command. */
+
+static void update_path_index(bool always);
+static void validate_pathdir(pathdir_T *dir, time_t now)
+    __attribute__((nonnull));
+static void read_pathdir(pathdir_T *dir)
+    __attribute__((nonnull));
+static bool is_pathdir_current(const pathdir_T *dir)
+    __attribute__((nonnull));
+static void free_pathdir(pathdir_T *dir)
+    __attribute__((nonnull));
+static int pathdir_namecmp(const void *v1, const void *v2)
+    __attribute__((nonnull,pure));
+
+/* The directories of the command path index in the order of $PATH. */
+static pathdir_T *pathindex = NULL;
+/* The number of elements in `pathindex'. */
+static size_t pathindex_count = 0;
+/* The time when the directories in `pathindex' were last validated. */
+static time_t pathindex_time = -1;
+
+/* Empties the command path index. */
+void clear_path_index(void)
+{
+    for (size_t i = 0; i < pathindex_count; i++) {
+	free_pathdir(&pathindex[i]);
+	free(pathindex[i].pd_path);
+    }
+    free(pathindex);
+    pathindex = NULL;
+    pathindex_count = 0;
+    pathindex_time = -1;
+}
+
+/* Returns the command path index for the current $PATH after making sure that
+ * every directory in the index is up-to-date. The number of the directories is
+ * assigned to `*countp'. The returned array is valid until the index is next
+ * updated or cleared. */
+const pathdir_T *get_path_index(size_t *countp)
+{
+    update_path_index(true);
+    *countp = pathindex_count;
+    return pathindex;
+}
+
+/* Makes the command path index contain the directories of the current $PATH.
+ * Directories that were already in the index are reused.
+ * If `always' is true, all the directories are validated. Otherwise, only
+ * absolute directories are validated, and only if they have not been validated
+ * in the current second. */
+void update_path_index(bool always)
+{
+    char *const *paths = get_path_array(PA_PATH);
+    size_t count = (paths == NULL) ? 0 : plcount((void *const *) paths);
+
+    bool same = (count == pathindex_count);
+    for (size_t i = 0; same && i < count; i++)
+	same = (strcmp(paths[i], pathindex[i].pd_path) == 0);
+    if (!same) {
+	pathdir_T *newindex = xmallocn(count, sizeof *newindex);
+	for (size_t i = 0; i < count; i++) {
+	    newindex[i] = (pathdir_T) {
+		.pd_path = NULL, .pd_names = NULL, .pd_readtime = -1, };
+	    for (size_t j = 0; j < pathindex_count; j++) {
+		if (pathindex[j].pd_path != NULL
+			&& strcmp(paths[i], pathindex[j].pd_path) == 0) {
+		    newindex[i] = pathindex[j];
+		    pathindex[j].pd_path = NULL;
+		    pathindex[j].pd_names = NULL;
+		    break;
+		}
+	    }
+	    if (newindex[i].pd_path == NULL)
+		newindex[i].pd_path = xstrdup(paths[i]);
+	}
+	clear_path_index();
+	pathindex = newindex;
+	pathindex_count = count;
+    }
+
+    time_t now = time(NULL);
+    if (!always && now == pathindex_time)
+	return;
+    pathindex_time = now;
+    for (size_t i = 0; i < pathindex_count; i++)
+	if (always || pathindex[i].pd_path[0] == '/')
+	    validate_pathdir(&pathindex[i], now);
+}
+
+/* Reads the specified directory again if it has been changed since it was last
+ * read. `now' is the current time. */
+void validate_pathdir(pathdir_T *dir, time_t now)
+{
+    struct stat st;
+    if (stat(dir->pd_path[0] != '\0' ? dir->pd_path : ".", &st) < 0) {
+	free_pathdir(dir);
+	return;
+    }
+    if (dir->pd_readtime >= 0
+	    && st.st_dev == dir->pd_dev && st.st_ino == dir->pd_ino
+	    && st.st_mtime == dir->pd_mtime && st.st_mtime < dir->pd_readtime)
+	return;
+
+    dir->pd_dev = st.st_dev;
+    dir->pd_ino = st.st_ino;
+    dir->pd_mtime = st.st_mtime;
+    read_pathdir(dir);
+    if (dir->pd_names != NULL)
+	dir->pd_readtime = now;
+}
+
+/* Reads the names of the files in the specified directory into `pd_names'.
+ * If the directory cannot be read or if interrupted, `pd_names' is left NULL.
+ */
+void read_pathdir(pathdir_T *dir)
+{
+    free_pathdir(dir);
+
+    DIR *d = opendir(dir->pd_path[0] != '\0' ? dir->pd_path : ".");
+    if (d == NULL)
+	return;
+
+    plist_T names;
+    pl_init(&names);
+
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+	if (is_interrupted()) {
+	    closedir(d);
+	    plfree(pl_toary(&names), free);
+	    return;
+	}
+	if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+	    continue;
+	pl_add(&names, xstrdup(de->d_name));
+    }
+    closedir(d);
+
+    qsort(names.contents, names.length, sizeof *names.contents,
+	    pathdir_namecmp);
+    dir->pd_count = names.length;
+    dir->pd_names = (char **) pl_toary(&names);
+}
+
+/* Frees the names in the specified directory, leaving the directory to be read
+ * again. The pathname of the directory is not freed. */
+void free_pathdir(pathdir_T *dir)
+{
+    plfree((void **) dir->pd_names, free);
+    dir->pd_names = NULL;
+    dir->pd_count = 0;
+    dir->pd_readtime = -1;
+}
+
+int pathdir_namecmp(const void *v1, const void *v2)
+{
+    return strcmp(*(const char *const *) v1, *(const char *const *) v2);
+}
+
+/* Returns the index of the first name in `dir->pd_names' that is not less
+ * than `prefix'. The names that start with `prefix', if any, are at the
+ * returned index and the following indices. */
+size_t pathdir_find_prefix(const pathdir_T *dir, const char *prefix)
+{
+    size_t lo = 0, hi = dir->pd_count;
+    while (lo < hi) {
+	size_t mid = lo + (hi - lo) / 2;
+	if (strcmp(dir->pd_names[mid], prefix) < 0)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return lo;
+}
+
+/* Checks if the names of the specified directory in the index are known to be
+ * the current contents of the directory. */
+bool is_pathdir_current(const pathdir_T *dir)
+{
+    if (dir->pd_names == NULL)
+	return false;
+
+    struct stat st;
+    return stat(dir->pd_path, &st) >= 0
+	&& st.st_dev == dir->pd_dev && st.st_ino == dir->pd_ino
+	&& st.st_mtime == dir->pd_mtime && st.st_mtime < dir->pd_readtime;
+}
+
+/* Searches $PATH for an executable regular file named `name' using the
+ * command path index and returns its full pathname as a newly malloced string.
+ * The result is the same as that of `which'. A directory is skipped without
+ * being probed only if the index is known to be current for the directory.
+ * Relative directories in $PATH, directories that cannot be read, and
+ * directories that have been modified since they were last read are probed
+ * directly. */
+char *search_path_index(const char *name)
+{
+    update_path_index(false);
+    for (size_t i = 0; i < pathindex_count; i++) {
+	const pathdir_T *dir = &pathindex[i];
+	if (dir->pd_path[0] == '/' && is_pathdir_current(dir)) {
+	    size_t j = pathdir_find_prefix(dir, name);
+	    if (j >= dir->pd_count || strcmp(dir->pd_names[j], name) != 0)
+		continue;
+	}
+
+	char *const dirs[] = { dir->pd_path, NULL, };
+	char *path = which(name, dirs, is_executable_regular);
+	if (path != NULL)
+	    return path;
+    }
+    return NULL;
+}
+
+
 /********** Home Directory Cache **********/
 
 static struct passwd *xgetpwnam(const char *name)
@@ -576,6 +823,10 @@ struct wglob_search {
     enum wglobflags_T flags;
     xstrbuf_T path;
     xwcsbuf_T wpath;
+#if HAVE_OPENAT
+    int dirfd;
+    size_t dirlen;
+#endif
     plist_T *results;
 };
 /* `pattern' is an array of pointers to struct wglob_pattern objects. Each
@@ -584,7 +835,16 @@ struct wglob_search {
  * `path' and `wpath' are intermediate pathnames, denoting the currently
  * searched directory. They are the multi-byte and wide string versions of the
  * same pathname. The multi-byte version is mainly used for calling OS APIs and
- * the wide version for producing the final results. */
+ * the wide version for producing the final results.
+ * `dirfd' is an open file descriptor for the directory whose pathname is the
+ * first `dirlen' bytes of `path', or AT_FDCWD if `dirlen' is zero. The rest of
+ * `path' is resolved relative to `dirfd' so that the kernel does not have to
+ * look up the whole pathname for each file in a deep directory. */
+
+/* Types of files that are known from directory entries without `stat' */
+enum wglob_filetype {
+    WGLOB_TYPE_UNKNOWN, WGLOB_TYPE_DIR, WGLOB_TYPE_LINK, WGLOB_TYPE_OTHER,
+};
 
 /* Data used in search for one level of directory */
 struct wglob_stack {
@@ -633,7 +893,8 @@ static void wglob_search_literal_each(
 	struct wglob_search *restrict s, const struct wglob_stack *restrict t)
     __attribute__((nonnull));
 static void wglob_add_result(
-	struct wglob_search *s, bool only_if_existing, bool markdir)
+	struct wglob_search *s, bool only_if_existing, bool markdir,
+	enum wglob_filetype type)
     __attribute__((nonnull));
 static void wglob_search_literal_uniq(
 	struct wglob_search *restrict s, struct wglob_stack *restrict t)
@@ -642,20 +903,35 @@ static bool wglob_scandir(
 	struct wglob_search *restrict s, const struct wglob_stack *restrict t)
     __attribute__((nonnull));
 static void wglob_scandir_entry(
-	const char *name, struct wglob_search *restrict s,
+	const char *name, enum wglob_filetype type,
+	struct wglob_search *restrict s,
 	const struct wglob_stack *restrict t, struct wglob_stack *restrict t2,
 	bool only_if_existing)
     __attribute__((nonnull));
+static bool wglob_append_wname(
+	struct wglob_search *s, const char *name, bool *appended)
+    __attribute__((nonnull));
 static bool wglob_should_recurse(
-	const char *restrict name, const char *restrict path,
+	const char *restrict name, enum wglob_filetype type,
+	const struct wglob_search *restrict s,
 	const struct wglob_pattern *restrict c, struct wglob_stack *restrict t,
 	size_t count)
     __attribute__((nonnull));
+static enum wglob_filetype wglob_dirent_type(const struct dirent *de)
+    __attribute__((nonnull,pure));
+static int wglob_stat(
+	const struct wglob_search *restrict s, struct stat *restrict st,
+	bool followlink)
+    __attribute__((nonnull));
+#if HAVE_OPENAT
+static const char *wglob_relpath(const struct wglob_search *s)
+    __attribute__((nonnull,pure));
+#endif
 static bool wglob_is_reentry(const struct wglob_stack *const t, size_t count)
     __attribute__((nonnull,pure));
 
-static int wglob_sortcmp(const void *v1, const void *v2)
-    __attribute__((pure,nonnull));
+static const wchar_t *wglob_sortkey(const void *p)
+    __attribute__((const,nonnull));
 
 /* A wide string version of `glob'.
  * Adds all pathnames that matches the specified pattern to the specified list.
@@ -689,6 +965,10 @@ bool wglob(const wchar_t *restrict pattern, enum wglobflags_T flags,
     s.flags = flags;
     sb_init(&s.path);
     wb_init(&s.wpath);
+#if HAVE_OPENAT
+    s.dirfd = AT_FDCWD;
+    s.dirlen = 0;
+#endif
     s.results = list;
 
     struct wglob_stack *t = wglob_stack_new(&s, NULL);
@@ -704,7 +984,7 @@ bool wglob(const wchar_t *restrict pattern, enum wglobflags_T flags,
 
     if (!(flags & WGLB_NOSORT)) {
 	size_t count = list->length - listbase;  /* # of resulting items */
-	qsort(list->contents + listbase, count, sizeof (void *), wglob_sortcmp);
+	sort_wcscoll(list->contents + listbase, count, wglob_sortkey);
     }
     return !is_interrupted();
 }
@@ -920,7 +1200,7 @@ void wglob_search_literal_each(
 	    free(t2);
 	} else {
 	    /* This is the last component. */
-	    wglob_add_result(s, true, false);
+	    wglob_add_result(s, true, false, WGLOB_TYPE_UNKNOWN);
 	}
 
 	sb_truncate(&s->path, savepathlen);
@@ -928,20 +1208,26 @@ void wglob_search_literal_each(
     }
 }
 
-/* Adds `s->path' to `s->results'. */
+/* Adds `s->path' to `s->results'.
+ * `type' is the type of the file if known from the directory entry, in which
+ * case `only_if_existing' should be false. */
 void wglob_add_result(
-	struct wglob_search *s, bool only_if_existing, bool markdir)
+	struct wglob_search *s, bool only_if_existing, bool markdir,
+	enum wglob_filetype type)
 {
-    if (!only_if_existing && !markdir) {
-	pl_add(s->results, xwcsdup(s->wpath.contents));
-	return;
+    bool isdir;
+    if (!only_if_existing && (!markdir || type == WGLOB_TYPE_OTHER)) {
+	isdir = false;
+    } else if (!only_if_existing && type == WGLOB_TYPE_DIR) {
+	isdir = true;
+    } else {
+	struct stat st;
+	bool existing = wglob_stat(s, &st, true) >= 0;
+	if (only_if_existing && !existing)
+	    return;
+	isdir = existing && S_ISDIR(st.st_mode);
     }
-
-    struct stat st;
-    bool existing = stat(s->path.contents, &st) >= 0;
-    if (only_if_existing && !existing)
-	return;
-    if (!markdir || !existing || !S_ISDIR(st.st_mode)) {
+    if (!markdir || !isdir) {
 	pl_add(s->results, xwcsdup(s->wpath.contents));
 	return;
     }
@@ -982,7 +1268,8 @@ void wglob_search_literal_uniq(
     for (const kvpair_T *n = names; n->key != NULL; n++) {
 	const struct wglob_pattern *c = n->value;
 	memset(t2->active_components, 0, s->pattern.length);
-	wglob_scandir_entry(c->value.literal.name, s, t, t2, true);
+	wglob_scandir_entry(
+		c->value.literal.name, WGLOB_TYPE_UNKNOWN, s, t, t2, true);
     }
 
     free(t2);
@@ -995,22 +1282,46 @@ void wglob_search_literal_uniq(
 bool wglob_scandir(
 	struct wglob_search *restrict s, const struct wglob_stack *restrict t)
 {
+#if HAVE_OPENAT
+    const char *relpath = wglob_relpath(s);
+    int fd = openat(s->dirfd, (relpath[0] == '\0') ? "." : relpath,
+	    O_RDONLY | O_DIRECTORY);
+    if (fd < 0)
+	return false;
+    DIR *dir = fdopendir(fd);
+    if (dir == NULL) {
+	xclose(fd);
+	return false;
+    }
+
+    int savedirfd = s->dirfd;
+    size_t savedirlen = s->dirlen;
+    s->dirfd = fd;
+    s->dirlen = s->path.length;
+#else
     DIR* dir = opendir((s->path.length == 0) ? "." : s->path.contents);
     if (dir == NULL)
 	return false;
+#endif
 
     struct wglob_stack *t2 = wglob_stack_new(s, t);
 
     /* An empty name, which is needed for empty literal components, must be
      * explicitly produced as it would never be returned from readdir. */
-    wglob_scandir_entry("", s, t, t2, true);
+    wglob_scandir_entry("", WGLOB_TYPE_UNKNOWN, s, t, t2, true);
 
     /* now try each directory entry */
     struct dirent *de;
     while ((de = readdir(dir)) != NULL) {
 	memset(t2->active_components, 0, s->pattern.length);
-	wglob_scandir_entry(de->d_name, s, t, t2, false);
+	wglob_scandir_entry(
+		de->d_name, wglob_dirent_type(de), s, t, t2, false);
     }
+
+#if HAVE_OPENAT
+    s->dirfd = savedirfd;
+    s->dirlen = savedirlen;
+#endif
     closedir(dir);
 
     free(t2);
@@ -1022,18 +1333,22 @@ bool wglob_scandir(
  * `t' is the stack frame for the current directory path and `t2' for the next
  * frame. `t2->prev' must be `t' and `t2->active_components' must have been
  * zeroed.
+ * `type' is the type of the file if known from the directory entry.
  * `only_if_existing' is passed to `wglob_add_result' and should be false iff
- * the `name' is known to be an existing file. */
+ * the `name' is known to be an existing file.
+ * The name is matched as a multibyte string. It is converted to a wide string
+ * only if it is added to the results or the search continues in it. */
 void wglob_scandir_entry(
-	const char *name, struct wglob_search *restrict s,
+	const char *name, enum wglob_filetype type,
+	struct wglob_search *restrict s,
 	const struct wglob_stack *restrict t, struct wglob_stack *restrict t2,
 	bool only_if_existing)
 {
     size_t savepathlen = s->path.length, savewpathlen = s->wpath.length;
+    bool appended = false;
+    bool active = false;
 
     sb_cat(&s->path, name);
-    if (wb_mbscat(&s->wpath, name) != NULL)
-	goto done; // skip on error
 
     /* add new active components to `t2' */
     for (size_t i = 0; i < s->pattern.length; i++) {
@@ -1045,35 +1360,49 @@ void wglob_scandir_entry(
 	    case WGLOB_LITERAL:
 		if (strcmp(c->value.literal.name, name) != 0)
 		    continue;
-		if (i + 1 < s->pattern.length) // has a next component?
+		if (i + 1 < s->pattern.length) { // has a next component?
 		    t2->active_components[i + 1] = 1;
-		else
-		    wglob_add_result(s, only_if_existing, false);
+		    active = true;
+		} else {
+		    if (!wglob_append_wname(s, name, &appended))
+			goto done; // skip on error
+		    wglob_add_result(s, only_if_existing, false, type);
+		}
 		break;
 	    case WGLOB_MATCH:
 		if (name[0] == '\0')
 		    continue;
 		if (xfnm_match(c->value.match.pattern, name) != 0)
 		    continue;
-		if (i + 1 < s->pattern.length) // has a next component?
+		if (i + 1 < s->pattern.length) { // has a next component?
 		    t2->active_components[i + 1] = 1;
-		else
-		    wglob_add_result(s, only_if_existing, s->flags & WGLB_MARK);
+		    active = true;
+		} else {
+		    if (!wglob_append_wname(s, name, &appended))
+			goto done; // skip on error
+		    wglob_add_result(s, only_if_existing,
+			    s->flags & WGLB_MARK, type);
+		}
 		break;
 	    case WGLOB_RECSEARCH:
 		assert(i + 1 < s->pattern.length);
 		if (name[0] == '\0')
 		    continue;
 		if (t2->active_components[i] == 0) {
-		    const char *path = s->path.contents;
 		    size_t count = t->active_components[i] - 1;
-		    if (wglob_should_recurse(name, path, c, t2, count))
+		    if (wglob_should_recurse(name, type, s, c, t2, count)) {
 			t2->active_components[i] = t->active_components[i] + 1;
+			active = true;
+		    }
 		}
 		break;
 	}
     }
 
+    /* No need to descend if no component is active in the subdirectory. */
+    if (!active || !wglob_append_wname(s, name, &appended))
+	goto done;
+
     sb_ccat(&s->path, '/');
     wb_wccat(&s->wpath, L'/');
 
@@ -1085,11 +1414,28 @@ done:
     wb_truncate(&s->wpath, savewpathlen);
 }
 
+/* Appends `name' to `s->wpath' unless `*appended' is true, in which case it
+ * has already been appended. Returns false if `name' cannot be converted to a
+ * wide string. */
+bool wglob_append_wname(
+	struct wglob_search *s, const char *name, bool *appended)
+{
+    if (*appended)
+	return true;
+    if (wb_mbscat(&s->wpath, name) != NULL)
+	return false;
+    *appended = true;
+    return true;
+}
+
 /* Decides if we should continue recursion on this component.
- * In this function, `t->st' is updated to the result of `stat'ing the `path'.
- */
+ * `name' is the last component of `s->path' and `type' is the type of the
+ * file if known from the directory entry.
+ * In this function, `t->st' is updated to the result of `stat'ing `s->path'
+ * unless the file is known not to be a directory. */
 bool wglob_should_recurse(
-	const char *restrict name, const char *restrict path,
+	const char *restrict name, enum wglob_filetype type,
+	const struct wglob_search *restrict s,
 	const struct wglob_pattern *restrict c, struct wglob_stack *restrict t,
 	size_t count)
 {
@@ -1101,9 +1447,19 @@ bool wglob_should_recurse(
 	    return false;
     }
 
-    int (*statfunc)(const char *path, struct stat *st) =
-	c->value.recsearch.followlink ? stat : lstat;
-    if (statfunc(path, &t->st) < 0)
+    switch (type) {
+	case WGLOB_TYPE_OTHER:
+	    return false;
+	case WGLOB_TYPE_LINK:
+	    if (!c->value.recsearch.followlink)
+		return false;
+	    break;
+	case WGLOB_TYPE_UNKNOWN:
+	case WGLOB_TYPE_DIR:
+	    break;
+    }
+
+    if (wglob_stat(s, &t->st, c->value.recsearch.followlink) < 0)
 	return false;
     if (!S_ISDIR(t->st.st_mode))
 	return false;
@@ -1124,9 +1480,57 @@ bool wglob_is_reentry(const struct wglob_stack *const t, size_t count)
     return false;
 }
 
-int wglob_sortcmp(const void *v1, const void *v2)
+/* Returns the type of the file of the specified directory entry. */
+enum wglob_filetype wglob_dirent_type(const struct dirent *de)
+{
+#if HAVE_D_TYPE
+    switch (de->d_type) {
+	case DT_UNKNOWN:  return WGLOB_TYPE_UNKNOWN;
+	case DT_DIR:      return WGLOB_TYPE_DIR;
+	case DT_LNK:      return WGLOB_TYPE_LINK;
+	default:          return WGLOB_TYPE_OTHER;
+    }
+#else
+    (void) de;
+    return WGLOB_TYPE_UNKNOWN;
+#endif
+}
+
+/* Calls `stat' for `s->path', or `lstat' if `followlink' is false. */
+int wglob_stat(
+	const struct wglob_search *restrict s, struct stat *restrict st,
+	bool followlink)
+{
+#if HAVE_OPENAT
+    return fstatat(s->dirfd, wglob_relpath(s), st,
+	    followlink ? 0 : AT_SYMLINK_NOFOLLOW);
+#else
+    return (followlink ? stat : lstat)(s->path.contents, st);
+#endif
+}
+
+#if HAVE_OPENAT
+
+/* Returns the part of `s->path' that is to be resolved relative to
+ * `s->dirfd'. Leading slashes of the part are skipped so that it is not taken
+ * as an absolute pathname. If `s->path' names the directory of `s->dirfd'
+ * itself, "." is returned. */
+const char *wglob_relpath(const struct wglob_search *s)
+{
+    if (s->dirlen == 0)
+	return s->path.contents;
+
+    const char *path = &s->path.contents[s->dirlen];
+    while (*path == '/')
+	path++;
+    return (*path != '\0') ? path : ".";
+}
+
+#endif /* HAVE_OPENAT */
+
+const wchar_t *wglob_sortkey(const void *p)
 {
-    return wcscoll(*(const wchar_t *const *) v1, *(const wchar_t *const *) v2);
+    return p;
 }
 
 
@@ -1543,7 +1947,7 @@ int pwd_builtin(int argc __attribute__((unused)), void **argv)
 	return Exit_FAILURE;
     }
 print:
-    if (printf("%s\n", mbspwd) < 0)
+    if (printf("%s\n", mbspwd) < 0 || !flush_stdout_if_unbuffered())
 	xerror(errno, Ngt("cannot print to the standard output"));
     free(mbspwd);
     return (yash_error_message_count == 0) ? Exit_SUCCESS : Exit_FAILURE;
@@ -1616,6 +2020,7 @@ int hash_builtin(int argc, void **argv)
 	if (remove) {
 	    if (xoptind == argc) {  // forget all
 		clear_cmdhash();
+		clear_path_index();
 	    } else {                // forget the specified
 		for (int i = xoptind; i < argc; i++) {
 		    char *cmd = malloc_wcstombs(ARGV(i));
@@ -74,11 +74,33 @@ extern void init_cmdhash(void);
 extern void clear_cmdhash(void);
 extern const char *get_command_path(const char *name, _Bool forcelookup)
     __attribute__((nonnull));
+extern char *peek_command_path(const char *name)
+    __attribute__((nonnull,malloc,warn_unused_result));
 extern void fill_cmdhash(const char *prefix, _Bool ignorecase);
 extern const char *get_command_path_default(const char *name)
     __attribute__((nonnull));
 
 
+/********** Command Path Index **********/
+
+/* A directory in the command path index. */
+typedef struct pathdir_T {
+    char *pd_path;       // directory pathname as it appears in $PATH
+    char **pd_names;     // names of the files in the directory, sorted
+    size_t pd_count;     // number of elements in `pd_names'
+    dev_t pd_dev;        // device number of the directory
+    ino_t pd_ino;        // i-node number of the directory
+    time_t pd_mtime;     // modification time of the directory
+    time_t pd_readtime;  // time when `pd_names' was read, or -1
+} pathdir_T;
+
+extern void clear_path_index(void);
+extern const pathdir_T *get_path_index(size_t *countp)
+    __attribute__((nonnull));
+extern size_t pathdir_find_prefix(const pathdir_T *dir, const char *prefix)
+    __attribute__((nonnull,pure));
+
+
 /********** Home Directory Cache **********/
 
 extern void init_homedirhash(void);
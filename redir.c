@@ -57,9 +57,13 @@
  * If `close' returns EINTR, tries again.
  * If `close' returns EBADF, it is considered successful and silently ignored.
  * If `close' returns an error other than EINTR/EBADF, an error message is
- * printed. */
+ * printed.
+ * Output pending in `stdout' is flushed before the standard output is closed.
+ */
 int xclose(int fd)
 {
+    if (fd == STDOUT_FILENO)
+	flush_stdout();
     while (close(fd) < 0) {
 	switch (errno) {
 	case EINTR:
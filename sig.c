@@ -87,6 +87,11 @@ static int xsigaction(int signum, const struct sigaction *restrict newaction,
 static void set_special_handler(int signum, void (*handler)(int signum));
 static void reset_special_handler(
 	int signum, void (*handler)(int signum), bool leave);
+#if HAVE_POSIX_SPAWN
+static void add_if_defaulted_on_exec(sigset_t *set, int signum)
+    __attribute__((nonnull));
+static bool is_ignored_on_exec(int signum);
+#endif
 static void sig_handler(int signum);
 static void handle_sigchld(void);
 static void set_trap(int signum, const wchar_t *command);
@@ -399,6 +404,62 @@ void reset_job_signals(void)
     }
 }
 
+#if HAVE_POSIX_SPAWN
+
+/* Computes the signal settings that an external command should inherit when
+ * it is started without forking the shell, that is, the settings
+ * `restore_signals(true)' would establish in a child process before exec.
+ * `*mask' is set to the signal mask for the command. `*defaults' is set to the
+ * set of signals that the shell currently ignores but the command should start
+ * with the default action. (Signals caught by a handler need not be included
+ * since exec resets them to the default anyway.)
+ * Returns false if the settings cannot be expressed this way because a signal
+ * the shell catches should be ignored in the command. */
+bool get_exec_signal_settings(
+	sigset_t *restrict mask, sigset_t *restrict defaults)
+{
+    *mask = official_sigmask;
+    sigemptyset(defaults);
+    if (job_handlers_set) {
+	add_if_defaulted_on_exec(defaults, SIGTTIN);
+	add_if_defaulted_on_exec(defaults, SIGTTOU);
+	add_if_defaulted_on_exec(defaults, SIGTSTP);
+    }
+    if (interactive_handlers_set) {
+	add_if_defaulted_on_exec(defaults, SIGTERM);
+	add_if_defaulted_on_exec(defaults, SIGQUIT);
+	if (is_ignored_on_exec(SIGINT))
+	    return false;
+#if YASH_ENABLE_LINEEDIT && defined(SIGWINCH)
+	if (is_ignored_on_exec(SIGWINCH))
+	    return false;
+#endif
+    }
+    if (main_handler_set)
+	if (is_ignored_on_exec(SIGCHLD))
+	    return false;
+    return true;
+}
+
+/* Adds signal `signum', which must have been ignored by
+ * `set_special_handler', to `set' if `reset_special_handler' would reset it to
+ * the default. */
+void add_if_defaulted_on_exec(sigset_t *set, int signum)
+{
+    if (!is_ignored_on_exec(signum))
+	sigaddset(set, signum);
+}
+
+/* Checks if `reset_special_handler' would set the handler of signal `signum'
+ * to "ignore". */
+bool is_ignored_on_exec(int signum)
+{
+    return !sigismember(&trapped_signals, signum)
+	&& sigismember(&officially_ignored_signals, signum);
+}
+
+#endif /* HAVE_POSIX_SPAWN */
+
 /* Calls `sigaction' and, if the signal is not in either of
  * `originally_defaulted_signals' and `originally_ignored_signals', adds it to
  * one of them. */
@@ -533,6 +594,7 @@ void ignore_sigtstp(void)
  * On error, an error message is printed to the standard error. */
 void stop_myself(void)
 {
+    flush_stdout();
     if (kill(0, SIGSTOP) < 0)
 	xerror(errno, Ngt("cannot send SIGSTOP signal"));
 }
@@ -588,6 +650,8 @@ int wait_for_sigchld(bool interruptible, bool return_on_trap)
 {
     int result = 0;
 
+    flush_stdout();
+
     sigset_t ss = accept_sigmask;
     sigdelset(&ss, SIGCHLD);
     if (interruptible)
@@ -638,6 +702,8 @@ enum wait_for_input_T wait_for_input(int fd, bool trap, int timeout)
 	return W_ERROR;
     }
 
+    flush_stdout();
+
     if (trap)
 	sigint_received = false;
 
@@ -1063,6 +1129,12 @@ void set_interrupted(void)
     sigint_received = true;
 }
 
+/* Clears the `sigint_received' flag. */
+void reset_interrupted(void)
+{
+    sigint_received = false;
+}
+
 #if YASH_ENABLE_LINEEDIT
 
 #ifdef SIGWINCH
@@ -1418,6 +1490,9 @@ main:
 	if (optind == argc)
 	    return insufficient_operands_error(1);
 
+	/* The signal may kill the shell itself. */
+	flush_stdout();
+
 	do {
 	    wchar_t *proc = ARGV(optind);
 	    if (proc[0] == L'%') {
@@ -19,6 +19,7 @@
 #ifndef YASH_SIG_H
 #define YASH_SIG_H
 
+#include <signal.h>
 #include <stddef.h>
 #include <sys/types.h>
 #include "xgetopt.h"
@@ -38,6 +39,11 @@ extern void init_signal(void);
 extern void set_signals(void);
 extern void restore_signals(_Bool leave);
 extern void reset_job_signals(void);
+#if HAVE_POSIX_SPAWN
+extern _Bool get_exec_signal_settings(
+	sigset_t *restrict mask, sigset_t *restrict defaults)
+    __attribute__((nonnull));
+#endif
 extern void set_interruptible_by_sigint(_Bool onoff);
 extern void ignore_sigquit_and_sigint(void);
 extern void ignore_sigtstp(void);
@@ -59,6 +65,7 @@ extern void phantomize_traps(void);
 extern _Bool is_interrupted(void);
 extern void set_laststatus_if_interrupted(void);
 extern void set_interrupted(void);
+extern void reset_interrupted(void);
 #if YASH_ENABLE_LINEEDIT
 extern void reset_sigwinch(void);
 #endif
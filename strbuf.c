@@ -21,6 +21,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <limits.h>
+#include <locale.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -437,6 +438,87 @@ char *wb_mbscat(xwcsbuf_T *restrict buf, const char *restrict s)
     return (char *) s;
 }
 
+/* Converts the first `n' bytes of multibyte string `s' into a wide string and
+ * appends it to buffer `buf'. Unlike `wb_mbscat', a null byte does not end the
+ * conversion but is converted to a null wide character.
+ * `*state' must be the shift state at the beginning of `s'. It is updated to
+ * the state at the end of the converted part.
+ * Returns NULL if all the `n' bytes are converted and appended successfully.
+ * Otherwise, returns a pointer to the first byte of the invalid or incomplete
+ * character that stopped the conversion; the characters before it have been
+ * appended. */
+/* ASCII characters are copied without calling `mbrtowc' if the encoding of the
+ * current locale is compatible with ASCII. */
+char *wb_mbsncat(xwcsbuf_T *restrict buf, const char *restrict s, size_t n,
+	mbstate_t *restrict state)
+{
+    const char *end = &s[n];
+    char *result = NULL;
+    bool ascii = is_ascii_compatible_encoding();
+
+    wb_ensuremax(buf, add(buf->length, n));
+
+    wchar_t *d = &buf->contents[buf->length];
+    while (s < end) {
+	if (ascii && mbsinit(state)) {
+	    while (s < end && (unsigned char) *s < 0x80)
+		*d++ = (unsigned char) *s++;
+	    if (s == end)
+		break;
+	}
+
+	mbstate_t savestate = *state;
+	size_t count = mbrtowc(d, s, end - s, state);
+	switch (count) {
+	    case (size_t) -2:
+		*state = savestate;
+		/* falls thru */
+	    case (size_t) -1:
+		result = (char *) s;
+		goto done;
+	    case 0:
+		count = (const char *) memchr(s, '\0', end - s) - s + 1;
+		break;
+	}
+	d++;
+	s += count;
+    }
+done:
+    buf->length = d - buf->contents;
+    *d = L'\0';
+    return result;
+}
+
+/* Checks if the encoding of the current locale is state-independent and every
+ * byte in the range of 0x01-0x7F represents the ASCII character of the same
+ * value. The result is cached for the last seen LC_CTYPE locale. */
+bool is_ascii_compatible_encoding(void)
+{
+    static char *lastlocale = NULL;
+    static bool lastresult;
+
+    const char *locale = setlocale(LC_CTYPE, NULL);
+    if (locale == NULL)
+	return false;
+    if (lastlocale != NULL && strcmp(lastlocale, locale) == 0)
+	return lastresult;
+
+    free(lastlocale);
+    lastlocale = xstrdup(locale);
+    lastresult = true;
+    for (int c = 0x01; c < 0x80; c++) {
+	char mb = (char) c;
+	wchar_t wc;
+	mbstate_t state;
+	memset(&state, 0, sizeof state);  // initial shift state
+	if (mbrtowc(&wc, &mb, 1, &state) != 1 || wc != (wchar_t) c) {
+	    lastresult = false;
+	    break;
+	}
+    }
+    return lastresult;
+}
+
 /* Appends the result of `vswprintf' to the specified buffer.
  * `format' and the following arguments must not be part of `buf->contents'.
  * Returns the number of appended characters if successful.
@@ -362,6 +362,33 @@ __IN__
 14 14 14
 __OUT__
 
+test_oE -e 0 'same expansion evaluated repeatedly'
+i=0 sum=0 a=(10 20 30)
+while [ $((i+=1)) -le 3 ]; do
+    sum=$((sum + i * ${a[i]}))
+    echoraw $i ${a[i,i]} $((i % 2 ? i : -i)) $sum
+done
+__IN__
+1 10 1 10
+2 20 -2 50
+3 30 3 140
+__OUT__
+
+test_oE -e 0 'conditional operator yielding variable'
+a=1 b=2
+echoraw $(((1 ? a : b) = 5)) $((0 ? a++ : b++)) $a $b
+__IN__
+5 2 5 3
+__OUT__
+
+test_Oe -e 2 'prefix ++ applied to number'
+eval 'echoraw $((++1))'
+__IN__
+eval: arithmetic: operator `++' requires a variable
+__ERR__
+#'
+#`
+
 test_Oe -e 2 'empty arithmetic expansion'
 eval '$(())'
 __IN__
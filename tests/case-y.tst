@@ -26,6 +26,34 @@ expanded 0
 expanded 1
 __ERR__
 
+test_oE 'executing same case command repeatedly'
+f() {
+    case $1 in
+	(a*|"b?"|\[c]) echo literal $1;;
+	(~/x) echo tilde $1;;
+	($p) echo variable $1;;
+	(*) echo none $1;;
+    esac
+}
+p=d HOME=/h
+f abc; f b?; f bx; f '[c]'; f /h/x; f d; f e
+p=e HOME=/i
+f abc; f /h/x; f /i/x; f d; f e
+__IN__
+literal abc
+literal b?
+none bx
+literal [c]
+tilde /h/x
+variable d
+none e
+literal abc
+none /h/x
+tilde /i/x
+none d
+variable e
+__OUT__
+
 # The behavior is unspecified in POSIX, but many existing shells seem to behave
 # this way (with the notable exception of ksh).
 test_OE -e 0 'exit status of case command (matched, empty)'
@@ -31,6 +31,20 @@ __IN__
 ab
 __OUT__
 
+test_oE 'long output spanning many reads'
+i=0 line=0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ
+while [ $i -lt 2000 ]; do
+    echo $line
+    i=$((i+1))
+done >out
+x=$(cat out; echo; echo)
+[ "$x" = "$(cat out)" ] && echo same
+printf '%s\n' "${#x}"
+__IN__
+same
+125999
+__OUT__
+
 test_Oe -e 2 'unclosed command substitution $()'
 echo $(echo not reached
 __IN__
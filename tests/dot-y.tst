@@ -67,6 +67,86 @@ __IN__
 
 )
 
+test_oE 'dot script executed repeatedly'
+cat >repeat <<\END
+count=$((count+1))
+f() { echo "f $count $LINENO"; }
+END
+. -A ./repeat
+. -A ./repeat
+f
+. -A ./repeat
+f
+__IN__
+f 2 2
+f 3 2
+__OUT__
+
+test_oE 'dot script modified between executions'
+echo 'echo first' >modified
+. -A ./modified
+echo 'echo second; echo more' >modified
+. -A ./modified
+__IN__
+first
+second
+more
+__OUT__
+
+test_oE 'return in dot script executed repeatedly'
+printf '%s\n' 'echo in' 'return 3' 'echo out' >return
+. -A ./return
+echo $?
+. -A ./return
+echo $?
+__IN__
+in
+3
+in
+3
+__OUT__
+
+test_oE 'dot script changing POSIXly-correct mode executed repeatedly'
+cat >mode <<\END
+if [ "${count-}" ]; then set -o posix; fi
+count=$((count+1))
+echo "$LINENO ${a/b/c}"
+set +o posix
+END
+a=abc
+. -A ./mode
+(. -A ./mode) 2>/dev/null || echo syntax error
+echo "$count"
+unset count
+cat >mode <<\END
+if [ "${count-}" ]; then set -o posix; fi
+count=$((count+1))
+echo "$LINENO"
+set +o posix
+END
+. -A ./mode
+. -A ./mode
+echo "$count"
+__IN__
+3 acc
+syntax error
+1
+3
+3
+2
+__OUT__
+
+test_oE -e 0 'exit status of empty dot script executed repeatedly'
+: >empty
+false
+. -A ./empty
+echo $?
+false
+. -A ./empty
+__IN__
+0
+__OUT__
+
 (
 # Ensure $PWD is safe to assign to $PATH/$YASH_LOADPATH
 case $PWD in (*[:%]*)
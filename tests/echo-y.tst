@@ -207,4 +207,61 @@ test_O -d -e n 'echoing to closed stream'
 echo >&-
 __IN__
 
+test_oe 'write error on pipe is reported by the built-in that caused it'
+mkfifo fifo
+exec 3>&1 4>&2
+trap '' PIPE
+{
+    read -r x <fifo
+    echo a
+    echo "echo $?" >&3
+    i=0
+    while echo b && [ "$((i+=1))" -lt 10 ]; do echo loop >&3; done
+    echo "while $?" >&3
+} 2>&4 | { exec <&-; echo >fifo; }
+__IN__
+echo 1
+while 0
+__OUT__
+echo: cannot print to the standard output: Broken pipe
+echo: cannot print to the standard output: Broken pipe
+__ERR__
+
+test_oe 'write error on read-only regular file is reported by echo'
+echo x >file
+echo a
+echo b 1<file
+echo "$?"
+__IN__
+a
+1
+__OUT__
+echo: cannot print to the standard output: Bad file descriptor
+__ERR__
+
+test_oE 'write error on buffered regular file is reported when flushed'
+(
+trap '' XFSZ
+ulimit -f 1
+{ printf '%01000d\n' 0; } >file
+) 2>err
+if [ -s err ]; then echo reported; fi
+__IN__
+reported
+__OUT__
+
+test_oE 'output to file is written while shell is busy'
+"$TESTEE" -c 'echo $$ >pid; echo started; while :; do :; done' >out &
+i=0
+until [ -s out ] || [ "$i" -ge 100 ]; do
+    sleep 0.1
+    i=$((i+1))
+done
+kill "$(cat pid)"
+wait $!
+cat out
+__IN__
+started
+__OUT__
+
 # vim: set ft=sh ts=8 sts=4 sw=4 noet:
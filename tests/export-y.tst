@@ -53,6 +53,22 @@ __IN__
 A
 __OUT__
 
+test_oE 'exported variable changed many times before command'
+export a=0
+i=0
+while [ "$i" -lt 100 ]; do a=$i i=$((i+1)); done
+sh -c 'echo $a'
+a=temporary sh -c 'echo $a'
+sh -c 'echo $a'
+unset a
+sh -c 'echo ${a-unset}'
+__IN__
+99
+temporary
+99
+unset
+__OUT__
+
 test_O -d -e 1 'assigning to ill-named variable'
 export =A
 __IN__
@@ -126,6 +126,35 @@ initial
 redefined
 __OUT__
 
+test_oE 'function unset while running, defined with other commands'
+a() { unset -f a; echo in a; b; echo still in a; }; b() { echo in b; }
+a
+b
+a 2>/dev/null || echo a gone
+__IN__
+in a
+in b
+still in a
+in b
+a gone
+__OUT__
+
+test_oE 'function defined in compound command outlives the command'
+if true; then
+    f() { cat <<END; case $1 in (a*) echo matched; esac; }
+[$1] $(echo "$(( $2 + 1 ))")
+END
+    g() { f "$@"; }
+fi
+f abc 1
+unset -f g
+f xyz 2
+__IN__
+[abc] 2
+matched
+[xyz] 3
+__OUT__
+
 test_o 'effect of redefining read-only function'
 func() { echo foo; }
 readonly -f func
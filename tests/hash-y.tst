@@ -45,6 +45,21 @@ Running b/command1
 Running b/command1
 __OUT__
 
+export TEST_NO="$LINENO"
+test_oE 'commands in pipeline are not remembered in parent shell'
+mkdir a b
+PATH=$PWD/a:$PWD/b:$PATH
+make_command b/command1 b/command2
+command1 | command2
+echo ---
+make_command a/command1 a/command2
+command1 | command2
+__IN__
+Running b/command2
+---
+Running a/command2
+__OUT__
+
 export TEST_NO="$LINENO"
 test_oE 're-remembering command path'
 mkdir a b c
@@ -180,6 +195,79 @@ hash sh
 hash
 __IN__
 
+export TEST_NO="$LINENO"
+test_o 'searching for commands in interactive shell' -i +m
+mkdir a b
+PATH=$PWD/a:$PWD/b:$PATH
+make_command b/command1
+command1
+hash -r
+make_command a/command1 a/command2
+command1
+command2
+hash -r
+rm a/command1
+command1
+__IN__
+Running b/command1
+Running a/command1
+Running a/command2
+Running b/command1
+__OUT__
+
+export TEST_NO="$LINENO"
+test_o 'searching relative directory in interactive shell' -i +m
+mkdir a b
+PATH=.:$PATH
+make_command a/command1 b/command1
+cd a
+command1
+cd ../b
+command1
+__IN__
+Running a/command1
+Running b/command1
+__OUT__
+
+export TEST_NO="$LINENO"
+test_o 'command added just after lookup in interactive shell' -i +m
+mkdir a b
+PATH=$PWD/a:$PWD/b:$PATH
+make_command b/command1 b/command2
+sleep 1 # let the directories be read after they were last modified
+command1
+make_command a/command2
+command2
+__IN__
+Running b/command1
+Running a/command2
+__OUT__
+
+(
+mkdir -m 711 unreadable &&
+echo echo Running unreadable/command1 >unreadable/command1 &&
+chmod a+x unreadable/command1 &&
+chmod 111 unreadable
+
+# Skip if we're root.
+if ls unreadable >/dev/null 2>&1; then
+    skip="true"
+fi
+
+export TEST_NO="$LINENO"
+test_o 'command in unreadable directory in interactive shell' -i +m
+mkdir a
+PATH=${PWD%/*}/unreadable:$PWD/a:$PATH
+make_command a/command1
+command1
+__IN__
+Running unreadable/command1
+__OUT__
+
+)
+
+chmod 755 unreadable
+
 )
 
 test_OE -e 0 'assignment to $PATH removes all remembered command paths'
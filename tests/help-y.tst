@@ -532,7 +532,8 @@ __IN__
 history: manage command history
 
 Syntax:
-	history [-cF] [-d entry] [-s command] [-r file] [-w file] [count]
+	history [-cF] [-d entry] [-f format] [-s command] [-r file] \
+	        [-w file] [count]
 
 Options:
 	-c       --clear
@@ -540,6 +541,7 @@ Options:
 	-r ...   --read=...
 	-s ...   --set=...
 	-w ...   --write=...
+	-f ...   --file-format=...
 	-F       --flush-file
 	         --help
 
@@ -694,10 +696,11 @@ __IN__
 read: read a line from the standard input
 
 Syntax:
-	read [-Aer] [-P|-p] variable...
+	read [-Aber] [-P|-p] variable...
 
 Options:
 	-A       --array
+	-b       --buffered
 	-e       --line-editing
 	-P       --ps1
 	-p ...   --prompt=...
@@ -708,6 +711,23 @@ Try `man yash' for details.
 __OUT__
 #`
 
+test_oE -e 0 'help of readarray'
+help readarray
+__IN__
+readarray: read lines from the standard input into an array
+
+Syntax:
+	readarray [-b] [-n count] array
+
+Options:
+	-b       --buffered
+	-n ...   --count=...
+	         --help
+
+Try `man yash' for details.
+__OUT__
+#`
+
 test_oE -e 0 'help of readonly'
 help readonly
 __IN__
@@ -176,6 +176,89 @@ __IN__
 
 )
 
+(
+export histfile=histfile$LINENO histsize=100
+
+# Prepare the first history entry w/o running a test case.
+testee -is +m --rcfile="rcfile1" >/dev/null <<\__END__
+echo foo 1
+echo foo 2
+echo foo 3
+echo foo 4
+echo foo 5
+echo foo 6
+echo foo 7
+__END__
+
+test_oE -e 0 'looking up entries after deletion' -i +m --rcfile="rcfile1"
+history -d 2; history -d 4; history -d 5
+fc -l 2 4
+fc -l 4 6
+fc -l -2 -3
+__IN__
+3	echo foo 3
+6	echo foo 6
+10	fc -l 4 6
+9	fc -l 2 4
+__OUT__
+
+test_Oe -e 1 'looking up empty range between entries' -i +m --rcfile="rcfile1"
+history -d 4; history -d 5
+fc -l 4 5
+__IN__
+fc: no such history entry `4'
+__ERR__
+#`
+
+)
+
+(
+export histfile=histfile$LINENO histsize=100
+
+# Prepare the first history entry w/o running a test case.
+testee -is +m --rcfile="rcfile1" >/dev/null <<\__END__
+echo foo 1
+echo foo 2
+history -f binary
+echo foo 3
+history -d 2
+__END__
+
+test_oE -e 0 'converting history file into binary format (-f)' \
+    -i +m --rcfile="rcfile1"
+head -n 1 "$histfile" | cut -c 1-21
+history
+__IN__
+#$# yash history v1 r
+1	echo foo 1
+2	history -f binary
+3	echo foo 3
+4	history -d 2
+5	head -n 1 "$histfile" | cut -c 1-21
+6	history
+__OUT__
+
+test_oE -e 0 'converting history file into text format (--file-format)' \
+    -i +m --rcfile="rcfile1"
+history --file-format=text
+head -n 1 "$histfile" | cut -c 1-21
+history 3
+__IN__
+#$# yash history v0 r
+7	history --file-format=text
+8	head -n 1 "$histfile" | cut -c 1-21
+9	history 3
+__OUT__
+
+test_Oe -e 2 'invalid history file format (-f)' -i +m --rcfile="rcfile1"
+history -f foo
+__IN__
+history: `foo' is not a valid history file format
+__ERR__
+#`
+
+)
+
 (
 export in=./in$LINENO
 
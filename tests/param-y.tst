@@ -475,6 +475,30 @@ __IN__
 __OUT__
 # XXX: Should the last one (${a/*/"$b"}) expand to 1*2?3 rather than 1_2_3?
 
+test_oE 'matching bracket expressions in prefix, suffix and substitution'
+a='ab1cd2ef3gh'
+bracket "${a#*[0-9]}" "${a##*[0-9]}" "${a%[0-9]*}" "${a%%[0-9]*}"
+bracket "${a/[0-9]*[0-9]/x}" "${a/[0-9][!0-9]/x}" "${a/%[0-9][a-z]*/x}"
+bracket "${a//[0-9]?/x}" "${a//[!a-z]}"
+__IN__
+[cd2ef3gh][gh][ab1cd2ef][ab]
+[abxgh][abxd2ef3gh][abx]
+[abxdxfxh][abcdefgh]
+__OUT__
+
+test_oE 'matching very long pattern'
+p='a?' i=0
+while [ "$i" -lt 21 ]; do p=$p$p i=$((i+1)); done
+a=abc
+bracket "${a#$p}" "${a##$p}" "${a%$p}" "${a%%$p}"
+bracket "${a/$p/x}" "${a//$p/x}"
+case $a in ($p) echo matched;; (*) echo not matched;; esac
+__IN__
+[abc][abc][abc][abc]
+[abc][abc]
+not matched
+__OUT__
+
 test_oE 'scalar parameter index'
 a='1-2-3'
 bracket @ "${a[@]}"
@@ -67,6 +67,23 @@ __OUT__
 
 )
 
+(
+mkdir markdirs2
+cd markdirs2
+>regular
+mkdir directory
+ln -s directory dirlink
+ln -s regular reglink
+ln -s nonexistent dangling
+)
+
+test_oE 'markdirs on: symbolic links' --markdirs
+cd markdirs2
+echo *
+__IN__
+dangling directory/ dirlink/ reglink regular
+__OUT__
+
 (
 mkdir extendedglob
 cd extendedglob
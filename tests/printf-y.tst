@@ -493,6 +493,39 @@ __IN__
 1%2
 __OUT__
 
+test_oE 'same formats used repeatedly'
+for i in 1 2 3; do
+    printf '%d:%x:%s:%b\n' $i $((i*11)) "s$i" "b$i\\t"
+done
+printf '%d:%x:%s:%b\n' -5 0 '' ''
+__IN__
+1:b:s1:b1	
+2:16:s2:b2	
+3:21:s3:b3	
+-5:0::
+__OUT__
+
+test_oE 'many different formats'
+i=0
+while [ $i -lt 40 ]; do
+    printf "$((i%20))-%d " $i
+    i=$((i+1))
+done
+echo
+__IN__
+0-0 1-1 2-2 3-3 4-4 5-5 6-6 7-7 8-8 9-9 10-10 11-11 12-12 13-13 14-14 15-15 16-16 17-17 18-18 19-19 0-20 1-21 2-22 3-23 4-24 5-25 6-26 7-27 8-28 9-29 10-30 11-31 12-32 13-33 14-34 15-35 16-36 17-37 18-38 19-39 
+__OUT__
+
+test_oE 'invalid format is rejected each time'
+printf '%y\n' 2>/dev/null
+echo $?
+printf '%y\n' 2>/dev/null
+echo $?
+__IN__
+1
+1
+__OUT__
+
 test_o -d -e n 'operands in invalid format'
 printf '%d\n' not_a_integer 32_trailing_characters
 __IN__
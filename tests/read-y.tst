@@ -202,6 +202,67 @@ __IN__
 read: the -P option cannot be used with the -p option
 __ERR__
 
+test_oE 'buffered reading from pipe'
+printf '%s\n' 1 2 3 | {
+while read -b a; do echo "[$a]"; done
+}
+__IN__
+[1]
+[2]
+[3]
+__OUT__
+
+test_oE 'buffered input is kept during redirection'
+printf '%s\n' 1 2 3 >file
+printf '%s\n' a b c | {
+read -b a
+read -b b <file
+read -b c
+read -b d <file
+echo "[$a] [$b] [$c] [$d]"
+}
+__IN__
+[a] [1] [b] [1]
+__OUT__
+
+test_oE 'buffered reading from another pipe during redirection'
+printf '%s\n' a b c | {
+read -b a
+read -b b <<END
+1
+2
+END
+read -b c
+echo "[$a] [$b] [$c]"
+}
+__IN__
+[a] [1] [b]
+__OUT__
+
+test_oE 'buffered input is not inherited by subshell'
+printf '%s\n' 1 2 3 | {
+read -b a
+(read -b b; echo "$? [$b]")
+read -b c
+echo "[$a] [$c]"
+}
+__IN__
+1 []
+[1] [2]
+__OUT__
+
+test_oE 'buffered reading from regular file'
+printf '%s\n' 1 2 3 >file
+{
+read -b a
+head -n 1
+} <file
+echo "[$a]"
+__IN__
+2
+[1]
+__OUT__
+
 test_Oe -e 2 'missing operand'
 read
 __IN__
@@ -0,0 +1,105 @@
+# readarray-y.tst: yash-specific test of the readarray built-in
+
+setup -d
+
+test_oE 'reading all lines'
+printf '%s\n' 'a b' '\c' '' d | {
+readarray x
+echo $?
+bracket "$x"
+}
+__IN__
+0
+[a b][\c][][d]
+__OUT__
+
+test_oE 'input ending without newline'
+printf 'A\nB' | {
+readarray x
+echo $?
+bracket "$x"
+}
+__IN__
+0
+[A][B]
+__OUT__
+
+test_oE 'empty input'
+x=(foo)
+readarray x </dev/null
+echo $? ${x[#]}
+__IN__
+1 0
+__OUT__
+
+test_oE 'reading specified number of lines'
+printf '%s\n' 1 2 3 4 5 | {
+readarray -n 2 x; echo $?; bracket "$x"
+read y; echo "$y"
+readarray --count=2 x; echo $?; bracket "$x"
+readarray -n 2 x; echo $? ${x[#]}
+}
+__IN__
+0
+[1][2]
+3
+0
+[4][5]
+1 0
+__OUT__
+
+test_oE 'buffered reading of specified number of lines'
+printf '%s\n' 1 2 3 4 5 | {
+while readarray -b -n 2 x; do bracket "$x"; done
+}
+__IN__
+[1][2]
+[3][4]
+[5]
+__OUT__
+
+test_Oe -e 2 'invalid count'
+readarray -n 0 x
+__IN__
+readarray: `0' is not a valid count
+__ERR__
+#'
+#`
+
+test_Oe -e 2 'missing operand'
+readarray
+__IN__
+readarray: this command requires an operand
+__ERR__
+
+test_Oe -e 2 'too many operands'
+readarray a b
+__IN__
+readarray: too many operands are specified
+__ERR__
+
+test_Oe -e 1 'invalid variable name'
+readarray a=b </dev/null
+__IN__
+readarray: `a=b' is not a valid variable name
+__ERR__
+#'
+#`
+
+# Like the read built-in, any name not containing '=' is accepted.
+test_oE -e 0 'empty variable name'
+echo foo | { readarray ''; typeset -p ''; }
+__IN__
+''=(foo)
+typeset ''
+__OUT__
+
+test_Oe -e 2 'invalid option'
+readarray --no-such-option foo
+__IN__
+readarray: `--no-such-option' is not a valid option
+__ERR__
+#'
+#`
+
+# vim: set ft=sh ts=8 sts=4 sw=4 noet:
@@ -29,6 +29,28 @@ __IN__
 unset 4
 __OUT__
 
+test_oE -e 0 'local variable hiding global variable read repeatedly' -e
+a=global
+f() {
+    echo $a
+    typeset a=local
+    echo $a $a
+    if [ "$1" -gt 0 ]; then f $(($1 - 1)); fi
+    unset a
+    echo ${a-unset}
+}
+f 1
+echo $a
+__IN__
+global
+local local
+local
+local local
+local
+global
+global
+__OUT__
+
 test_oE -e 0 'overwriting temporary variable' -e
 a=1 typeset a=2
 echo $a
@@ -25,6 +25,22 @@ exit 3& p3=$!
 wait $p3 $p2 $p1
 __IN__
 
+test_oE 'waiting for many pipeline jobs one by one (+m)'
+i=0 pids=
+while [ "$i" -lt 30 ]; do
+    true | exit "$((i % 4))" &
+    pids="$pids $!"
+    i="$((i + 1))"
+done
+for pid in $pids; do
+    wait "$pid"
+    printf %d "$?"
+done
+echo
+__IN__
+012301230123012301230123012301
+__OUT__
+
 test_OE -e 127 'waiting for unknown job (+m)'
 exit 1&
 wait $! $(($!+1))
@@ -20,20 +20,26 @@
 #include "util.h"
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #if HAVE_GETTEXT
 # include <libintl.h>
 #endif
 #include <limits.h>
+#include <locale.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 #include <wchar.h>
 #include "exec.h"
 #include "option.h"
 #include "plist.h"
+#include "strbuf.h"
 
 
 /********** Memory Utilities **********/
@@ -221,6 +227,89 @@ void *copyaswcs(const void *p)
     return xwcsdup(p);
 }
 
+/* An array element and its sort key used in `sort_wcscoll'. */
+typedef struct collkey_T {
+    union {
+	const wchar_t *key;
+	size_t offset;
+    } k;
+    void *elem;
+} collkey_T;
+/* While the keys are being computed, `k.offset' is the index of the key in the
+ * buffer that contains all the keys. It is replaced with `k.key' afterwards. */
+
+static bool is_c_collation(void);
+static int collkeycmp(const void *v1, const void *v2)
+    __attribute__((nonnull,pure));
+
+/* Sorts the first `count' elements of `array' in the collating order of the
+ * wide strings that `elemstr' returns for the elements.
+ * Rather than calling `wcscoll' for every comparison, this function transforms
+ * each string by `wcsxfrm' once and sorts the elements by the transformed keys,
+ * which can be compared by `wcscmp'. If the locale collates strings in the
+ * order of code points, the strings are compared by `wcscmp' without
+ * transformation. */
+void sort_wcscoll(void **array, size_t count,
+	const wchar_t *elemstr(const void *elem))
+{
+    if (count < 2)
+	return;
+
+    collkey_T *keys = xmallocn(count, sizeof *keys);
+    xwcsbuf_T buf;
+    bool transform = !is_c_collation();
+    if (transform) {
+	/* Store all the keys in `buf', each followed by a null character. */
+	wb_init(&buf);
+	for (size_t i = 0; i < count; i++) {
+	    const wchar_t *s = elemstr(array[i]);
+	    size_t offset = buf.length;
+	    size_t length = wcsxfrm(&buf.contents[offset], s,
+		    buf.maxlength - offset + 1);
+	    if (length > buf.maxlength - offset) {
+		wb_ensuremax(&buf, add(offset, length));
+		wcsxfrm(&buf.contents[offset], s, length + 1);
+	    }
+	    wb_ensuremax(&buf, add(offset, length + 1));
+	    buf.length = offset + length + 1;
+	    buf.contents[buf.length] = L'\0';
+	    keys[i].k.offset = offset;
+	    keys[i].elem = array[i];
+	}
+	for (size_t i = 0; i < count; i++)
+	    keys[i].k.key = &buf.contents[keys[i].k.offset];
+    } else {
+	for (size_t i = 0; i < count; i++) {
+	    keys[i].k.key = elemstr(array[i]);
+	    keys[i].elem = array[i];
+	}
+    }
+
+    qsort(keys, count, sizeof *keys, collkeycmp);
+
+    for (size_t i = 0; i < count; i++)
+	array[i] = keys[i].elem;
+    free(keys);
+    if (transform)
+	wb_destroy(&buf);
+}
+
+/* Checks if the current locale for collation is the C (POSIX) locale or its
+ * variant with another encoding (such as "C.UTF-8"), in which `wcscoll' is
+ * equivalent to `wcscmp'. */
+bool is_c_collation(void)
+{
+    const char *locale = setlocale(LC_COLLATE, NULL);
+    return locale != NULL && (strcmp(locale, "POSIX") == 0
+	    || strcmp(locale, "C") == 0 || strncmp(locale, "C.", 2) == 0);
+}
+
+int collkeycmp(const void *v1, const void *v2)
+{
+    return wcscmp(((const collkey_T *) v1)->k.key,
+	    ((const collkey_T *) v2)->k.key);
+}
+
 
 /********** Error Utilities **********/
 
@@ -245,6 +334,7 @@ unsigned yash_error_message_count = 0;
 void xerror(int errno_, const char *restrict format, ...)
 {
     yash_error_message_count++;
+    flush_stdout();  // keep the order of output when stdout and stderr are same
     fprintf(stderr, "%ls: ",
 	    current_builtin_name != NULL
 	    ? current_builtin_name
@@ -279,7 +369,7 @@ bool xprintf(const char *restrict format, ...)
     result = vprintf(format, ap);
     va_end(ap);
 
-    if (result >= 0) {
+    if (result >= 0 && flush_stdout_if_unbuffered()) {
 	return true;
     } else {
 	xerror(errno, Ngt("cannot print to the standard output"));
@@ -288,4 +378,75 @@ bool xprintf(const char *restrict format, ...)
 }
 
 
+/********** Output Buffering **********/
+
+/* When the standard output is a regular file, it is fully buffered so that
+ * output of consecutive built-ins is written in large blocks. The buffer is
+ * flushed by `flush_stdout' before anything else may see or change the
+ * standard output: forking, executing a program, changing file descriptor 1,
+ * and blocking to wait for input or a child process. It is also flushed by
+ * `flush_stdout_if_unbuffered' once it has been kept for
+ * `STDOUT_FLUSH_INTERVAL' milliseconds so that output is not held back while
+ * the shell is busy. Output to a pipe, socket, terminal, or other device is
+ * flushed at the end of each built-in so that write errors are reported by the
+ * built-in that caused them. An error in writing buffered output to a regular
+ * file, such as ENOSPC or EFBIG, is reported when the buffer is flushed, which
+ * may be after the built-in that printed the output has returned with exit
+ * status zero. A regular file not open for writing is not buffered so that
+ * EBADF is reported by the built-in. */
+
+/* Whether the output to the standard output can be kept in the buffer across
+ * built-ins. Determined by `flush_stdout_if_unbuffered' when unknown. */
+static enum { SO_UNKNOWN, SO_BUFFERED, SO_UNBUFFERED } stdout_mode = SO_UNKNOWN;
+
+/* The maximum time in milliseconds buffered output is kept unwritten. */
+#define STDOUT_FLUSH_INTERVAL 100
+
+/* The time when the buffered standard output was last flushed by
+ * `flush_stdout_if_unbuffered'. */
+static struct timespec stdout_flush_time;
+
+/* Flushes the standard output. Must be called before the file descriptor of
+ * the standard output is changed. Prints an error message on failure. */
+void flush_stdout(void)
+{
+    /* `xerror' calls this function, in which the error must not be reported
+     * again. */
+    static bool reporting = false;
+
+    stdout_mode = SO_UNKNOWN;
+    if (fflush(stdout) != 0 && !reporting) {
+	reporting = true;
+	xerror(errno, Ngt("cannot print to the standard output"));
+	reporting = false;
+    }
+}
+
+/* Flushes the standard output unless it is a regular file whose buffer has
+ * been flushed less than `STDOUT_FLUSH_INTERVAL' milliseconds ago.
+ * Returns false with `errno' set if failed to write. */
+bool flush_stdout_if_unbuffered(void)
+{
+    if (stdout_mode == SO_UNKNOWN) {
+	struct stat st;
+	int flags;
+	stdout_mode = fstat(STDOUT_FILENO, &st) >= 0 && S_ISREG(st.st_mode)
+		&& (flags = fcntl(STDOUT_FILENO, F_GETFL)) >= 0
+		&& (flags & O_ACCMODE) != O_RDONLY
+	    ? SO_BUFFERED : SO_UNBUFFERED;
+    }
+    if (stdout_mode == SO_BUFFERED) {
+	struct timespec now;
+	if (clock_gettime(CLOCK_MONOTONIC, &now) == 0) {
+	    double elapsed =
+		difftime(now.tv_sec, stdout_flush_time.tv_sec) * 1e3
+		+ (now.tv_nsec - stdout_flush_time.tv_nsec) / 1e6;
+	    if (0 <= elapsed && elapsed < STDOUT_FLUSH_INTERVAL)
+		return !ferror(stdout);
+	    stdout_flush_time = now;
+	}
+    }
+    return fflush(stdout) == 0;
+}
+
 /* vim: set ts=8 sts=4 sw=4 noet tw=80: */
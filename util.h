@@ -24,25 +24,6 @@
 #define Size_max ((size_t) -1)  // = SIZE_MAX
 
 
-/********** Miscellaneous Functions **********/
-
-static inline int xunsetenv(const char *name)
-    __attribute__((nonnull));
-
-/* Removes the environment variable of the specified name.
- * This function wraps the `unsetenv' function, which has an incompatible
- * prototype on some old environments. */
-int xunsetenv(const char *name)
-{
-#if UNSETENV_RETURNS_INT
-    return unsetenv(name);
-#else
-    unsetenv(name);
-    return 0;
-#endif
-}
-
-
 /********** Memory Functions **********/
 
 static inline size_t add(size_t a, size_t b)
@@ -209,6 +190,9 @@ extern wchar_t *matchwcsprefix(const wchar_t *s, const wchar_t *prefix)
     __attribute__((pure,nonnull));
 extern void *copyaswcs(const void *p)
     __attribute__((malloc,warn_unused_result,nonnull));
+extern void sort_wcscoll(void **array, size_t count,
+	const wchar_t *elemstr(const void *elem))
+    __attribute__((nonnull));
 
 #if HAVE_STRNLEN
 # ifndef strnlen
@@ -282,6 +266,12 @@ extern _Bool xprintf(const char *restrict format, ...)
     __attribute__((format(printf,1,2)));
 
 
+/********** Output Buffering **********/
+
+extern void flush_stdout(void);
+extern _Bool flush_stdout_if_unbuffered(void);
+
+
 #undef Size_max
 
 #endif /* YASH_UTIL_H */
@@ -132,12 +132,21 @@ static void varkvfree_reexport(kvpair_T kv);
 
 static void init_pwd(void);
 
+static void invalidate_variable_cache(void);
+static kvpair_T bind_variable(
+	environ_T *env, wchar_t *name, variable_T *var)
+    __attribute__((nonnull));
+static kvpair_T unbind_variable(environ_T *env, const wchar_t *name)
+    __attribute__((nonnull));
 static variable_T *search_variable(const wchar_t *name)
-    __attribute__((pure,nonnull));
+    __attribute__((nonnull));
 static variable_T *search_array_and_check_if_changeable(const wchar_t *name)
     __attribute__((pure,nonnull));
 static void update_environment(const wchar_t *name)
     __attribute__((nonnull));
+static bool is_consulted_by_libc(const wchar_t *name)
+    __attribute__((nonnull,pure));
+static void apply_environment_changes(void);
 static void reset_locale(const wchar_t *name)
     __attribute__((nonnull));
 static void reset_locale_category(const wchar_t *name, int category)
@@ -190,12 +199,42 @@ static environ_T *current_env;
 /* the top-level environment (the farthest from the current) */
 static environ_T *first_env;
 
+/* A cache of the results of `search_variable'.
+ * An entry is valid only if its `epoch' equals `varepoch', which is incremented
+ * whenever a variable is added to or removed from any environment or an
+ * environment is opened or closed. Since such a change is the only way the
+ * result of `search_variable' can change, a valid entry can be used without
+ * walking the chain of environments.
+ * `name' points to the key of the variable in the environment's hashtable,
+ * which remains valid while the epoch is unchanged. */
+#define VARCACHE_SIZE 64
+static struct varcache_T {
+    unsigned epoch;
+    hashval_T hash;
+    const wchar_t *name;
+    variable_T *var;
+} varcache[VARCACHE_SIZE];
+static unsigned varepoch = 1;
+
 /* whether $RANDOM is functioning as a random number */
 static bool random_active;
 
 /* hashtable from function names (wchar_t *) to functions (function_T *). */
 static hashtable_T functions;
 
+/* hashtable from the names (wchar_t *) of environment variables to the
+ * "name=value" strings (char *) passed to external commands. */
+static hashtable_T envtable;
+/* hashtable whose keys are the names (wchar_t *) of the exported variables that
+ * have been changed since `envtable' was last updated. Values are not used. */
+static hashtable_T envdirty;
+/* entries of the original `environ' whose names cannot be converted to wide
+ * strings. They are passed to external commands unchanged. */
+static plist_T envforeign;
+/* the array last built from `envtable' and `envforeign', or NULL if `environ'
+ * is still the original one. */
+static char **envarray;
+
 
 /* Frees the value of the specified variable (but not the variable itself). */
 /* This function does not change the value of `*v'. */
@@ -254,12 +293,17 @@ void init_environment(void)
 //	current_env->paths[i] = NULL;
 
     ht_init(&functions, hashwcs, htwcscmp);
+    ht_init(&envtable, hashwcs, htwcscmp);
+    ht_init(&envdirty, hashwcs, htwcscmp);
+    pl_init(&envforeign);
 
     /* add all the existing environment variables to the variable environment */
     for (char **e = environ; *e != NULL; e++) {
 	wchar_t *we = malloc_mbstowcs(*e);
-	if (we == NULL)
+	if (we == NULL) {
+	    pl_add(&envforeign, *e);
 	    continue;
+	}
 
 	wchar_t *eqp = wcschr(we, L'=');
 	variable_T *v = xmalloc(sizeof *v);
@@ -270,7 +314,8 @@ void init_environment(void)
 	    *eqp = L'\0';
 	    we = xreallocn(we, eqp - we + 1, sizeof *we);
 	}
-	varkvfree(ht_set(&current_env->contents, we, v));
+	kvfree(ht_set(&envtable, xwcsdup(we), xstrdup(*e)));
+	varkvfree(bind_variable(current_env, we, v));
     }
 
     /* initialize path according to $PATH etc. */
@@ -381,14 +426,51 @@ set:
     set_variable(L VAR_PWD, wnewpwd, SCOPE_GLOBAL, true);
 }
 
+/* Invalidates all the entries of `varcache'. */
+void invalidate_variable_cache(void)
+{
+    if (++varepoch == 0) {
+	/* On wrap-around, old entries might look valid again. */
+	memset(varcache, 0, sizeof varcache);
+	varepoch = 1;
+    }
+}
+
+/* Adds the specified variable to the environment, invalidating `varcache'.
+ * Returns the key-value pair that has been replaced, if any. */
+kvpair_T bind_variable(environ_T *env, wchar_t *name, variable_T *var)
+{
+    invalidate_variable_cache();
+    return ht_set(&env->contents, name, var);
+}
+
+/* Removes the variable from the environment, invalidating `varcache'.
+ * Returns the removed key-value pair, if any. */
+kvpair_T unbind_variable(environ_T *env, const wchar_t *name)
+{
+    invalidate_variable_cache();
+    return ht_remove(&env->contents, name);
+}
+
 /* Searches for a variable with the specified name.
  * Returns NULL if none was found. */
 variable_T *search_variable(const wchar_t *name)
 {
+    hashval_T hash = hashwcs(name);
+    struct varcache_T *cache = &varcache[(size_t) hash % VARCACHE_SIZE];
+    if (cache->epoch == varepoch && cache->hash == hash
+	    && wcscmp(cache->name, name) == 0)
+	return cache->var;
+
     for (environ_T *env = current_env; env != NULL; env = env->parent) {
-	variable_T *var = ht_get(&env->contents, name).value;
-	if (var != NULL)
-	    return var;
+	kvpair_T kv = ht_get(&env->contents, name);
+	if (kv.value != NULL) {
+	    *cache = (struct varcache_T) {
+		.epoch = varepoch, .hash = hash,
+		.name = kv.key, .var = kv.value,
+	    };
+	    return kv.value;
+	}
     }
     return NULL;
 }
@@ -408,26 +490,117 @@ variable_T *search_array_and_check_if_changeable(const wchar_t *name)
     return array;
 }
 
-/* Update the value in `environ' for the variable with the specified name.
- * `name' must not contain '='. */
+/* Marks the environment variable of the specified name as outdated so that
+ * the value in `environ' is updated when `get_environ' is called next time.
+ * Variables that may affect the behavior of the C library in the shell process
+ * (e.g. $LANG and $TERM) are reflected in `environ' immediately. */
 void update_environment(const wchar_t *name)
 {
-    char *mname = malloc_wcstombs(name);
-    if (mname == NULL)
+    if (name[0] == L'\0' || wcschr(name, L'=') != NULL) {
+	/* Such a name cannot appear in `environ'. */
+	char *mname = malloc_wcstombs(name);
+	char *value = get_exported_value(name);
+	if (mname != NULL) {
+	    if (value == NULL)
+		xerror(EINVAL, Ngt("failed to unset environment variable $%s"),
+			mname);
+	    else
+		xerror(EINVAL, Ngt("failed to set environment variable $%s"),
+			mname);
+	}
+	free(mname);
+	free(value);
 	return;
+    }
 
-    char *value = get_exported_value(name);
-    if (value == NULL) {
-	if (xunsetenv(mname) < 0)
-	    xerror(errno, Ngt("failed to unset environment variable $%s"),
-		    mname);
-    } else {
-	if (setenv(mname, value, true) < 0)
-	    xerror(errno, Ngt("failed to set environment variable $%s"), mname);
+    if (ht_get(&envdirty, name).key == NULL)
+	ht_set(&envdirty, xwcsdup(name), NULL);
+    if (is_consulted_by_libc(name))
+	get_environ();
+}
+
+/* Returns true iff the value of the environment variable of the specified name
+ * may be read by the C library or terminfo functions called in the shell:
+ * the locale and message catalog variables read by `setlocale' and `gettext',
+ * the paths to locale data and character set converters, the time zone
+ * variables read by `localtime', and the terminal variables read by terminfo
+ * functions, which also look for $HOME/.terminfo. */
+bool is_consulted_by_libc(const wchar_t *name)
+{
+    switch (name[0]) {
+	case L'C':
+	    return wcscmp(name, L VAR_COLUMNS) == 0;
+	case L'G':
+	    return wcscmp(name, L"GCONV_PATH") == 0;
+	case L'H':
+	    return wcscmp(name, L VAR_HOME) == 0;
+	case L'L':
+	    return wcscmp(name, L VAR_LANG) == 0
+		|| wcscmp(name, L"LANGUAGE") == 0
+		|| wcsncmp(name, L"LC_", 3) == 0
+		|| wcscmp(name, L VAR_LINES) == 0
+		|| wcscmp(name, L"LOCPATH") == 0;
+	case L'N':
+	    return wcscmp(name, L"NLSPATH") == 0;
+	case L'T':
+	    return wcscmp(name, L"TZ") == 0
+		|| wcscmp(name, L"TZDIR") == 0
+		|| wcsncmp(name, L VAR_TERM, 4) == 0;
+	default:
+	    return false;
     }
+}
 
-    free(mname);
-    free(value);
+/* Returns the array of "name=value" strings of the current environment
+ * variables, which is also assigned to `environ'.
+ * The array is rebuilt only if any exported variable has been changed since
+ * the last call, so consecutive calls return the same array. The array is
+ * valid until the next call to this function. */
+char **get_environ(void)
+{
+    if (envdirty.count > 0) {
+	apply_environment_changes();
+
+	plist_T list;
+	pl_initwithmax(&list, envtable.count + envforeign.length);
+	size_t i = 0;
+	kvpair_T kv;
+	while ((kv = ht_next(&envtable, &i)).key != NULL)
+	    pl_add(&list, kv.value);
+	pl_ncat(&list, envforeign.contents, envforeign.length);
+
+	free(envarray);
+	envarray = (char **) pl_toary(&list);
+	environ = envarray;
+    }
+    return environ;
+}
+
+/* Updates `envtable' for the variables in `envdirty' and clears `envdirty'. */
+void apply_environment_changes(void)
+{
+    size_t i = 0;
+    kvpair_T kv;
+    while ((kv = ht_next(&envdirty, &i)).key != NULL) {
+	const wchar_t *name = kv.key;
+	char *mname = malloc_wcstombs(name);
+	if (mname == NULL)
+	    continue;
+
+	char *value = get_exported_value(name);
+	if (value == NULL) {
+	    free(mname);
+	    kvfree(ht_remove(&envtable, name));
+	} else {
+	    xstrbuf_T entry;
+	    sb_initwithmax(&entry, strlen(mname) + strlen(value) + 1);
+	    sb_catfree(&entry, mname);
+	    sb_ccat(&entry, '=');
+	    sb_catfree(&entry, value);
+	    kvfree(ht_set(&envtable, xwcsdup(name), sb_tostr(&entry)));
+	}
+    }
+    ht_clear(&envdirty, kfree);
 }
 
 /* Returns the value of variable `name' that should be exported.
@@ -507,6 +680,8 @@ void reset_locale_category(const wchar_t *name, int category)
 	setlocale(category, wlocale);
 	free(wlocale);
     }
+    if (category == LC_CTYPE || category == LC_COLLATE)
+	xfnm_locale_changed();
 }
 
 /* Creates a new scalar variable that has no value.
@@ -521,7 +696,7 @@ variable_T *new_global(const wchar_t *name)
 	if (var != NULL) {
 	    if (env->is_temporary) {
 		assert(!(var->v_type & VF_NODELETE));
-		varkvfree_reexport(ht_remove(&env->contents, name));
+		varkvfree_reexport(unbind_variable(env, name));
 		continue;
 	    }
 	    return var;
@@ -531,7 +706,7 @@ variable_T *new_global(const wchar_t *name)
     var->v_type = VF_SCALAR;
     var->v_value = NULL;
     var->v_getter = NULL;
-    ht_set(&first_env->contents, xwcsdup(name), var);
+    bind_variable(first_env, xwcsdup(name), var);
     return var;
 }
 
@@ -543,7 +718,7 @@ variable_T *new_local(const wchar_t *name)
 {
     environ_T *env = current_env;
     while (env->is_temporary) {
-	varkvfree_reexport(ht_remove(&env->contents, name));
+	varkvfree_reexport(unbind_variable(env, name));
 	env = env->parent;
     }
     variable_T *var = ht_get(&env->contents, name).value;
@@ -553,7 +728,7 @@ variable_T *new_local(const wchar_t *name)
     var->v_type = VF_SCALAR;
     var->v_value = NULL;
     var->v_getter = NULL;
-    ht_set(&env->contents, xwcsdup(name), var);
+    bind_variable(env, xwcsdup(name), var);
     return var;
 }
 
@@ -580,7 +755,7 @@ variable_T *new_temporary(const wchar_t *name)
     var->v_type = VF_SCALAR;
     var->v_value = NULL;
     var->v_getter = NULL;
-    ht_set(&env->contents, xwcsdup(name), var);
+    bind_variable(env, xwcsdup(name), var);
     return var;
 }
 
@@ -983,6 +1158,7 @@ void open_new_environment(bool temp)
 {
     environ_T *newenv = xmalloc(sizeof *newenv);
 
+    invalidate_variable_cache();
     newenv->parent = current_env;
     newenv->is_temporary = temp;
     ht_init(&newenv->contents, hashwcs, htwcscmp);
@@ -998,6 +1174,7 @@ void close_current_environment(void)
     environ_T *oldenv = current_env;
 
     assert(oldenv != first_env);
+    invalidate_variable_cache();
     current_env = oldenv->parent;
     ht_clear(&oldenv->contents, varkvfree_reexport);
     ht_destroy(&oldenv->contents);
@@ -1596,6 +1773,8 @@ static bool set_optind(unsigned long optind, unsigned long optsubind);
 static inline bool set_optarg(const wchar_t *value);
 static bool set_variable_single_char(const wchar_t *varname, wchar_t value)
     __attribute__((nonnull));
+static bool validate_read_variable_name(const wchar_t *name)
+    __attribute__((nonnull));
 static bool read_with_prompt(
 	xwcsbuf_T *buf, xstrbuf_T *cc, const struct reading_option_T *ro)
     __attribute__((nonnull));
@@ -1605,7 +1784,7 @@ static struct promptset_T promptset_for_read(
 static wchar_t *read_one_line_with_prompt(
 	struct promptset_T prompt, bool lineedit)
     __attribute__((malloc,warn_unused_result));
-static wchar_t *read_one_line(void)
+static wchar_t *read_one_line(bool buffered)
     __attribute__((malloc,warn_unused_result));
 static bool unescape_line(const wchar_t *line, xwcsbuf_T *buf, xstrbuf_T *cc)
     __attribute__((nonnull));
@@ -2352,7 +2531,7 @@ bool unset_function(const wchar_t *name)
 bool unset_variable(const wchar_t *name)
 {
     for (environ_T *env = current_env; env != NULL; env = env->parent) {
-	kvpair_T kv = ht_remove(&env->contents, name);
+	kvpair_T kv = unbind_variable(env, name);
 	variable_T *var = kv.value;
 	if (var != NULL) {
 	    if (!(var->v_type & VF_NODELETE)) {
@@ -2364,7 +2543,7 @@ bool unset_variable(const wchar_t *name)
 		return false;
 	    } else {
 		xerror(0, Ngt("$%ls is read-only"), name);
-		ht_set(&env->contents, kv.key, kv.value);
+		bind_variable(env, kv.key, kv.value);
 		return true;
 	    }
 	}
@@ -2689,6 +2868,7 @@ const char getopts_syntax[] = Ngt(
 /* Options for the "read" built-in. */
 const struct xgetopt_T read_options[] = {
     { L'A', L"array",        OPTARG_NONE,     false, NULL, },
+    { L'b', L"buffered",     OPTARG_NONE,     false, NULL, },
     { L'e', L"line-editing", OPTARG_NONE,     false, NULL, },
     { L'P', L"ps1",          OPTARG_NONE,     false, NULL, },
     { L'p', L"prompt",       OPTARG_REQUIRED, false, NULL, },
@@ -2700,12 +2880,13 @@ const struct xgetopt_T read_options[] = {
 };
 
 struct reading_option_T {
-    bool array, lineedit, ps1, raw;
+    bool array, buffered, lineedit, ps1, raw;
     const wchar_t *prompt;
 };
 
 /* The "read" built-in, which accepts the following options:
  *  -A: assign values to array
+ *  -b: keep a read-ahead buffer
  *  -e: use line-editing
  *  -P: use $PS1
  *  -p: specify prompt
@@ -2715,6 +2896,7 @@ int read_builtin(int argc, void **argv)
 {
     struct reading_option_T ro = {
 	.array = false,
+	.buffered = false,
 	.lineedit = false,
 	.ps1 = false,
 	.raw = false,
@@ -2726,6 +2908,7 @@ int read_builtin(int argc, void **argv)
     while ((opt = xgetopt(argv, read_options, 0)) != NULL) {
 	switch (opt->shortopt) {
 	    case L'A':  ro.array    = true;     break;
+	    case L'b':  ro.buffered = true;     break;
 	    case L'e':  ro.lineedit = true;     break;
 	    case L'P':  ro.ps1      = true;     break;
 	    case L'p':  ro.prompt   = xoptarg;  break;
@@ -2745,12 +2928,9 @@ int read_builtin(int argc, void **argv)
 	return insufficient_operands_error(1);
 
     /* check if the identifiers are valid */
-    for (int i = xoptind; i < argc; i++) {
-	if (wcschr(ARGV(i), L'=') != NULL) {
-	    xerror(0, Ngt("`%ls' is not a valid variable name"), ARGV(i));
+    for (int i = xoptind; i < argc; i++)
+	if (!validate_read_variable_name(ARGV(i)))
 	    return Exit_FAILURE;
-	}
-    }
 
     xwcsbuf_T buf;
     xstrbuf_T cc;
@@ -2824,6 +3004,19 @@ int read_builtin(int argc, void **argv)
 	    ? Exit_SUCCESS : Exit_FAILURE;
 }
 
+/* Checks if `name' can be the name of a variable assigned by the "read" or
+ * "readarray" built-in. Like the "typeset" built-in, these built-ins accept any
+ * name that does not contain '=', which would be taken as an assignment.
+ * If the name is invalid, an error message is printed and false is returned. */
+bool validate_read_variable_name(const wchar_t *name)
+{
+    if (wcschr(name, L'=') != NULL) {
+	xerror(0, Ngt("`%ls' is not a valid variable name"), name);
+	return false;
+    }
+    return true;
+}
+
 /* Reads one line from the standard input. The result is appended to `buf' and
  * `cc'. `buf' will contain no escapes or other special characters. `cc' is the
  * charcategory_T string for `buf'. It indicates whether `buf' can be split at
@@ -2846,7 +3039,7 @@ bool read_with_prompt(
 	    line = read_one_line_with_prompt(prompt, ro->lineedit);
 	    free_prompt(prompt);
 	} else {
-	    line = read_one_line();
+	    line = read_one_line(ro->buffered);
 	}
 	if (line == NULL)
 	    return false;
@@ -2910,7 +3103,7 @@ wchar_t *read_one_line_with_prompt(struct promptset_T prompt, bool lineedit)
     print_prompt(prompt.main);
     print_prompt(prompt.styler);
 
-    line = read_one_line();
+    line = read_one_line(false);
 
     print_prompt(PROMPT_RESET);
 
@@ -2919,13 +3112,17 @@ wchar_t *read_one_line_with_prompt(struct promptset_T prompt, bool lineedit)
 
 /* Reads one line from the standard input without printing any prompt or using
  * line-editing.
+ * If `buffered' is true, the input is read by `read_input_ahead'.
  * The result is returned as a newly-malloced wide string. The result is null
  * iff an error occurs. */
-wchar_t *read_one_line(void)
+wchar_t *read_one_line(bool buffered)
 {
     xwcsbuf_T buf;
     wb_init(&buf);
-    if (read_input(&buf, stdin_input_file_info, false) != INPUT_ERROR)
+    inputresult_T result = buffered
+	? read_input_ahead(&buf, false)
+	: read_input(&buf, stdin_input_file_info, false);
+    if (result != INPUT_ERROR)
 	return wb_towcs(&buf);
     wb_destroy(&buf);
     return NULL;
@@ -2994,10 +3191,108 @@ const char read_help[] = Ngt(
 "read a line from the standard input"
 );
 const char read_syntax[] = Ngt(
-"\tread [-Aer] [-P|-p] variable...\n"
+"\tread [-Aber] [-P|-p] variable...\n"
 );
 #endif
 
+#if YASH_ENABLE_ARRAY
+
+/* Options for the "readarray" built-in. */
+const struct xgetopt_T readarray_options[] = {
+    { L'b', L"buffered", OPTARG_NONE,     true,  NULL, },
+    { L'n', L"count",    OPTARG_REQUIRED, true,  NULL, },
+#if YASH_ENABLE_HELP
+    { L'-', L"help",     OPTARG_NONE,     false, NULL, },
+#endif
+    { L'\0', NULL, 0, false, NULL, },
+};
+
+/* The "readarray" built-in, which accepts the following options:
+ *  -b: keep a read-ahead buffer
+ *  -n: specify the maximum number of lines to read
+ * If the -n option is not specified, all the remaining lines are read, in
+ * which case the read-ahead buffer is always used since no input is left for
+ * other commands anyway. */
+int readarray_builtin(int argc, void **argv)
+{
+    bool buffered = false;
+    long count = 0;
+
+    const struct xgetopt_T *opt;
+    xoptind = 0;
+    while ((opt = xgetopt(argv, readarray_options, 0)) != NULL) {
+	switch (opt->shortopt) {
+	    case L'b':
+		buffered = true;
+		break;
+	    case L'n':
+		if (!xwcstol(xoptarg, 10, &count) || count <= 0) {
+		    xerror(0, Ngt("`%ls' is not a valid count"), xoptarg);
+		    return Exit_ERROR;
+		}
+		break;
+#if YASH_ENABLE_HELP
+	    case L'-':
+		return print_builtin_help(ARGV(0));
+#endif
+	    default:
+		return Exit_ERROR;
+	}
+    }
+
+    if (!validate_operand_count(argc - xoptind, 1, 1))
+	return Exit_ERROR;
+
+    const wchar_t *name = ARGV(xoptind);
+    if (!validate_read_variable_name(name))
+	return Exit_FAILURE;
+
+    if (count == 0)
+	buffered = true;
+
+    plist_T lines;
+    xwcsbuf_T buf;
+    pl_init(&lines);
+    wb_init(&buf);
+    while (count == 0 || lines.length < (size_t) count) {
+	inputresult_T result = buffered
+	    ? read_input_ahead(&buf, false)
+	    : read_input(&buf, stdin_input_file_info, false);
+	if (result == INPUT_ERROR) {
+	    wb_destroy(&buf);
+	    plfree(pl_toary(&lines), free);
+	    return Exit_FAILURE;
+	}
+	if (result == INPUT_EOF)
+	    break;
+
+	/* remove trailing newline */
+	if (buf.contents[buf.length - 1] == L'\n')
+	    wb_truncate(&buf, buf.length - 1);
+	pl_add(&lines, xwcsndup(buf.contents, buf.length));
+	wb_clear(&buf);
+    }
+    wb_destroy(&buf);
+
+    size_t linecount = lines.length;
+    if (set_array(name, linecount, pl_toary(&lines),
+		SCOPE_GLOBAL, shopt_allexport) == NULL)
+	return Exit_FAILURE;
+    return (linecount > 0 && yash_error_message_count == 0)
+	    ? Exit_SUCCESS : Exit_FAILURE;
+}
+
+#if YASH_ENABLE_HELP
+const char readarray_help[] = Ngt(
+"read lines from the standard input into an array"
+);
+const char readarray_syntax[] = Ngt(
+"\treadarray [-b] [-n count] array\n"
+);
+#endif
+
+#endif /* YASH_ENABLE_ARRAY */
+
 /* options for the "pushd" built-in */
 const struct xgetopt_T pushd_options[] = {
 #if YASH_ENABLE_DIRSTACK
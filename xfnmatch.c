@@ -24,15 +24,58 @@
 #include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
+#include <wctype.h>
 #include "strbuf.h"
 #include "util.h"
 
 
+/* A bracket expression in a glob. */
+typedef struct globbracket_T {
+    bool negated;
+    size_t rangecount, classcount;
+    wchar_t (*ranges)[2];
+    wctype_t *classes;
+} globbracket_T;
+/* Each range is a pair of the smallest and largest characters in the range.
+ * A single character is represented as a range whose ends are the same. */
+
+typedef enum globelemtype_T {
+    GE_CHAR, GE_ANY, GE_STAR, GE_BRACKET,
+} globelemtype_T;
+typedef struct globelem_T {
+    globelemtype_T type;
+    union {
+	wchar_t c;
+	globbracket_T *bracket;
+    } value;
+} globelem_T;
+
+/* A glob is a sequence of elements matched by a non-deterministic automaton.
+ * The state of the automaton is the set of the indices of elements that are to
+ * be matched next. Index `count' is the final (accepting) state.
+ * If the pattern is compiled with XFNM_TAILONLY but without XFNM_HEADONLY, the
+ * elements are stored in the reverse order so that the automaton can read the
+ * string backward from its end (see `is_reversed_glob').
+ * `states' points to two state sets of `count + 1' bytes each that are used as
+ * work space during matching. They are allocated with the glob rather than on
+ * the stack since the pattern may be arbitrarily long. If the glob is compiled
+ * without XFNM_HEADONLY and XFNM_TAILONLY, `starts' likewise points to two
+ * arrays of `count + 1' start indices used by `glob_wsearch'; otherwise it is
+ * NULL. */
+typedef struct glob_T {
+    size_t count;
+    globelem_T *elems;
+    unsigned char *states;
+    size_t *starts;
+} glob_T;
+
 struct xfnmatch_T {
     xfnmflags_T flags;
+    unsigned generation;
     union {
 	regex_t regex;
 	xwcsbuf_T literal;
+	glob_T glob;
     } value;
 };
 /* The flags are logical OR of the followings:
@@ -42,17 +85,54 @@ struct xfnmatch_T {
  *  XFNM_PERIOD:    don't match with a string that starts with a period
  *  XFNM_CASEFOLD:  ignore case while matching
  *  XFNM_compiled:  use `regex' rather than `literal'
+ *  XFNM_glob:      use `glob' rather than `literal'
  * When XFNM_SHORTEST is specified, either (but not both) of XFNM_HEADONLY and
  * XFNM_TAILONLY must be also specified. When XFNM_PERIOD is specified,
- * XFNM_HEADONLY must be also specified. */
+ * XFNM_HEADONLY must be also specified.
+ * `generation' is the value of `locale_generation' when the pattern was
+ * compiled. */
+
+/* The number of times the locale was changed. A compiled pattern is outdated
+ * when this value differs from its `generation'. */
+static unsigned locale_generation = 0;
+
+/* The maximum number of compiled patterns in the cache of
+ * `xfnm_compile_cached'. */
+#define XFNM_CACHE_SIZE 16
+
+/* An entry of the cache of compiled patterns. */
+typedef struct xfnmcache_T {
+    wchar_t *pattern;
+    xfnmflags_T flags;
+    xfnmatch_T *xfnm;
+} xfnmcache_T;
+/* The cache entries are sorted from the most recently used to the least. */
+static xfnmcache_T xfnm_cache[XFNM_CACHE_SIZE];
+static size_t xfnm_cache_count = 0;
 
 #define XFNM_HEADTAIL (XFNM_HEADONLY | XFNM_TAILONLY)
 #define MISMATCH ((xfnmresult_T) { (size_t) -1, (size_t) -1, })
 
+/* Tests if the elements of the glob compiled with the specified flags are
+ * stored in the reverse order. */
+#define is_reversed_glob(flags) \
+    (((flags) & (XFNM_glob | XFNM_HEADTAIL)) == (XFNM_glob | XFNM_TAILONLY))
+
 static bool is_matching_pattern_bracket(const wchar_t *pat)
     __attribute__((nonnull,pure));
 static xfnmatch_T *try_compile_literal(const wchar_t *pat, xfnmflags_T flags)
     __attribute__((malloc,warn_unused_result,nonnull));
+static xfnmatch_T *try_compile_glob(const wchar_t *pat, xfnmflags_T flags)
+    __attribute__((malloc,warn_unused_result,nonnull));
+static int compile_glob_bracket(
+	const wchar_t **restrict patp, globelem_T *restrict elem)
+    __attribute__((nonnull));
+static void add_bracket_range(globbracket_T *bracket, wchar_t lo, wchar_t hi)
+    __attribute__((nonnull));
+static void add_bracket_class(globbracket_T *bracket, wctype_t class)
+    __attribute__((nonnull));
+static void free_glob(glob_T *glob)
+    __attribute__((nonnull));
 static xfnmatch_T *try_compile_regex(const wchar_t *pat, xfnmflags_T flags)
     __attribute__((malloc,warn_unused_result,nonnull));
 static void encode_pattern(const wchar_t *restrict pat, xstrbuf_T *restrict buf)
@@ -69,6 +149,38 @@ static void append_as_collating_symbol(wchar_t c,
 static xfnmresult_T wmatch_literal(
 	const xfnmatch_T *restrict xfnm, const wchar_t *restrict s)
     __attribute__((nonnull));
+static bool bracket_contains(const globbracket_T *bracket, wchar_t c)
+    __attribute__((nonnull,pure));
+static bool elem_matches(const globelem_T *elem, wchar_t c, bool casefold)
+    __attribute__((nonnull,pure));
+static void glob_add_state(
+	const glob_T *restrict glob, unsigned char *restrict states, size_t i)
+    __attribute__((nonnull));
+static bool glob_step(const glob_T *restrict glob, bool casefold,
+	const unsigned char *restrict cur, unsigned char *restrict next,
+	wchar_t c)
+    __attribute__((nonnull));
+static bool glob_test(const xfnmatch_T *restrict xfnm, const char *restrict s)
+    __attribute__((nonnull));
+static bool glob_wtest(
+	const xfnmatch_T *restrict xfnm, const wchar_t *restrict s)
+    __attribute__((nonnull));
+static size_t glob_wmatch_head(const xfnmatch_T *restrict xfnm,
+	const wchar_t *restrict s, bool shortest, bool whole)
+    __attribute__((nonnull));
+static size_t glob_wmatch_tail(const xfnmatch_T *restrict xfnm,
+	const wchar_t *restrict s, size_t len, bool shortest)
+    __attribute__((nonnull));
+static void glob_add_start(
+	const glob_T *restrict glob, size_t *restrict starts, size_t i,
+	size_t start)
+    __attribute__((nonnull));
+static xfnmresult_T glob_wsearch(
+	const xfnmatch_T *restrict xfnm, const wchar_t *restrict s)
+    __attribute__((nonnull));
+static xfnmresult_T wmatch_glob(
+	const xfnmatch_T *restrict xfnm, const wchar_t *restrict s)
+    __attribute__((nonnull));
 static wchar_t *last_wcsstr(
 	const wchar_t *restrict s, const wchar_t *restrict sub)
     __attribute__((nonnull));
@@ -185,8 +297,12 @@ bool is_pathname_matching_pattern(const wchar_t *pat)
  * XFNM_TAILONLY must be also specified. When XFNM_PERIOD is specified,
  * XFNM_HEADONLY must be also specified.
  * Returns NULL on failure. */
-/* Argument `flags' must not contain XFNM_compiled, XFNM_headstar, or
- * XFNM_tailstar, which are for internal use only */
+/* Argument `flags' must not contain XFNM_compiled, XFNM_headstar,
+ * XFNM_tailstar, or XFNM_glob, which are for internal use only.
+ * A pattern is compiled into a literal string if possible, or into a glob
+ * automaton otherwise. Only patterns that the glob automaton cannot handle,
+ * such as collating symbols and equivalence classes, are converted into a
+ * regular expression. */
 xfnmatch_T *xfnm_compile(const wchar_t *pat, xfnmflags_T flags)
 {
     if (flags & XFNM_SHORTEST) {
@@ -201,13 +317,74 @@ xfnmatch_T *xfnm_compile(const wchar_t *pat, xfnmflags_T flags)
 	    flags &= ~XFNM_PERIOD;
     }
 
-    if (!(flags & XFNM_CASEFOLD)) {
-	xfnmatch_T *result = try_compile_literal(pat, flags);
-	if (result != NULL)
-	    return result;
+    xfnmatch_T *result = NULL;
+    if (!(flags & XFNM_CASEFOLD))
+	result = try_compile_literal(pat, flags);
+    if (result == NULL)
+	result = try_compile_glob(pat, flags);
+    if (result == NULL)
+	result = try_compile_regex(pat, flags);
+    if (result != NULL)
+	result->generation = locale_generation;
+    return result;
+}
+
+/* Compiles the specified pattern like `xfnm_compile', but reuses the result of
+ * a recent compilation of the same pattern with the same flags if any.
+ * The returned object belongs to the cache: the caller must not free it and
+ * must not use it after calling this function again or after the locale is
+ * changed. Returns NULL on failure. */
+const xfnmatch_T *xfnm_compile_cached(const wchar_t *pat, xfnmflags_T flags)
+{
+    size_t i;
+
+    for (i = 0; i < xfnm_cache_count; i++)
+	if (xfnm_cache[i].flags == flags
+		&& wcscmp(xfnm_cache[i].pattern, pat) == 0)
+	    goto found;
+
+    xfnmatch_T *xfnm = xfnm_compile(pat, flags);
+    if (xfnm == NULL)
+	return NULL;
+
+    if (xfnm_cache_count < XFNM_CACHE_SIZE) {
+	i = xfnm_cache_count++;
+    } else {
+	/* discard the least recently used entry */
+	i = XFNM_CACHE_SIZE - 1;
+	free(xfnm_cache[i].pattern);
+	xfnm_free(xfnm_cache[i].xfnm);
     }
+    xfnm_cache[i] = (xfnmcache_T) {
+	.pattern = xwcsdup(pat), .flags = flags, .xfnm = xfnm, };
+
+found:;
+    /* move the entry to the head */
+    xfnmcache_T entry = xfnm_cache[i];
+    memmove(&xfnm_cache[1], &xfnm_cache[0], i * sizeof *xfnm_cache);
+    xfnm_cache[0] = entry;
+    return entry.xfnm;
+}
+
+/* Tests if the specified compiled pattern was compiled before the last call to
+ * `xfnm_locale_changed'. An outdated pattern may not match correctly in the
+ * current locale and should be compiled again. */
+bool xfnm_is_outdated(const xfnmatch_T *xfnm)
+{
+    return xfnm->generation != locale_generation;
+}
 
-    return try_compile_regex(pat, flags);
+/* Must be called whenever the LC_CTYPE or LC_COLLATE locale is changed.
+ * Clears the cache of `xfnm_compile_cached' and makes all existing compiled
+ * patterns outdated. */
+void xfnm_locale_changed(void)
+{
+    for (size_t i = 0; i < xfnm_cache_count; i++) {
+	free(xfnm_cache[i].pattern);
+	xfnm_free(xfnm_cache[i].xfnm);
+    }
+    xfnm_cache_count = 0;
+    locale_generation++;
 }
 
 /* Checks if the specified pattern is a literal pattern and if so compiles it.
@@ -271,6 +448,213 @@ fail:
     return NULL;
 }
 
+/* Compiles the specified pattern into a glob automaton.
+ * If the pattern contains an element that is not supported by the automaton,
+ * NULL is returned. */
+/* A trailing backslash is ignored as in `encode_pattern'. */
+xfnmatch_T *try_compile_glob(const wchar_t *pat, xfnmflags_T flags)
+{
+    glob_T glob;
+    glob.count = 0;
+    glob.elems = xmallocn(wcslen(pat), sizeof *glob.elems);
+    glob.states = NULL;
+    glob.starts = NULL;
+
+    for (;;) {
+	globelem_T *elem = &glob.elems[glob.count];
+	switch (*pat) {
+	    case L'\0':
+		goto success;
+	    case L'?':
+		elem->type = GE_ANY;
+		break;
+	    case L'*':
+		elem->type = GE_STAR;
+		while (pat[1] == L'*')
+		    pat++;
+		break;
+	    case L'[':
+		switch (compile_glob_bracket(&pat, elem)) {
+		    case 1:   goto next;
+		    case 0:   goto ordinary;
+		    default:  goto fail;
+		}
+	    case L'\\':
+		pat++;
+		if (*pat == L'\0')
+		    goto success;
+		/* falls thru */
+	    default:  ordinary:
+		elem->type = GE_CHAR;
+		elem->value.c = *pat;
+		if (flags & XFNM_CASEFOLD)
+		    elem->value.c = towlower(elem->value.c);
+		break;
+	}
+next:
+	glob.count++;
+	pat++;
+    }
+
+success:;
+    glob.states = xmalloce(glob.count, glob.count + 2, 1);
+    if (!(flags & XFNM_HEADTAIL))
+	glob.starts = xmalloce(glob.count, glob.count + 2, sizeof *glob.starts);
+    xfnmatch_T *xfnm = xmalloc(sizeof *xfnm);
+    xfnm->flags = flags | XFNM_glob;
+    if (is_reversed_glob(xfnm->flags)) {
+	for (size_t i = 0, j = glob.count; i + 1 < j; i++, j--) {
+	    globelem_T temp = glob.elems[i];
+	    glob.elems[i] = glob.elems[j - 1];
+	    glob.elems[j - 1] = temp;
+	}
+    }
+    xfnm->value.glob = glob;
+    return xfnm;
+fail:
+    free_glob(&glob);
+    return NULL;
+}
+
+/* Compiles the bracket expression starting at `**patp', which must be L'['.
+ * Returns 1 if successful, in which case `*patp' is updated to point to the
+ * closing bracket and `*elem' is initialized as a GE_BRACKET element.
+ * Returns 0 if the bracket is not a valid bracket expression, in which case the
+ * bracket should be treated as an ordinary character.
+ * Returns -1 if the bracket expression contains an element not supported by the
+ * glob automaton: a collating symbol, an equivalence class, an unknown
+ * character class, or a range whose ends are not ASCII characters. The range
+ * order of non-ASCII characters depends on the collation of the locale, so
+ * such ranges are left to the regex implementation. */
+int compile_glob_bracket(
+	const wchar_t **restrict patp, globelem_T *restrict elem)
+{
+    const wchar_t *pat = *patp;
+    globbracket_T *bracket = xmalloc(sizeof *bracket);
+    int result;
+
+    assert(*pat == L'[');
+    pat++;
+    bracket->negated = (*pat == L'!' || *pat == L'^');
+    if (bracket->negated)
+	pat++;
+    bracket->rangecount = bracket->classcount = 0;
+    bracket->ranges = NULL;
+    bracket->classes = NULL;
+
+    for (bool first = true; ; first = false) {
+	wchar_t lo, hi;
+
+	switch (*pat) {
+	    case L'\0':
+		result = 0;
+		goto fail;
+	    case L']':
+		if (first)
+		    goto ordinary;
+		goto success;
+	    case L'[':
+		switch (pat[1]) {
+		    case L'.':  case L'=':
+			result = -1;
+			goto fail;
+		    case L':':;
+			const wchar_t *end = wcsstr(&pat[2], L":]");
+			if (end == NULL) {
+			    result = 0;
+			    goto fail;
+			}
+
+			char *name = malloc_wcsntombs(&pat[2], end - &pat[2]);
+			wctype_t class = (name != NULL) ? wctype(name) : 0;
+			free(name);
+			if (class == 0 || (end[2] == L'-' && end[3] != L']')) {
+			    result = -1;
+			    goto fail;
+			}
+			add_bracket_class(bracket, class);
+			pat = &end[2];
+			continue;
+		}
+		goto ordinary;
+	    case L'\\':
+		pat++;
+		if (*pat == L'\0') {
+		    result = 0;
+		    goto fail;
+		}
+		/* falls thru */
+	    default:  ordinary:
+		lo = hi = *pat++;
+		break;
+	}
+
+	if (pat[0] == L'-' && pat[1] != L']' && pat[1] != L'\0') {
+	    pat++;
+	    if (pat[0] == L'[' && wcschr(L".=:", pat[1]) != NULL) {
+		result = -1;
+		goto fail;
+	    }
+	    if (pat[0] == L'\\') {
+		pat++;
+		if (*pat == L'\0') {
+		    result = 0;
+		    goto fail;
+		}
+	    }
+	    hi = *pat++;
+	    if (lo > hi || (unsigned long) hi >= 0x80) {
+		result = -1;
+		goto fail;
+	    }
+	}
+	add_bracket_range(bracket, lo, hi);
+    }
+
+success:
+    *patp = pat;
+    elem->type = GE_BRACKET;
+    elem->value.bracket = bracket;
+    return 1;
+fail:
+    free(bracket->ranges);
+    free(bracket->classes);
+    free(bracket);
+    return result;
+}
+
+void add_bracket_range(globbracket_T *bracket, wchar_t lo, wchar_t hi)
+{
+    bracket->ranges = xreallocn(bracket->ranges,
+	    bracket->rangecount + 1, sizeof *bracket->ranges);
+    bracket->ranges[bracket->rangecount][0] = lo;
+    bracket->ranges[bracket->rangecount][1] = hi;
+    bracket->rangecount++;
+}
+
+void add_bracket_class(globbracket_T *bracket, wctype_t class)
+{
+    bracket->classes = xreallocn(bracket->classes,
+	    bracket->classcount + 1, sizeof *bracket->classes);
+    bracket->classes[bracket->classcount++] = class;
+}
+
+/* Frees the contents of the specified glob. */
+void free_glob(glob_T *glob)
+{
+    for (size_t i = 0; i < glob->count; i++) {
+	if (glob->elems[i].type == GE_BRACKET) {
+	    globbracket_T *bracket = glob->elems[i].value.bracket;
+	    free(bracket->ranges);
+	    free(bracket->classes);
+	    free(bracket);
+	}
+    }
+    free(glob->elems);
+    free(glob->states);
+    free(glob->starts);
+}
+
 /* Compiles the specified pattern.
  * Returns NULL on error. */
 xfnmatch_T *try_compile_regex(const wchar_t *pat, xfnmflags_T flags)
@@ -469,7 +853,9 @@ int xfnm_match(const xfnmatch_T *restrict xfnm, const char *restrict s)
 	if (s[0] == '.')
 	    return REG_NOMATCH;
 
-    if (xfnm->flags & XFNM_compiled) {
+    if ((xfnm->flags & XFNM_glob) && !is_reversed_glob(xfnm->flags)) {
+	return glob_test(xfnm, s) ? 0 : REG_NOMATCH;
+    } else if (xfnm->flags & XFNM_compiled) {
 	return regexec(&xfnm->value.regex, s, 0, NULL, 0);
     } else {
 	wchar_t *ws = malloc_mbstowcs(s);
@@ -497,6 +883,9 @@ xfnmresult_T xfnm_wmatch(
 	if (s[0] == L'.')
 	    return MISMATCH;
     }
+    if (flags & XFNM_glob) {
+	return wmatch_glob(xfnm, s);
+    }
     if (!(flags & XFNM_compiled)) {
 	return wmatch_literal(xfnm, s);
     }
@@ -568,6 +957,311 @@ xfnmresult_T wmatch_literal(
     }
 }
 
+/* Checks if character `c' is in any of the ranges or classes of the bracket.
+ * The `negated' flag of the bracket is ignored. */
+bool bracket_contains(const globbracket_T *bracket, wchar_t c)
+{
+    for (size_t i = 0; i < bracket->rangecount; i++)
+	if (bracket->ranges[i][0] <= c && c <= bracket->ranges[i][1])
+	    return true;
+    for (size_t i = 0; i < bracket->classcount; i++)
+	if (iswctype(c, bracket->classes[i]))
+	    return true;
+    return false;
+}
+
+/* Checks if glob element `elem' matches character `c'.
+ * `elem' must not be a GE_STAR element. */
+bool elem_matches(const globelem_T *elem, wchar_t c, bool casefold)
+{
+    switch (elem->type) {
+	case GE_CHAR:
+	    return elem->value.c == (casefold ? (wchar_t) towlower(c) : c);
+	case GE_ANY:
+	    return true;
+	case GE_BRACKET:;
+	    const globbracket_T *bracket = elem->value.bracket;
+	    bool contains = bracket_contains(bracket, c) || (casefold
+		    && (bracket_contains(bracket, towlower(c))
+			|| bracket_contains(bracket, towupper(c))));
+	    return contains != bracket->negated;
+	case GE_STAR:
+	    break;
+    }
+    assert(false);
+    return false;
+}
+
+/* Adds state `i' and the states reachable from it without consuming any
+ * character to the state set `states'. */
+void glob_add_state(
+	const glob_T *restrict glob, unsigned char *restrict states, size_t i)
+{
+    for (;;) {
+	states[i] = true;
+	if (i >= glob->count || glob->elems[i].type != GE_STAR)
+	    break;
+	i++;
+    }
+}
+
+/* Computes the state set `next' that results from feeding character `c' to the
+ * automaton in state set `cur'. Returns false iff `next' is empty. */
+bool glob_step(const glob_T *restrict glob, bool casefold,
+	const unsigned char *restrict cur, unsigned char *restrict next,
+	wchar_t c)
+{
+    bool alive = false;
+
+    memset(next, 0, glob->count + 1);
+    for (size_t i = 0; i < glob->count; i++) {
+	if (!cur[i])
+	    continue;
+	if (glob->elems[i].type == GE_STAR) {
+	    glob_add_state(glob, next, i);
+	    alive = true;
+	} else if (elem_matches(&glob->elems[i], c, casefold)) {
+	    glob_add_state(glob, next, i + 1);
+	    alive = true;
+	}
+    }
+    return alive;
+}
+
+/* Tests if glob `xfnm' matches multibyte string `s'.
+ * The XFNM_HEADONLY and XFNM_TAILONLY flags are honored, but the match
+ * position is not computed. The string is decoded on the fly and the whole
+ * test takes linear time. A string that cannot be decoded never matches. */
+bool glob_test(const xfnmatch_T *restrict xfnm, const char *restrict s)
+{
+    const glob_T *glob = &xfnm->value.glob;
+    bool casefold = xfnm->flags & XFNM_CASEFOLD;
+    bool anchored = xfnm->flags & XFNM_HEADONLY;
+    bool tailonly = xfnm->flags & XFNM_TAILONLY;
+    unsigned char *cur = glob->states, *next = cur + glob->count + 1;
+    mbstate_t state;
+
+    memset(&state, 0, sizeof state);  /* initial shift state */
+    memset(cur, 0, glob->count + 1);
+    glob_add_state(glob, cur, 0);
+    for (;;) {
+	wchar_t c;
+	size_t n = mbrtowc(&c, s, MB_CUR_MAX, &state);
+	if (n == (size_t) -1 || n == (size_t) -2)
+	    return false;
+
+	if (cur[glob->count] && (!tailonly || n == 0))
+	    return true;
+	if (n == 0)
+	    return false;
+	s += n;
+
+	bool alive = glob_step(glob, casefold, cur, next, c);
+	if (!anchored) {
+	    glob_add_state(glob, next, 0);
+	    alive = true;
+	}
+	if (!alive)
+	    return false;
+
+	unsigned char *temp = cur;
+	cur = next, next = temp;
+    }
+}
+
+/* Tests if glob `xfnm' matches wide string `s'.
+ * Like `glob_test', the test takes linear time. */
+bool glob_wtest(const xfnmatch_T *restrict xfnm, const wchar_t *restrict s)
+{
+    const glob_T *glob = &xfnm->value.glob;
+    bool casefold = xfnm->flags & XFNM_CASEFOLD;
+    bool anchored = xfnm->flags & XFNM_HEADONLY;
+    bool tailonly = xfnm->flags & XFNM_TAILONLY;
+    unsigned char *cur = glob->states, *next = cur + glob->count + 1;
+
+    memset(cur, 0, glob->count + 1);
+    glob_add_state(glob, cur, 0);
+    for (;; s++) {
+	if (cur[glob->count] && (!tailonly || *s == L'\0'))
+	    return true;
+	if (*s == L'\0')
+	    return false;
+
+	bool alive = glob_step(glob, casefold, cur, next, *s);
+	if (!anchored) {
+	    glob_add_state(glob, next, 0);
+	    alive = true;
+	}
+	if (!alive)
+	    return false;
+
+	unsigned char *temp = cur;
+	cur = next, next = temp;
+    }
+}
+
+/* Matches glob `xfnm' against the beginning of string `s'.
+ * Returns the length of the shortest or longest matching prefix of `s', or
+ * (size_t) -1 if no prefix matches. If `whole' is true, only the whole of `s'
+ * is considered as a match. The XFNM_HEADONLY and XFNM_TAILONLY flags are
+ * ignored. */
+size_t glob_wmatch_head(const xfnmatch_T *restrict xfnm,
+	const wchar_t *restrict s, bool shortest, bool whole)
+{
+    const glob_T *glob = &xfnm->value.glob;
+    bool casefold = xfnm->flags & XFNM_CASEFOLD;
+    unsigned char *cur = glob->states, *next = cur + glob->count + 1;
+    size_t result = (size_t) -1;
+
+    memset(cur, 0, glob->count + 1);
+    glob_add_state(glob, cur, 0);
+    for (size_t i = 0; ; i++) {
+	if (cur[glob->count] && (!whole || s[i] == L'\0')) {
+	    result = i;
+	    if (shortest)
+		break;
+	}
+	if (s[i] == L'\0')
+	    break;
+	if (!glob_step(glob, casefold, cur, next, s[i]))
+	    break;
+
+	unsigned char *temp = cur;
+	cur = next, next = temp;
+    }
+    return result;
+}
+
+/* Matches glob `xfnm' against the end of string `s' of length `len'.
+ * The elements of the glob must be in the reverse order. The automaton reads
+ * the string backward from its end, so this function takes linear time.
+ * Returns the start index of the shortest or longest matching suffix of `s',
+ * or (size_t) -1 if no suffix matches. */
+size_t glob_wmatch_tail(const xfnmatch_T *restrict xfnm,
+	const wchar_t *restrict s, size_t len, bool shortest)
+{
+    const glob_T *glob = &xfnm->value.glob;
+    bool casefold = xfnm->flags & XFNM_CASEFOLD;
+    unsigned char *cur = glob->states, *next = cur + glob->count + 1;
+    size_t result = (size_t) -1;
+
+    memset(cur, 0, glob->count + 1);
+    glob_add_state(glob, cur, 0);
+    for (size_t i = len; ; i--) {
+	if (cur[glob->count]) {
+	    result = i;
+	    if (shortest)
+		break;
+	}
+	if (i == 0)
+	    break;
+	if (!glob_step(glob, casefold, cur, next, s[i - 1]))
+	    break;
+
+	unsigned char *temp = cur;
+	cur = next, next = temp;
+    }
+    return result;
+}
+
+/* Like `glob_add_state', but the states are associated with the index where
+ * the match started. `starts[i]' is the smallest start index of the matches
+ * that have reached state `i', or (size_t) -1 if the state is inactive. */
+void glob_add_start(
+	const glob_T *restrict glob, size_t *restrict starts, size_t i,
+	size_t start)
+{
+    for (;;) {
+	if (starts[i] > start)
+	    starts[i] = start;
+	if (i >= glob->count || glob->elems[i].type != GE_STAR)
+	    break;
+	i++;
+    }
+}
+
+/* Finds the leftmost-longest match of glob `xfnm' in string `s'.
+ * Instead of trying every start index one by one, the automaton reads the
+ * string only once, starting a new match at each index until a match is
+ * found. As each state remembers the leftmost start index that reached it,
+ * this function takes linear time. */
+xfnmresult_T glob_wsearch(
+	const xfnmatch_T *restrict xfnm, const wchar_t *restrict s)
+{
+    const glob_T *glob = &xfnm->value.glob;
+    bool casefold = xfnm->flags & XFNM_CASEFOLD;
+    size_t *cur = glob->starts, *next = cur + glob->count + 1;
+    assert(cur != NULL);
+    xfnmresult_T result = MISMATCH;
+
+    for (size_t j = 0; j <= glob->count; j++)
+	cur[j] = (size_t) -1;
+    glob_add_start(glob, cur, 0, 0);
+    for (size_t i = 0; ; i++) {
+	/* A match that starts earlier is preferred. Of the matches that start
+	 * at the same index, the later one is longer. */
+	if (cur[glob->count] != (size_t) -1
+		&& cur[glob->count] <= result.start) {
+	    result.start = cur[glob->count];
+	    result.end = i;
+	}
+	if (s[i] == L'\0')
+	    break;
+
+	bool alive = false;
+	for (size_t j = 0; j <= glob->count; j++)
+	    next[j] = (size_t) -1;
+	for (size_t j = 0; j < glob->count; j++) {
+	    /* Once a match is found, matches that start later are useless. */
+	    if (cur[j] == (size_t) -1 || cur[j] > result.start)
+		continue;
+	    if (glob->elems[j].type == GE_STAR) {
+		glob_add_start(glob, next, j, cur[j]);
+		alive = true;
+	    } else if (elem_matches(&glob->elems[j], s[i], casefold)) {
+		glob_add_start(glob, next, j + 1, cur[j]);
+		alive = true;
+	    }
+	}
+	if (result.start == (size_t) -1) {
+	    glob_add_start(glob, next, 0, i + 1);
+	    alive = true;
+	}
+	if (!alive)
+	    break;
+
+	size_t *temp = cur;
+	cur = next, next = temp;
+    }
+    return result;
+}
+
+/* Performs matching on string `s' using pre-compiled glob `xfnm'.
+ * See the `xfnm_wmatch' function. Every mode of matching takes linear time. */
+xfnmresult_T wmatch_glob(
+	const xfnmatch_T *restrict xfnm, const wchar_t *restrict s)
+{
+    xfnmflags_T flags = xfnm->flags;
+    bool shortest = flags & XFNM_SHORTEST;
+
+    if ((flags & XFNM_HEADTAIL) == XFNM_HEADTAIL)
+	return glob_wtest(xfnm, s) ? (xfnmresult_T) { .start = 0 } : MISMATCH;
+    if (flags & XFNM_HEADONLY) {
+	size_t end = glob_wmatch_head(xfnm, s, shortest, false);
+	if (end == (size_t) -1)
+	    return MISMATCH;
+	return (xfnmresult_T) { .start = 0, .end = end };
+    }
+    if (flags & XFNM_TAILONLY) {
+	size_t len = wcslen(s);
+	size_t start = glob_wmatch_tail(xfnm, s, len, shortest);
+	if (start == (size_t) -1)
+	    return MISMATCH;
+	return (xfnmresult_T) { .start = start, .end = len };
+    }
+    return glob_wsearch(xfnm, s);
+}
+
 /* Returns a pointer to the substring of `s' where `sub' last appears in `s'. */
 wchar_t *last_wcsstr(const wchar_t *restrict s, const wchar_t *restrict sub)
 {
@@ -696,7 +1390,9 @@ wchar_t *xfnm_subst(const xfnmatch_T *restrict xfnm, const wchar_t *restrict s,
 
     if ((flags & XFNM_HEADTAIL) == XFNM_HEADTAIL) {
 	xfnmresult_T result;
-	if (flags & XFNM_compiled)
+	if (flags & XFNM_glob)
+	    result = wmatch_glob(xfnm, s);
+	else if (flags & XFNM_compiled)
 	    result = wmatch_headtail(&xfnm->value.regex, s);
 	else
 	    result = wmatch_literal(xfnm, s);
@@ -724,7 +1420,9 @@ wchar_t *xfnm_subst(const xfnmatch_T *restrict xfnm, const wchar_t *restrict s,
 void xfnm_free(xfnmatch_T *xfnm)
 {
     if (xfnm != NULL) {
-	if (xfnm->flags & XFNM_compiled)
+	if (xfnm->flags & XFNM_glob)
+	    free_glob(&xfnm->value.glob);
+	else if (xfnm->flags & XFNM_compiled)
 	    regfree(&xfnm->value.regex);
 	else
 	    wb_destroy(&xfnm->value.literal);
@@ -735,12 +1433,9 @@ void xfnm_free(xfnmatch_T *xfnm)
 /* Tests if pattern matching expression `pattern' matches string `s'. */
 bool match_pattern(const wchar_t *s, const wchar_t *pattern)
 {
-    xfnmatch_T *xfnm = xfnm_compile(pattern, XFNM_HEADONLY | XFNM_TAILONLY);
-    if (xfnm == NULL)
-	return false;
-    bool match = (xfnm_wmatch(xfnm, s).start != (size_t) -1);
-    xfnm_free(xfnm);
-    return match;
+    const xfnmatch_T *xfnm =
+	xfnm_compile_cached(pattern, XFNM_HEADONLY | XFNM_TAILONLY);
+    return xfnm != NULL && xfnm_wmatch(xfnm, s).start != (size_t) -1;
 }
 
 #if YASH_ENABLE_TEST
@@ -31,6 +31,7 @@ typedef enum {
     XFNM_compiled = 1 << 5,
     XFNM_headstar = 1 << 6,
     XFNM_tailstar = 1 << 7,
+    XFNM_glob     = 1 << 8,
 } xfnmflags_T;
 typedef struct {
     size_t start, end;
@@ -54,6 +55,12 @@ extern wchar_t *xfnm_subst(
 	const wchar_t *restrict repl, _Bool substall)
     __attribute__((malloc,warn_unused_result,nonnull));
 extern void xfnm_free(xfnmatch_T *xfnm);
+extern const xfnmatch_T *xfnm_compile_cached(
+	const wchar_t *pat, xfnmflags_T flags)
+    __attribute__((warn_unused_result,nonnull));
+extern _Bool xfnm_is_outdated(const xfnmatch_T *xfnm)
+    __attribute__((pure,nonnull));
+extern void xfnm_locale_changed(void);
 
 extern _Bool match_pattern(const wchar_t *s, const wchar_t *pattern)
     __attribute__((nonnull));
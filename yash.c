@@ -29,6 +29,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <wchar.h>
 #include "alias.h"
@@ -36,6 +37,7 @@
 #include "configm.h"
 #include "exec.h"
 #include "expand.h"
+#include "hashtable.h"
 #if YASH_ENABLE_HISTORY
 # include "history.h"
 #endif
@@ -44,6 +46,7 @@
 #include "option.h"
 #include "parser.h"
 #include "path.h"
+#include "plist.h"
 #include "redir.h"
 #include "sig.h"
 #include "strbuf.h"
@@ -51,10 +54,16 @@
 #include "variable.h"
 
 
+/* The maximum size of the input buffer that holds a whole script file. Larger
+ * files are read in blocks of BUFSIZ bytes. */
+#define INPUT_FILE_MAX_BUFSIZE (16 * 1024 * 1024)
+
 extern int main(int argc, char **argv)
     __attribute__((nonnull));
 static struct input_file_info_T *new_input_file_info(int fd, size_t bufsize)
     __attribute__((malloc,warn_unused_result));
+static size_t input_file_bufsize(int fd)
+    __attribute__((warn_unused_result));
 static void execute_profile(const wchar_t *profile);
 static void execute_rcfile(const wchar_t *rcfile);
 static bool execute_file_in_home(const wchar_t *path)
@@ -64,8 +73,24 @@ static bool execute_file_mbs(const char *path);
 static void print_help(void);
 static void print_version(void);
 
-static void parse_and_exec(struct parseparam_T *pinfo, bool finally_exit)
+static bool parse_and_exec(
+	struct parseparam_T *pinfo, bool finally_exit, plist_T *trees)
     __attribute__((nonnull(1)));
+static struct parsecache_T *get_parse_cache(const struct stat *st)
+    __attribute__((nonnull));
+static unsigned long exec_parse_cache(struct parsecache_T *pc)
+    __attribute__((nonnull));
+static void put_parse_cache(const struct stat *st, bool posix, plist_T *trees)
+    __attribute__((nonnull));
+static void free_parse_cache(struct parsecache_T *pc)
+    __attribute__((nonnull));
+static hashval_T hash_parse_cache(const void *pc)
+    __attribute__((nonnull,pure));
+static int compare_parse_cache(const void *pc1, const void *pc2)
+    __attribute__((nonnull,pure));
+static void free_trees(plist_T *trees)
+    __attribute__((nonnull));
+static bool seek_to_line(int fd, unsigned long lineno);
 static bool input_is_interactive_terminal(const parseparam_T *pinfo)
     __attribute__((nonnull));
 
@@ -95,7 +120,7 @@ int main(int argc, char **argv)
     void *wargv[argc + 1];
     const wchar_t *shortest_name;
 
-    setvbuf(stdout, NULL, _IOLBF, BUFSIZ);
+    setvbuf(stdout, NULL, _IOFBF, BUFSIZ);
     setvbuf(stderr, NULL, _IOLBF, BUFSIZ);
 
     setlocale(LC_ALL, "");
@@ -256,6 +281,20 @@ struct input_file_info_T *new_input_file_info(int fd, size_t bufsize)
     return info;
 }
 
+/* Returns the size of the input buffer for reading commands from the specified
+ * file descriptor. If `fd' is a regular file not larger than
+ * INPUT_FILE_MAX_BUFSIZE, the buffer is large enough to read the whole file
+ * at once. Otherwise, BUFSIZ is returned. */
+size_t input_file_bufsize(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+	return BUFSIZ;
+    if (st.st_size < BUFSIZ || st.st_size >= INPUT_FILE_MAX_BUFSIZE)
+	return BUFSIZ;
+    return (size_t) st.st_size;
+}
+
 /* Executes "$HOME/.yash_profile". */
 void execute_profile(const wchar_t *profile)
 {
@@ -462,9 +501,38 @@ void exec_wcs(const wchar_t *code, const char *name, bool finally_exit)
 	.interactive = false,
     };
 
-    parse_and_exec(&pinfo, finally_exit);
+    parse_and_exec(&pinfo, finally_exit, NULL);
 }
 
+/* The maximum number of files whose parse trees are kept in `parse_caches'. */
+#define PARSE_CACHE_MAX 512
+
+/* Parse trees of a script file, kept by `exec_input' so that the file is not
+ * parsed again when it is executed next time. */
+struct parsecache_T {
+    dev_t pc_dev;
+    ino_t pc_ino;
+    off_t pc_size;
+#if HAVE_ST_MTIM || HAVE_ST_MTIMESPEC
+    struct timespec pc_mtim;
+# define pc_mtime pc_mtim.tv_sec
+#else
+    time_t pc_mtime;
+#endif
+    bool pc_posix;          /* the value of `posixly_correct' when parsed */
+    unsigned pc_busy;       /* number of running `exec_parse_cache' calls */
+    size_t pc_count;        /* number of trees in `pc_trees' */
+    and_or_T *pc_trees[];   /* results of `read_and_parse' */
+};
+/* The parse trees are valid only while the file is not modified and the parser
+ * works the same way, so the cache is used only for files that are parsed
+ * without alias substitution. Each tree is allocated in its own arena, which
+ * is retained while the tree is executed. */
+
+/* A hashtable that maps `parsecache_T's to themselves. The hash and comparison
+ * functions only see the device and i-node numbers. */
+static hashtable_T parse_caches;
+
 /* Parses the input from the specified file descriptor and executes commands.
  * The file descriptor must be either STDIN_FILENO or a shell FD. If the file
  * descriptor is STDIN_FILENO, XIO_FINALLY_EXIT must be specified in `options'.
@@ -484,10 +552,37 @@ void exec_input(int fd, const char *name, exec_input_options_T options)
     struct input_interactive_info_T intrinfo;
     struct input_file_info_T *inputinfo;
 
+    /* Use the parse cache if the file is a regular file that is parsed in the
+     * same way whenever it is executed. */
+    struct stat st;
+    bool cacheable = !(options &
+		(XIO_INTERACTIVE | XIO_SUBST_ALIAS | XIO_FINALLY_EXIT))
+	&& !shopt_verbose && fd != STDIN_FILENO
+	&& fstat(fd, &st) >= 0 && S_ISREG(st.st_mode);
+    if (cacheable) {
+	struct parsecache_T *pc = get_parse_cache(&st);
+	if (pc != NULL) {
+	    pinfo.lineno = exec_parse_cache(pc);
+	    if (pinfo.lineno == 0)
+		return;
+
+	    /* The POSIXly-correct mode has been changed by a cached command.
+	     * The rest of the file is parsed again in the new mode. */
+	    if (!seek_to_line(fd, pinfo.lineno)) {
+		xerror(errno, Ngt("cannot read input"));
+		laststatus = Exit_ERROR;
+		return;
+	    }
+	    cacheable = false;
+	}
+    }
+
     if (fd == STDIN_FILENO)
 	inputinfo = stdin_input_file_info;
-    else
+    else if (pinfo.interactive)
 	inputinfo = new_input_file_info(fd, BUFSIZ);
+    else
+	inputinfo = new_input_file_info(fd, input_file_bufsize(fd));
 
     if (pinfo.interactive) {
 	intrinfo.fileinfo = inputinfo;
@@ -498,17 +593,34 @@ void exec_input(int fd, const char *name, exec_input_options_T options)
 	pinfo.input = input_file;
 	pinfo.inputinfo = inputinfo;
     }
-    parse_and_exec(&pinfo, options & XIO_FINALLY_EXIT);
+    if (cacheable) {
+	bool posix = posixly_correct;
+	plist_T trees;
+	pl_init(&trees);
+	if (parse_and_exec(&pinfo, false, &trees))
+	    put_parse_cache(&st, posix, &trees);
+	else
+	    free_trees(&trees);
+    } else {
+	parse_and_exec(&pinfo, options & XIO_FINALLY_EXIT, NULL);
+    }
 
     assert(inputinfo != stdin_input_file_info);
     free(inputinfo);
 }
 
 /* Parses the input using the specified `parseparam_T' and executes commands.
- * If no commands were executed, `laststatus' is set to Exit_SUCCESS. */
-void parse_and_exec(parseparam_T *pinfo, bool finally_exit)
+ * If no commands were executed, `laststatus' is set to Exit_SUCCESS.
+ * If `trees' is non-NULL, the parse trees are added to it instead of being
+ * freed after execution. If the POSIXly-correct mode is changed during the
+ * parse, the trees cannot be reused, so they are freed and no more trees are
+ * added.
+ * Returns true iff the end of input was reached without any error and
+ * `trees', if non-NULL, contains all the trees. */
+bool parse_and_exec(parseparam_T *pinfo, bool finally_exit, plist_T *trees)
 {
-    bool executed = false;
+    bool executed = false, alltrees = true;
+    bool posix = posixly_correct;
 
     if (pinfo->interactive)
 	disable_return();
@@ -524,6 +636,13 @@ void parse_and_exec(parseparam_T *pinfo, bool finally_exit)
 		goto out;
 	}
 
+	if (trees != NULL && posixly_correct != posix) {
+	    free_trees(trees);
+	    pl_init(trees);
+	    trees = NULL;
+	    alltrees = false;
+	}
+
 	and_or_T *commands;
 	switch (read_and_parse(pinfo, &commands)) {
 	    case PR_OK:
@@ -534,14 +653,17 @@ void parse_and_exec(parseparam_T *pinfo, bool finally_exit)
 				pinfo->lastinputresult == INPUT_EOF);
 			executed = true;
 		    }
-		    andorsfree(commands);
+		    if (trees != NULL)
+			pl_add(trees, commands);
+		    else
+			andorsfree(commands);
 		}
 		break;
 	    case PR_EOF:
 		if (!executed)
 		    laststatus = Exit_SUCCESS;
 		if (!finally_exit)
-		    goto out;
+		    return alltrees;
 		if (shopt_ignoreeof && input_is_interactive_terminal(pinfo)) {
 		    fprintf(stderr, gt("Use `exit' to leave the shell.\n"));
 		} else {
@@ -565,6 +687,175 @@ void parse_and_exec(parseparam_T *pinfo, bool finally_exit)
 out:
     if (finally_exit)
 	exit_shell();
+    return false;
+}
+
+/* Returns the parse cache for the file of the specified status if it is
+ * valid. A stale cache for the file is removed. */
+struct parsecache_T *get_parse_cache(const struct stat *st)
+{
+    if (parse_caches.capacity == 0)
+	return NULL;
+
+    struct parsecache_T key = { .pc_dev = st->st_dev, .pc_ino = st->st_ino, };
+    struct parsecache_T *pc = ht_get(&parse_caches, &key).value;
+    if (pc == NULL)
+	return NULL;
+    if (pc->pc_size == st->st_size && pc->pc_mtime == st->st_mtime
+#if HAVE_ST_MTIM
+	    && pc->pc_mtim.tv_nsec == st->st_mtim.tv_nsec
+#elif HAVE_ST_MTIMESPEC
+	    && pc->pc_mtim.tv_nsec == st->st_mtimespec.tv_nsec
+#endif
+	    && pc->pc_posix == posixly_correct)
+	return pc;
+
+    if (pc->pc_busy == 0) {
+	ht_remove(&parse_caches, pc);
+	free_parse_cache(pc);
+    }
+    return NULL;
+}
+
+/* Executes the parse trees in the specified cache like `parse_and_exec'.
+ * If the POSIXly-correct mode is changed by a command, the remaining trees are
+ * not executed since they were parsed in the other mode. In that case, the
+ * line number at which the next tree starts is returned. Otherwise, zero is
+ * returned. */
+unsigned long exec_parse_cache(struct parsecache_T *pc)
+{
+    bool executed = false;
+    unsigned long lineno = 0;
+
+    pc->pc_busy++;
+    for (size_t i = 0; i < pc->pc_count; i++) {
+	if (need_break())
+	    break;
+	if (posixly_correct != pc->pc_posix) {
+	    lineno = pc->pc_trees[i]->ao_pipelines->pl_commands->c_lineno;
+	    break;
+	}
+	if (shopt_exec || is_interactive) {
+	    and_or_T *commands = pc->pc_trees[i];
+	    parsearenadup(commands->ao_arena);
+	    exec_and_or_lists(commands, false);
+	    andorsfree(commands);
+	    executed = true;
+	}
+    }
+    pc->pc_busy--;
+
+    if (lineno == 0 && !executed && !need_break())
+	laststatus = Exit_SUCCESS;
+    return lineno;
+}
+
+/* Adds the parse trees of the file of the specified status to the cache.
+ * `posix' is the value of `posixly_correct' with which the trees were parsed.
+ * The trees in `trees' are moved to the cache or freed, and `trees' is
+ * destroyed. */
+void put_parse_cache(const struct stat *st, bool posix, plist_T *trees)
+{
+    /* The trees can be cached only if they are allocated in arenas. */
+    for (size_t i = 0; i < trees->length; i++) {
+	if (((and_or_T *) trees->contents[i])->ao_arena == NULL)
+	    goto discard;
+    }
+
+    if (parse_caches.capacity == 0)
+	ht_init(&parse_caches, hash_parse_cache, compare_parse_cache);
+    if (parse_caches.count >= PARSE_CACHE_MAX)
+	goto discard;
+
+    struct parsecache_T *pc = xmallocs(sizeof *pc,
+	    trees->length, sizeof *pc->pc_trees);
+    pc->pc_dev = st->st_dev;
+    pc->pc_ino = st->st_ino;
+    pc->pc_size = st->st_size;
+#if HAVE_ST_MTIM
+    pc->pc_mtim = st->st_mtim;
+#elif HAVE_ST_MTIMESPEC
+    pc->pc_mtim = st->st_mtimespec;
+#else
+    pc->pc_mtime = st->st_mtime;
+#endif
+    pc->pc_posix = posix;
+    pc->pc_busy = 0;
+    pc->pc_count = trees->length;
+    for (size_t i = 0; i < trees->length; i++)
+	pc->pc_trees[i] = trees->contents[i];
+    pl_destroy(trees);
+
+    /* An existing cache for the same file is replaced only if not in use. */
+    struct parsecache_T *old = ht_get(&parse_caches, pc).value;
+    if (old != NULL) {
+	if (old->pc_busy > 0) {
+	    free_parse_cache(pc);
+	    return;
+	}
+	ht_remove(&parse_caches, old);
+	free_parse_cache(old);
+    }
+    ht_set(&parse_caches, pc, pc);
+    return;
+
+discard:
+    free_trees(trees);
+}
+
+/* Frees the specified parse cache and its parse trees. */
+void free_parse_cache(struct parsecache_T *pc)
+{
+    for (size_t i = 0; i < pc->pc_count; i++)
+	andorsfree(pc->pc_trees[i]);
+    free(pc);
+}
+
+hashval_T hash_parse_cache(const void *pc)
+{
+    const struct parsecache_T *p = pc;
+    return (hashval_T) p->pc_ino * 31 + (hashval_T) p->pc_dev;
+}
+
+int compare_parse_cache(const void *pc1, const void *pc2)
+{
+    const struct parsecache_T *p1 = pc1, *p2 = pc2;
+    return !(p1->pc_dev == p2->pc_dev && p1->pc_ino == p2->pc_ino);
+}
+
+/* Frees the parse trees in the specified list and destroys the list. */
+void free_trees(plist_T *trees)
+{
+    for (size_t i = 0; i < trees->length; i++)
+	andorsfree(trees->contents[i]);
+    pl_destroy(trees);
+}
+
+/* Moves the offset of the specified regular file to the start of the line of
+ * the specified number. Returns false with `errno' set on error. */
+bool seek_to_line(int fd, unsigned long lineno)
+{
+    char buf[BUFSIZ];
+    off_t offset = 0;
+
+    if (lseek(fd, 0, SEEK_SET) < 0)
+	return false;
+    while (lineno > 1) {
+	ssize_t count = read(fd, buf, sizeof buf);
+	if (count < 0) {
+	    if (errno == EINTR)
+		continue;
+	    return false;
+	}
+	if (count == 0)
+	    break;
+
+	const char *p = buf, *end = buf + count;
+	while (lineno > 1 && (p = memchr(p, '\n', end - p)) != NULL)
+	    p++, lineno--;
+	offset += (lineno > 1 ? end : p) - buf;
+    }
+    return lseek(fd, offset, SEEK_SET) >= 0;
 }
 
 bool input_is_interactive_terminal(const parseparam_T *pinfo)